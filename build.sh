@@ -10,6 +10,10 @@ compile_release() {
 	meson compile -C build
 }
 
+run_tests() {
+	meson test -C build
+}
+
 install() {
 	meson install -C build
 }
@@ -23,6 +27,7 @@ help() {
 	printf "options:\n"
 	printf "\t-r - compile release\n"
 	printf "\t-d - compile debug\n"
+	printf "\t-t - runs the regression tests\n"
 	printf "\t-i - install\n"
 	printf "\t-c - clean\n"
 	printf "\t-h - prints this help message\n"
@@ -33,10 +38,11 @@ if [ -z "$*" ]; then
 	exit 0
 fi
 
-while getopts "rdich" opt; do
+while getopts "rdtich" opt; do
 	case $opt in
 		r) compile_release ;;
 		d) compile_debug ;;
+		t) run_tests ;;
 		i) install ;;
 		c) clean ;;
 		h) help ;;
@@ -0,0 +1,207 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <error.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include "misc.h"
+#include "elf_header.h"
+#include "program_header.h"
+#include "section_header.h"
+#include "validate.h"
+#include "image.h"
+#include "symbol.h"
+
+/*
+ * libFuzzer (and AFL++) harness: every input is an elf file in memory. it is
+ * checked by the validate functions and printed the way -e, -p and -s print
+ * a file, then loaded as an image and printed the way -S does. built with
+ * -DRELF_FUZZ_REPLAY it runs the files given as arguments once instead, to
+ * replay a corpus or a crash without libFuzzer, and prints the throughput,
+ * so a set of big files doubles as a benchmark of the checks and printers
+ */
+
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// the section name string table the way the file readers return it, "" for SHN_UNDEF
+static char* copy_string_table(const uint8_t *data, uint64_t offset, uint64_t size)
+{
+	char *strtab = NULL;
+
+	strtab = malloc_wrap((size_t)size + 1);
+	if(size > 0)
+		memcpy(strtab, data + offset, (size_t)size);
+	strtab[size] = '\0';
+
+	return strtab;
+}
+
+static void fuzz_elf32(const uint8_t *data, size_t size)
+{
+	Elf32_Ehdr header;
+	Elf32_Phdr *program_headers = NULL;
+	Elf32_Shdr *section_headers = NULL;
+	char *strtab = NULL;
+
+	if(size < sizeof(header))
+		return;
+	memcpy(&header, data, sizeof(header));
+	print_elf32_header(&header);
+
+	if(!validate_elf32_header(&header, size, VALIDATE_SEGMENTS))
+	{
+		program_headers = malloc_wrap(sizeof(Elf32_Phdr) * header.e_phnum + 1);
+		if(header.e_phnum > 0)
+			memcpy(program_headers, data + header.e_phoff, sizeof(Elf32_Phdr) * header.e_phnum);
+		print_program32_headers(program_headers, &header);
+	}
+
+	if(!validate_elf32_header(&header, size, VALIDATE_SECTIONS))
+	{
+		section_headers = malloc_wrap(sizeof(Elf32_Shdr) * header.e_shnum + 1);
+		if(header.e_shnum > 0)
+			memcpy(section_headers, data + header.e_shoff, sizeof(Elf32_Shdr) * header.e_shnum);
+
+		if(!validate_section32_headers(section_headers, &header, size))
+		{
+			if(header.e_shstrndx != SHN_UNDEF)
+				strtab = copy_string_table(data, section_headers[header.e_shstrndx].sh_offset, section_headers[header.e_shstrndx].sh_size);
+			else
+				strtab = copy_string_table(data, 0, 0);
+			print_section32_headers(section_headers, &header, strtab);
+		}
+	}
+
+	free(strtab);
+	free(section_headers);
+	free(program_headers);
+}
+
+static void fuzz_elf64(const uint8_t *data, size_t size)
+{
+	Elf64_Ehdr header;
+	Elf64_Phdr *program_headers = NULL;
+	Elf64_Shdr *section_headers = NULL;
+	char *strtab = NULL;
+
+	if(size < sizeof(header))
+		return;
+	memcpy(&header, data, sizeof(header));
+	print_elf64_header(&header);
+
+	if(!validate_elf64_header(&header, size, VALIDATE_SEGMENTS))
+	{
+		program_headers = malloc_wrap(sizeof(Elf64_Phdr) * header.e_phnum + 1);
+		if(header.e_phnum > 0)
+			memcpy(program_headers, data + header.e_phoff, sizeof(Elf64_Phdr) * header.e_phnum);
+		print_program64_headers(program_headers, &header);
+	}
+
+	if(!validate_elf64_header(&header, size, VALIDATE_SECTIONS))
+	{
+		section_headers = malloc_wrap(sizeof(Elf64_Shdr) * header.e_shnum + 1);
+		if(header.e_shnum > 0)
+			memcpy(section_headers, data + header.e_shoff, sizeof(Elf64_Shdr) * header.e_shnum);
+
+		if(!validate_section64_headers(section_headers, &header, size))
+		{
+			if(header.e_shstrndx != SHN_UNDEF)
+				strtab = copy_string_table(data, section_headers[header.e_shstrndx].sh_offset, section_headers[header.e_shstrndx].sh_size);
+			else
+				strtab = copy_string_table(data, 0, 0);
+			print_section64_headers(section_headers, &header, strtab);
+		}
+	}
+
+	free(strtab);
+	free(section_headers);
+	free(program_headers);
+}
+
+static void fuzz_symbols(const uint8_t *data, size_t size)
+{
+	struct elf_image image;
+	struct symbol_table symbols;
+	unsigned char *copy = NULL;
+
+	// the image loader takes a writable pointer
+	copy = malloc_wrap(size + 1);
+	memcpy(copy, data, size);
+
+	if(load_elf_image(&image, "fuzz", copy, size) == 0)
+	{
+		for(size_t i = 0; i < image.header.e_shnum; i++)
+		{
+			const Elf64_Shdr *section = &image.section_headers[i];
+
+			if(section->sh_type != SHT_SYMTAB && section->sh_type != SHT_DYNSYM)
+				continue;
+
+			if(load_symbol_table(&image, section, &symbols) == 0)
+				print_symbols(&symbols, get_section_name(&image, section), NULL, NULL);
+			free_symbol_table(&symbols);
+		}
+	}
+
+	free_elf_image(&image);
+	free(copy);
+}
+
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+	(void)argc;
+	(void)argv;
+
+	// the printers write to stdout, which would only slow the fuzzer down
+	if(!freopen("/dev/null", "w", stdout))
+		error(EXIT_FAILURE, errno, "cannot open /dev/null");
+
+	return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	if(size < EI_NIDENT || memcmp(data, ELFMAG, SELFMAG) != 0)
+		return 0;
+
+	if(data[EI_CLASS] == ELFCLASS32)
+		fuzz_elf32(data, size);
+	else if(data[EI_CLASS] == ELFCLASS64)
+		fuzz_elf64(data, size);
+
+	fuzz_symbols(data, size);
+	return 0;
+}
+
+#ifdef RELF_FUZZ_REPLAY
+int main(int argc, char **argv)
+{
+	uint64_t start, total = 0;
+	double elapsed;
+
+	LLVMFuzzerInitialize(&argc, &argv);
+	start = get_time_ns();
+
+	for(int i = 1; i < argc; i++)
+	{
+		size_t size;
+		unsigned char *data = mmap_file(argv[i], &size);
+
+		LLVMFuzzerTestOneInput(data, size);
+		if(data)
+			munmap(data, size);
+		total += size;
+	}
+
+	elapsed = (double)(get_time_ns() - start) / 1e9;
+	fprintf(stderr, "%d inputs, %.1f MB in %.3f s, %.1f MB/s\n",
+		argc - 1, (double)total / 1e6, elapsed, elapsed > 0 ? (double)total / elapsed / 1e6 : 0.0);
+
+	return EXIT_SUCCESS;
+}
+#endif
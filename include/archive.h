@@ -0,0 +1,10 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+struct demangler;
+
+int is_archive_file(const char *filename);
+void print_archive(const char *filename, bool is_elf_header, bool is_program_header, bool is_section_header, bool is_symbol_table, struct demangler *demangler);
+void print_archive_symbol(const char *filename, const char *symbol);
+
+#endif
\ No newline at end of file
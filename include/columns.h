@@ -0,0 +1,65 @@
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+/*
+ * columnar export file, in the byte order of the writer (readers can tell it
+ * from the version field) and with every block 8 byte aligned:
+ *
+ *	struct columns_header
+ *	batch...			one per input file
+ *	uint64_t batch_offsets[]	file offset of every batch
+ *	uint64_t batch_count
+ *	char magic[8]			COLUMNS_MAGIC again
+ *
+ * a batch is a struct column_batch followed by column_count descriptors,
+ * the file name and the column data; offsets in a batch count from its
+ * start. fixed width columns hold rows values, string columns hold rows + 1
+ * offsets into their blob, the string of row i being blob[offsets[i]]
+ * up to blob[offsets[i + 1]]. row i of the sections table is section i
+ */
+
+#define COLUMNS_MAGIC "RELFCOL1"
+#define COLUMNS_VERSION 1
+#define COLUMN_NAME_SIZE 16
+
+enum column_table {
+	COLUMN_SECTIONS = 1,
+	COLUMN_SEGMENTS,
+	COLUMN_SYMBOLS
+};
+
+enum column_type {
+	COLUMN_U8 = 1,
+	COLUMN_U16,
+	COLUMN_U32,
+	COLUMN_U64,
+	COLUMN_STRING			// uint64_t offsets and bytes, no terminators
+};
+
+struct columns_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+};
+
+struct column_batch {
+	uint64_t size;			// of the whole batch, header included
+	uint64_t path;			// offset of the input file name
+	uint32_t path_size;
+	uint32_t column_count;
+	uint32_t elf_class;
+	uint32_t machine;
+};
+
+struct column_descriptor {
+	char name[COLUMN_NAME_SIZE];	// zero padded
+	uint32_t table;
+	uint32_t type;
+	uint64_t rows;
+	uint64_t offset;		// values, or the string offsets
+	uint64_t blob;			// string bytes, 0 for fixed width columns
+};
+
+void export_columns(char **filenames, size_t count, const char *output);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,22 @@
+#ifndef COMPRESSED_H
+#define COMPRESSED_H
+
+// called for every piece of (decompressed) section content, non zero return stops reading
+typedef int (*section_chunk_func)(const unsigned char *chunk, size_t size, void *arg);
+
+// whole section content, decompressed into memory only when needed
+struct section_content {
+	unsigned char *data;
+	size_t size;
+	bool allocated;
+};
+
+int load_section_content(const struct elf_image *image, const Elf64_Shdr *section, struct section_content *content);
+void free_section_content(struct section_content *content);
+int read_section_chdr(const struct elf_image *image, const Elf64_Shdr *section, Elf64_Chdr *chdr, size_t *chdr_size);
+uint64_t get_section_content_size(const struct elf_image *image, const Elf64_Shdr *section);
+int read_section_chunks(const struct elf_image *image, const Elf64_Shdr *section, section_chunk_func func, void *arg);
+
+void print_compressed_sections(const char *filename);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,6 @@
+#ifndef CORE_H
+#define CORE_H
+
+void print_core(const char *filename);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,6 @@
+#ifndef DEBUG_LINE_H
+#define DEBUG_LINE_H
+
+void print_addr2line(const char *filename, FILE *input);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,12 @@
+#ifndef DEMANGLE_H
+#define DEMANGLE_H
+
+struct demangler;
+
+struct demangler* create_demangler(void);
+void free_demangler(struct demangler *demangler);
+const char* demangle_name(struct demangler *demangler, const char *name);
+void demangle_names(struct demangler *demangler, const char **names, size_t count);
+void print_demangle_stats(const struct demangler *demangler);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef DYNAMIC_H
+#define DYNAMIC_H
+
+// entries of the dynamic section, strings point into the image
+struct dynamic_table {
+	Elf64_Dyn *entries;
+	size_t count;
+	const char *strtab;
+	size_t strtab_size;
+};
+
+int load_dynamic_table(const struct elf_image *image, struct dynamic_table *table);
+void free_dynamic_table(struct dynamic_table *table);
+const char* get_dynamic_string(const struct dynamic_table *table, uint64_t offset);
+
+#endif
\ No newline at end of file
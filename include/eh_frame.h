@@ -0,0 +1,6 @@
+#ifndef EH_FRAME_H
+#define EH_FRAME_H
+
+size_t print_eh_frame(char **filenames, size_t count);
+
+#endif
\ No newline at end of file
@@ -4,6 +4,9 @@
 Elf32_Ehdr* read_elf32_header(const char *filename);
 Elf64_Ehdr* read_elf64_header(const char *filename);
 
+const char* get_elf_type(uint16_t type_code);
+const char* get_elf_machine(uint16_t machine_code);
+
 void print_elf32_header(Elf32_Ehdr *hdr);
 void print_elf64_header(Elf64_Ehdr *hdr);
 
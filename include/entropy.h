@@ -0,0 +1,16 @@
+#ifndef ENTROPY_H
+#define ENTROPY_H
+
+struct byte_stats {
+	uint64_t histogram[256];
+	uint64_t total;
+	double entropy;			// shannon entropy, bits per byte
+	double compressibility;		// estimated compressed size / size
+	uint8_t top_byte;
+};
+
+void count_bytes(const unsigned char *data, size_t size, uint64_t *histogram);
+void finish_byte_stats(struct byte_stats *stats);
+void print_entropy(const char *filename);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,7 @@
+#ifndef EXTRACT_H
+#define EXTRACT_H
+
+void extract_sections(const char *filename, const char *selector, const char *output_dir);
+void write_section_subset(const char *filename, const char *selector, const char *output_file);
+
+#endif
\ No newline at end of file
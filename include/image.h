@@ -0,0 +1,37 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+/*
+ * elf file (or archive member) accessed in place through a memory mapping.
+ * tables of 32 bit files are widened to the 64 bit structures, so code
+ * working on images is written only once.
+ */
+struct elf_image {
+	const char *name;
+	unsigned char *data;
+	size_t size;
+	int elf_class;
+	Elf64_Ehdr header;
+	Elf64_Phdr *program_headers;
+	Elf64_Shdr *section_headers;
+	char *strtab_buffer;		// section name string table, NULL if missing
+	size_t strtab_size;
+	void *mapping;			// set when the image owns its mapping
+	size_t mapping_size;
+};
+
+struct stat;
+
+unsigned char* mmap_file(const char *filename, size_t *size);
+int load_elf_image(struct elf_image *image, const char *name, unsigned char *data, size_t size);
+int open_elf_image(struct elf_image *image, const char *filename);
+int map_elf_image(struct elf_image *image, const char *filename, struct stat *st);
+void free_elf_image(struct elf_image *image);
+
+unsigned char* get_section_data(const struct elf_image *image, const Elf64_Shdr *section);
+unsigned char* get_vaddr_data(const struct elf_image *image, uint64_t vaddr, uint64_t *size);
+const char* get_section_name(const struct elf_image *image, const Elf64_Shdr *section);
+Elf64_Shdr* find_section(const struct elf_image *image, const char *name);
+const unsigned char* find_build_id(const struct elf_image *image, size_t *size);
+
+#endif
\ No newline at end of file
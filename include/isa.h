@@ -0,0 +1,6 @@
+#ifndef ISA_H
+#define ISA_H
+
+void print_isa_stats(const char *filename);
+
+#endif
\ No newline at end of file
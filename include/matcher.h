@@ -0,0 +1,37 @@
+#ifndef MATCHER_H
+#define MATCHER_H
+
+#define MATCHER_BUCKETS 8
+#define MATCHER_PREFIX 3
+
+struct pattern {
+	unsigned char *bytes;
+	size_t length;
+	const char *text;	// pattern as given by the user
+};
+
+/*
+ * multi-pattern literal matcher: every pattern is put in one of 8 buckets and
+ * the first bytes of all patterns are encoded into nibble lookup tables, so a
+ * 16 byte block of input is filtered with a few shuffles (SSSE3) and only the
+ * candidates are verified with memcmp()
+ */
+struct pattern_matcher {
+	struct pattern *patterns;
+	size_t count;
+	size_t min_length;
+	size_t max_length;
+	size_t prefix_length;
+	uint8_t lo_masks[MATCHER_PREFIX][16];
+	uint8_t hi_masks[MATCHER_PREFIX][16];
+	size_t *buckets[MATCHER_BUCKETS];
+	size_t bucket_sizes[MATCHER_BUCKETS];
+};
+
+typedef void (*match_func)(size_t pattern, uint64_t offset, void *arg);
+
+void init_matcher(struct pattern_matcher *matcher, char **patterns, size_t count);
+void free_matcher(struct pattern_matcher *matcher);
+void match_patterns(const struct pattern_matcher *matcher, const unsigned char *data, size_t size, size_t limit, match_func func, void *arg);
+
+#endif
\ No newline at end of file
@@ -3,9 +3,18 @@
 
 FILE* fopen_wrap(const char *filename, const char *mode);
 void* malloc_wrap(size_t size);
+void* realloc_wrap(void *ptr, size_t size);
 size_t fread_wrap(void *buf, size_t size, size_t n, FILE *fp);
 int is_elf_file(const char *filename);
+int is_stream_file(const char *filename);
 int get_elf_class(const char *filename);
+void print_json_string(const char *str);
+
+// 64 bit FNV-1a, chained by passing the last hash back in
+#define HASH_SEED 0xcbf29ce484222325
+uint64_t hash_bytes(uint64_t hash, const void *data, size_t size);
+uint64_t hash_string(uint64_t hash, const char *str);
+uint64_t get_time_ns(void);
 void help(void);
 void version(void);
 
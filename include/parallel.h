@@ -0,0 +1,9 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+typedef void (*parallel_func)(size_t index, void *arg);
+
+size_t get_thread_count(void);
+void parallel_for(size_t count, parallel_func func, void *arg);
+
+#endif
\ No newline at end of file
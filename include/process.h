@@ -0,0 +1,6 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+void print_process_images(pid_t pid, bool is_elf_header, bool is_program_header);
+
+#endif
\ No newline at end of file
@@ -6,5 +6,6 @@ Elf64_Phdr* read_program64_headers(const char *filename, Elf64_Ehdr *elf_header)
 
 void print_program32_headers(Elf32_Phdr *program_headers, Elf32_Ehdr *elf_header);
 void print_program64_headers(Elf64_Phdr *program_headers, Elf64_Ehdr *elf_header);
+void print_program64_headers_selected(Elf64_Phdr *program_headers, Elf64_Ehdr *elf_header, const unsigned char *selected);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,15 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+// tables --where can select rows of
+enum {
+	WHERE_SECTIONS = 1,
+	WHERE_SEGMENTS = 2,
+	WHERE_SYMBOLS = 4
+};
+
+struct demangler;
+
+void print_where(char **filenames, size_t count, const char *expression, int tables, bool json, struct demangler *demangler);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,7 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+int section_is_selected(const struct elf_image *image, const Elf64_Shdr *section, const char *selector);
+void search_files(char **filenames, size_t file_count, char **patterns, size_t pattern_count, const char *selector);
+
+#endif
\ No newline at end of file
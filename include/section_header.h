@@ -1,6 +1,11 @@
 #ifndef SECTION_HEADER
 #define SECTION_HEADER
 
+struct byte_stats;
+
+const char* get_section_header_type(uint32_t type);
+char* get_section_header_flags(uint64_t flags);
+
 char* read_section32_string_table(const char *filename, Elf32_Ehdr *elf_header, Elf32_Shdr *section_headers);
 char* read_section64_string_table(const char *filename, Elf64_Ehdr *elf_header, Elf64_Shdr *section_headers);
 
@@ -9,5 +14,7 @@ Elf64_Shdr* read_section64_headers(const char *filename, Elf64_Ehdr *elf_header)
 
 void print_section32_headers(Elf32_Shdr *section_headers, Elf32_Ehdr *elf_header, char *strtab_buffer);
 void print_section64_headers(Elf64_Shdr *section_headers, Elf64_Ehdr *elf_header, char *strtab_buffer);
+void print_section64_headers_selected(Elf64_Shdr *section_headers, Elf64_Ehdr *elf_header, char *strtab_buffer, const unsigned char *selected);
+void print_section64_headers_stats(Elf64_Shdr *section_headers, Elf64_Ehdr *elf_header, char *strtab_buffer, const struct byte_stats *stats);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,7 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+void serve_queries(const char *path);
+int query_server(const char *path, char **args, size_t count, size_t connections);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,6 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+void print_startup(char **filenames, size_t count, bool closure);
+
+#endif
\ No newline at end of file
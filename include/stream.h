@@ -0,0 +1,8 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+struct demangler;
+
+void print_stream_input(const char *filename, bool is_elf_header, bool is_program_header, bool is_section_header, bool is_symbol_table, struct demangler *demangler);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+// symbols of a SHT_SYMTAB or SHT_DYNSYM section, names point into the image
+struct demangler;
+
+struct symbol_table {
+	Elf64_Sym *symbols;
+	size_t count;
+	const char *strtab;
+	size_t strtab_size;
+};
+
+const char* get_symbol_type(unsigned int type);
+const char* get_symbol_bind(unsigned int bind);
+const char* get_symbol_visibility(unsigned int visibility);
+
+Elf64_Shdr* find_symbol_section(const struct elf_image *image);
+int load_symbol_table(const struct elf_image *image, const Elf64_Shdr *section, struct symbol_table *table);
+void free_symbol_table(struct symbol_table *table);
+const char* get_symbol_name(const struct symbol_table *table, const Elf64_Sym *symbol);
+
+void print_symbols(const struct symbol_table *table, const char *name, const unsigned char *selected, const char **names);
+void print_image_symbols(const struct elf_image *image, struct demangler *demangler);
+void print_symbol_table(const char *filename, struct demangler *demangler);
+
+#endif
\ No newline at end of file
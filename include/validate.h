@@ -0,0 +1,16 @@
+#ifndef VALIDATE_H
+#define VALIDATE_H
+
+// tables checked along with the elf header
+enum {
+	VALIDATE_SEGMENTS = 1,
+	VALIDATE_SECTIONS = 2
+};
+
+int range_is_valid(uint64_t file_size, uint64_t offset, uint64_t length);
+const char* validate_elf32_header(const Elf32_Ehdr *header, uint64_t file_size, int tables);
+const char* validate_elf64_header(const Elf64_Ehdr *header, uint64_t file_size, int tables);
+const char* validate_section32_headers(const Elf32_Shdr *section_headers, const Elf32_Ehdr *header, uint64_t file_size);
+const char* validate_section64_headers(const Elf64_Shdr *section_headers, const Elf64_Ehdr *header, uint64_t file_size);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef VERSION_H
+#define VERSION_H
+
+// a version defined by the file, or required from the library named by file
+struct version_entry {
+	const char *name;
+	const char *file;		// NULL for definitions
+	const char *parent;		// first parent of a definition, if any
+	uint32_t hash;
+	uint16_t flags;
+	uint16_t index;
+};
+
+// symbol versions of an image, strings point into the image
+struct version_table {
+	uint16_t *versions;		// .gnu.version, one per .dynsym symbol
+	size_t count;
+	struct version_entry *entries;	// definitions first, then requirements
+	size_t entry_count;
+	size_t entry_capacity;
+	size_t definition_count;
+	struct version_entry **by_index;	// entries by version index, NULL for unused ones
+	size_t index_count;
+};
+
+struct elf_image;
+
+int load_version_table(const struct elf_image *image, struct version_table *table);
+void free_version_table(struct version_table *table);
+const struct version_entry* get_symbol_version(const struct version_table *table, size_t index, bool *hidden);
+void print_versions(const char *filename);
+size_t check_versions(char **paths, size_t count);
+
+#endif
\ No newline at end of file
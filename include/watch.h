@@ -0,0 +1,6 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+void watch_directory(const char *dir, bool json);
+
+#endif
\ No newline at end of file
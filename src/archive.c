@@ -0,0 +1,414 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <elf.h>
+#include <ar.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include "misc.h"
+#include "image.h"
+#include "parallel.h"
+#include "elf_header.h"
+#include "program_header.h"
+#include "section_header.h"
+#include "symbol.h"
+#include "archive.h"
+
+enum {
+	ARMAP_NONE = 0,
+	ARMAP_GNU32,
+	ARMAP_GNU64,
+	ARMAP_BSD
+};
+
+struct archive_member {
+	char *name;
+	size_t header_offset;
+	size_t data_offset;
+	size_t size;
+	int status;		// result of load_elf_image()
+	struct elf_image image;
+};
+
+struct archive {
+	const char *filename;
+	unsigned char *data;
+	size_t size;
+	const char *long_names;
+	size_t long_names_size;
+	const unsigned char *armap;
+	size_t armap_size;
+	int armap_kind;
+	struct archive_member *members;
+	size_t member_count;
+};
+
+int is_archive_file(const char *filename)
+{
+	assert(filename != NULL);
+
+	char buffer[SARMAG];
+	FILE *fp = NULL;
+	size_t readed;
+
+	fp = fopen_wrap(filename, "rb");
+	readed = fread(buffer, 1, SARMAG, fp);
+	fclose(fp);
+
+	return readed == SARMAG && memcmp(buffer, ARMAG, SARMAG) == 0;
+}
+
+static size_t parse_ar_number(const char *field, size_t length)
+{
+	size_t value = 0;
+
+	for(size_t i = 0; i < length && field[i] >= '0' && field[i] <= '9'; i++)
+		value = value * 10 + (size_t)(field[i] - '0');
+
+	return value;
+}
+
+static uint64_t read_be(const unsigned char *p, size_t size)
+{
+	uint64_t value = 0;
+
+	for(size_t i = 0; i < size; i++)
+		value = (value << 8) | p[i];
+
+	return value;
+}
+
+static uint32_t read_u32(const unsigned char *p)
+{
+	uint32_t value;
+
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+// GNU long names live in the "//" member and end with "/\n"
+static char* get_long_name(const struct archive *ar, size_t offset)
+{
+	size_t end = offset;
+
+	if(!ar->long_names || offset >= ar->long_names_size)
+		return strdup("<bad long name>");
+
+	while(end < ar->long_names_size && ar->long_names[end] != '\n')
+		end++;
+	if(end > offset && ar->long_names[end - 1] == '/')
+		end--;
+
+	return strndup(ar->long_names + offset, end - offset);
+}
+
+// returns the name of the member whose header is at the given offset and
+// stores where its data starts; special members are recognized here too
+static char* parse_member_header(const struct archive *ar, size_t offset, size_t *data_offset, size_t *size)
+{
+	const struct ar_hdr *hdr = (const void*)(ar->data + offset);
+	char *name = NULL;
+	size_t name_length;
+
+	if(offset > ar->size || ar->size - offset < sizeof(struct ar_hdr) ||
+		memcmp(hdr->ar_fmag, ARFMAG, sizeof(hdr->ar_fmag)) != 0)
+		return NULL;
+
+	*data_offset = offset + sizeof(struct ar_hdr);
+	*size = parse_ar_number(hdr->ar_size, sizeof(hdr->ar_size));
+	if(*size > ar->size - *data_offset)
+		return NULL;
+
+	if(memcmp(hdr->ar_name, "#1/", 3) == 0)
+	{
+		// BSD: the name is stored in front of the member data
+		name_length = parse_ar_number(hdr->ar_name + 3, sizeof(hdr->ar_name) - 3);
+		if(name_length > *size)
+			return NULL;
+
+		name = strndup((const char*)ar->data + *data_offset, name_length);
+		*data_offset += name_length;
+		*size -= name_length;
+	}
+	else if(hdr->ar_name[0] == '/' && hdr->ar_name[1] >= '0' && hdr->ar_name[1] <= '9')
+		name = get_long_name(ar, parse_ar_number(hdr->ar_name + 1, sizeof(hdr->ar_name) - 1));
+	else
+	{
+		name_length = sizeof(hdr->ar_name);
+		while(name_length > 0 && hdr->ar_name[name_length - 1] == ' ')
+			name_length--;
+
+		// GNU terminates short names with '/', the special members are "/", "//" and "/SYM64/"
+		if(name_length > 1 && hdr->ar_name[name_length - 1] == '/' &&
+			!(name_length == 2 && hdr->ar_name[0] == '/') &&
+			!(name_length == 7 && memcmp(hdr->ar_name, "/SYM64/", 7) == 0))
+			name_length--;
+
+		name = strndup(hdr->ar_name, name_length);
+	}
+
+	if(!name)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	return name;
+}
+
+// handles the symbol index and long name table, returns false for ordinary members
+static bool parse_special_member(struct archive *ar, const char *name, size_t data_offset, size_t size)
+{
+	if(strcmp(name, "/") == 0 || strcmp(name, "/SYM64/") == 0)
+	{
+		ar->armap = ar->data + data_offset;
+		ar->armap_size = size;
+		ar->armap_kind = name[1] == '\0' ? ARMAP_GNU32 : ARMAP_GNU64;
+	}
+	else if(strcmp(name, "__.SYMDEF") == 0 || strcmp(name, "__.SYMDEF SORTED") == 0)
+	{
+		ar->armap = ar->data + data_offset;
+		ar->armap_size = size;
+		ar->armap_kind = ARMAP_BSD;
+	}
+	else if(strcmp(name, "//") == 0)
+	{
+		ar->long_names = (const char*)ar->data + data_offset;
+		ar->long_names_size = size;
+	}
+	else
+		return false;
+
+	return true;
+}
+
+// walks the member headers; with only_special set it stops at the first
+// ordinary member, so the symbol index can be used without touching members
+static void parse_archive(struct archive *ar, bool only_special)
+{
+	size_t offset = SARMAG;
+	size_t capacity = 0;
+
+	while(offset < ar->size)
+	{
+		size_t data_offset, size;
+		char *name = NULL;
+		struct archive_member *member = NULL;
+
+		name = parse_member_header(ar, offset, &data_offset, &size);
+		if(!name)
+		{
+			error(0, EBADF, "\'%s\': malformed archive member header at offset %zu", ar->filename, offset);
+			break;
+		}
+
+		if(parse_special_member(ar, name, data_offset, size))
+			free(name);
+		else if(only_special)
+		{
+			free(name);
+			break;
+		}
+		else
+		{
+			if(ar->member_count == capacity)
+			{
+				capacity = capacity ? capacity * 2 : 64;
+				ar->members = realloc_wrap(ar->members, capacity * sizeof(struct archive_member));
+			}
+
+			member = &ar->members[ar->member_count++];
+			memset(member, 0, sizeof(struct archive_member));
+			member->name = name;
+			member->header_offset = offset;
+			member->data_offset = data_offset;
+			member->size = size;
+		}
+
+		// members are aligned to an even offset
+		offset = data_offset + size;
+		offset += offset & 1;
+	}
+}
+
+static void open_archive(struct archive *ar, const char *filename, bool only_special)
+{
+	memset(ar, 0, sizeof(struct archive));
+	ar->filename = filename;
+	ar->data = mmap_file(filename, &ar->size);
+
+	parse_archive(ar, only_special);
+}
+
+static void close_archive(struct archive *ar)
+{
+	for(size_t i = 0; i < ar->member_count; i++)
+	{
+		free_elf_image(&ar->members[i].image);
+		free(ar->members[i].name);
+	}
+
+	free(ar->members);
+	if(ar->data)
+		munmap(ar->data, ar->size);
+}
+
+static void load_archive_member(size_t index, void *arg)
+{
+	struct archive *ar = arg;
+	struct archive_member *member = &ar->members[index];
+
+	member->status = load_elf_image(&member->image, member->name, ar->data + member->data_offset, member->size);
+}
+
+void print_archive(const char *filename, bool is_elf_header, bool is_program_header, bool is_section_header, bool is_symbol_table, struct demangler *demangler)
+{
+	assert(filename != NULL);
+
+	struct archive ar;
+
+	open_archive(&ar, filename, false);
+
+	// members are parsed in parallel, but printed in archive order
+	parallel_for(ar.member_count, load_archive_member, &ar);
+
+	printf("Archive \'%s\' has %zu members\n\n", filename, ar.member_count);
+
+	for(size_t i = 0; i < ar.member_count; i++)
+	{
+		struct archive_member *member = &ar.members[i];
+		struct elf_image *image = &member->image;
+
+		printf("Member: %s(%s)\n\n", filename, member->name);
+
+		if(member->status != 0)
+		{
+			error(0, member->status, "\'%s(%s)\' is not a valid elf file", filename, member->name);
+			continue;
+		}
+
+		if(is_elf_header)
+			print_elf64_header(&image->header);
+		if(is_program_header && image->program_headers)
+			print_program64_headers(image->program_headers, &image->header);
+		if(is_section_header && image->section_headers && image->strtab_buffer)
+			print_section64_headers(image->section_headers, &image->header, image->strtab_buffer);
+		if(is_symbol_table)
+			print_image_symbols(image, demangler);
+
+		printf("\n");
+	}
+
+	close_archive(&ar);
+}
+
+static void print_armap_match(const struct archive *ar, const char *symbol, size_t header_offset)
+{
+	size_t data_offset, size;
+	char *name = NULL;
+
+	name = parse_member_header(ar, header_offset, &data_offset, &size);
+
+	printf("  %-30s %-30s %#010zx\n", symbol, name ? name : "<bad member>", header_offset);
+
+	free(name);
+}
+
+static size_t lookup_gnu_armap(const struct archive *ar, const char *symbol)
+{
+	size_t word = ar->armap_kind == ARMAP_GNU64 ? 8 : 4;
+	size_t count, strings_offset, matches = 0;
+	const char *str = NULL;
+	const char *end = NULL;
+
+	if(ar->armap_size < word)
+		return 0;
+
+	count = (size_t)read_be(ar->armap, word);
+	if(count > (ar->armap_size - word) / word)
+		return 0;
+
+	strings_offset = word + count * word;
+	str = (const char*)ar->armap + strings_offset;
+	end = (const char*)ar->armap + ar->armap_size;
+
+	for(size_t i = 0; i < count && str < end; i++)
+	{
+		size_t length = strnlen(str, (size_t)(end - str));
+
+		if(length < (size_t)(end - str) && strcmp(str, symbol) == 0)
+		{
+			print_armap_match(ar, str, (size_t)read_be(ar->armap + word + i * word, word));
+			matches++;
+		}
+
+		str += length + 1;
+	}
+
+	return matches;
+}
+
+static size_t lookup_bsd_armap(const struct archive *ar, const char *symbol)
+{
+	size_t ranlib_size, strings_size, matches = 0;
+	const unsigned char *strings = NULL;
+
+	// the ranlib and string table sizes
+	if(ar->armap_size < 8)
+		return 0;
+
+	ranlib_size = read_u32(ar->armap);
+	if(ranlib_size > ar->armap_size - 8)
+		return 0;
+
+	strings_size = read_u32(ar->armap + 4 + ranlib_size);
+	strings = ar->armap + 8 + ranlib_size;
+	if(strings_size > ar->armap_size - 8 - ranlib_size)
+		return 0;
+
+	for(size_t i = 0; i + 8 <= ranlib_size; i += 8)
+	{
+		size_t strx = read_u32(ar->armap + 4 + i);
+		const char *name = (const char*)strings + strx;
+
+		// the length first, or a prefix of a longer name would match
+		if(strx >= strings_size || strnlen(name, strings_size - strx) != strlen(symbol) || strncmp(name, symbol, strings_size - strx) != 0)
+			continue;
+
+		print_armap_match(ar, symbol, read_u32(ar->armap + 4 + i + 4));
+		matches++;
+	}
+
+	return matches;
+}
+
+void print_archive_symbol(const char *filename, const char *symbol)
+{
+	assert(filename != NULL);
+	assert(symbol != NULL);
+
+	struct archive ar;
+	size_t matches = 0;
+
+	if(!is_archive_file(filename))
+		error(EXIT_FAILURE, EINVAL, "\'%s\' is not an archive", filename);
+
+	open_archive(&ar, filename, true);
+
+	printf("Archive symbol index lookup:\n");
+	printf("  Symbol                         Member                         Header\n");
+
+	if(ar.armap_kind == ARMAP_GNU32 || ar.armap_kind == ARMAP_GNU64)
+		matches = lookup_gnu_armap(&ar, symbol);
+	else if(ar.armap_kind == ARMAP_BSD)
+		matches = lookup_bsd_armap(&ar, symbol);
+	else
+		error(0, ENOENT, "\'%s\' has no symbol index", filename);
+
+	if(matches == 0)
+		printf("  symbol \'%s\' is not defined in the archive\n", symbol);
+
+	close_archive(&ar);
+}
\ No newline at end of file
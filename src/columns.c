@@ -0,0 +1,442 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include "misc.h"
+#include "image.h"
+#include "symbol.h"
+#include "parallel.h"
+#include "columns.h"
+
+// files turned into batches at once, bounds the memory of batches not yet written
+#define COLUMNS_GROUP_SIZE 64
+
+// how the values of a column are taken from the rows of its table
+enum column_source {
+	SOURCE_MEMBER,			// the member at offset, as wide as the column
+	SOURCE_NAME,
+	SOURCE_SYMBOL_TYPE,
+	SOURCE_SYMBOL_BIND,
+	SOURCE_SYMBOL_VISIBILITY
+};
+
+struct column_field {
+	const char *name;
+	enum column_table table;
+	enum column_type type;
+	enum column_source source;
+	size_t offset;
+};
+
+// symbols of every symbol table go into one table, table is the index of the section they come from
+struct symbol_row {
+	Elf64_Sym symbol;
+	uint32_t table;
+};
+
+// a name that would not fit a descriptor with its terminator stops the build
+#define COLUMN_NAME(name) ((name) + 0 * sizeof(char[sizeof(name) <= COLUMN_NAME_SIZE ? 1 : -1]))
+
+// columns are named like the fields of --where
+static const struct column_field column_fields[] = {
+	{COLUMN_NAME("name"), COLUMN_SECTIONS, COLUMN_STRING, SOURCE_NAME, 0},
+	{COLUMN_NAME("type"), COLUMN_SECTIONS, COLUMN_U32, SOURCE_MEMBER, offsetof(Elf64_Shdr, sh_type)},
+	{COLUMN_NAME("flags"), COLUMN_SECTIONS, COLUMN_U64, SOURCE_MEMBER, offsetof(Elf64_Shdr, sh_flags)},
+	{COLUMN_NAME("addr"), COLUMN_SECTIONS, COLUMN_U64, SOURCE_MEMBER, offsetof(Elf64_Shdr, sh_addr)},
+	{COLUMN_NAME("offset"), COLUMN_SECTIONS, COLUMN_U64, SOURCE_MEMBER, offsetof(Elf64_Shdr, sh_offset)},
+	{COLUMN_NAME("size"), COLUMN_SECTIONS, COLUMN_U64, SOURCE_MEMBER, offsetof(Elf64_Shdr, sh_size)},
+	{COLUMN_NAME("link"), COLUMN_SECTIONS, COLUMN_U32, SOURCE_MEMBER, offsetof(Elf64_Shdr, sh_link)},
+	{COLUMN_NAME("info"), COLUMN_SECTIONS, COLUMN_U32, SOURCE_MEMBER, offsetof(Elf64_Shdr, sh_info)},
+	{COLUMN_NAME("align"), COLUMN_SECTIONS, COLUMN_U64, SOURCE_MEMBER, offsetof(Elf64_Shdr, sh_addralign)},
+	{COLUMN_NAME("entsize"), COLUMN_SECTIONS, COLUMN_U64, SOURCE_MEMBER, offsetof(Elf64_Shdr, sh_entsize)},
+	{COLUMN_NAME("type"), COLUMN_SEGMENTS, COLUMN_U32, SOURCE_MEMBER, offsetof(Elf64_Phdr, p_type)},
+	{COLUMN_NAME("flags"), COLUMN_SEGMENTS, COLUMN_U32, SOURCE_MEMBER, offsetof(Elf64_Phdr, p_flags)},
+	{COLUMN_NAME("offset"), COLUMN_SEGMENTS, COLUMN_U64, SOURCE_MEMBER, offsetof(Elf64_Phdr, p_offset)},
+	{COLUMN_NAME("vaddr"), COLUMN_SEGMENTS, COLUMN_U64, SOURCE_MEMBER, offsetof(Elf64_Phdr, p_vaddr)},
+	{COLUMN_NAME("paddr"), COLUMN_SEGMENTS, COLUMN_U64, SOURCE_MEMBER, offsetof(Elf64_Phdr, p_paddr)},
+	{COLUMN_NAME("filesz"), COLUMN_SEGMENTS, COLUMN_U64, SOURCE_MEMBER, offsetof(Elf64_Phdr, p_filesz)},
+	{COLUMN_NAME("memsz"), COLUMN_SEGMENTS, COLUMN_U64, SOURCE_MEMBER, offsetof(Elf64_Phdr, p_memsz)},
+	{COLUMN_NAME("align"), COLUMN_SEGMENTS, COLUMN_U64, SOURCE_MEMBER, offsetof(Elf64_Phdr, p_align)},
+	{COLUMN_NAME("name"), COLUMN_SYMBOLS, COLUMN_STRING, SOURCE_NAME, 0},
+	{COLUMN_NAME("value"), COLUMN_SYMBOLS, COLUMN_U64, SOURCE_MEMBER, offsetof(struct symbol_row, symbol.st_value)},
+	{COLUMN_NAME("size"), COLUMN_SYMBOLS, COLUMN_U64, SOURCE_MEMBER, offsetof(struct symbol_row, symbol.st_size)},
+	{COLUMN_NAME("type"), COLUMN_SYMBOLS, COLUMN_U8, SOURCE_SYMBOL_TYPE, offsetof(struct symbol_row, symbol.st_info)},
+	{COLUMN_NAME("bind"), COLUMN_SYMBOLS, COLUMN_U8, SOURCE_SYMBOL_BIND, offsetof(struct symbol_row, symbol.st_info)},
+	{COLUMN_NAME("vis"), COLUMN_SYMBOLS, COLUMN_U8, SOURCE_SYMBOL_VISIBILITY, offsetof(struct symbol_row, symbol.st_other)},
+	{COLUMN_NAME("section"), COLUMN_SYMBOLS, COLUMN_U16, SOURCE_MEMBER, offsetof(struct symbol_row, symbol.st_shndx)},
+	{COLUMN_NAME("table"), COLUMN_SYMBOLS, COLUMN_U32, SOURCE_MEMBER, offsetof(struct symbol_row, table)}
+};
+
+#define COLUMN_FIELD_COUNT (sizeof(column_fields) / sizeof(column_fields[0]))
+
+// rows of one table, read in place from the structures of the image
+struct column_rows {
+	const unsigned char *rows;
+	size_t stride;
+	size_t count;
+	const char **names;
+};
+
+struct column_buffer {
+	unsigned char *data;
+	size_t size;
+	size_t capacity;
+};
+
+struct column_result {
+	const char *filename;
+	struct column_buffer batch;
+	size_t row_counts[COLUMN_SYMBOLS + 1];
+	int status;
+};
+
+struct column_job {
+	struct column_result *results;
+};
+
+static size_t align8(size_t value)
+{
+	return (value + 7) & ~(size_t)7;
+}
+
+// appends size zeroed bytes at the next 8 byte boundary, returns their offset
+static size_t reserve_bytes(struct column_buffer *buffer, size_t size)
+{
+	size_t offset = align8(buffer->size);
+
+	if(offset + size > buffer->capacity)
+	{
+		size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+
+		while(capacity < offset + size)
+			capacity *= 2;
+		buffer->data = realloc_wrap(buffer->data, capacity);
+		buffer->capacity = capacity;
+	}
+
+	memset(buffer->data + buffer->size, 0, offset + size - buffer->size);
+	buffer->size = offset + size;
+	return offset;
+}
+
+static size_t get_column_width(enum column_type type)
+{
+	switch(type)
+	{
+	case COLUMN_U8:
+		return 1;
+	case COLUMN_U16:
+		return 2;
+	case COLUMN_U32:
+		return 4;
+	default:
+		return 8;
+	}
+}
+
+static uint64_t get_column_value(const struct column_field *field, const unsigned char *row)
+{
+	uint8_t value8;
+	uint16_t value16;
+	uint32_t value32;
+	uint64_t value64;
+
+	switch(get_column_width(field->type))
+	{
+	case 1:
+		memcpy(&value8, row + field->offset, 1);
+		value64 = value8;
+		break;
+	case 2:
+		memcpy(&value16, row + field->offset, 2);
+		value64 = value16;
+		break;
+	case 4:
+		memcpy(&value32, row + field->offset, 4);
+		value64 = value32;
+		break;
+	default:
+		memcpy(&value64, row + field->offset, 8);
+		break;
+	}
+
+	switch(field->source)
+	{
+	case SOURCE_SYMBOL_TYPE:
+		return ELF64_ST_TYPE(value64);
+	case SOURCE_SYMBOL_BIND:
+		return ELF64_ST_BIND(value64);
+	case SOURCE_SYMBOL_VISIBILITY:
+		return ELF64_ST_VISIBILITY(value64);
+	default:
+		return value64;
+	}
+}
+
+static void add_string_column(struct column_buffer *buffer, struct column_descriptor *descriptor, const struct column_rows *rows)
+{
+	size_t blob_size = 0;
+	uint64_t position = 0;
+
+	for(size_t i = 0; i < rows->count; i++)
+		blob_size += strlen(rows->names[i]);
+
+	descriptor->offset = reserve_bytes(buffer, sizeof(uint64_t) * (rows->count + 1));
+	descriptor->blob = reserve_bytes(buffer, blob_size);
+
+	for(size_t i = 0; i < rows->count; i++)
+	{
+		size_t length = strlen(rows->names[i]);
+
+		memcpy(buffer->data + descriptor->offset + i * sizeof(uint64_t), &position, sizeof(uint64_t));
+		memcpy(buffer->data + descriptor->blob + position, rows->names[i], length);
+		position += length;
+	}
+	memcpy(buffer->data + descriptor->offset + rows->count * sizeof(uint64_t), &position, sizeof(uint64_t));
+}
+
+static void add_fixed_column(struct column_buffer *buffer, struct column_descriptor *descriptor,
+	const struct column_field *field, const struct column_rows *rows)
+{
+	size_t width = get_column_width(field->type);
+	unsigned char *values = NULL;
+
+	descriptor->offset = reserve_bytes(buffer, width * rows->count);
+	values = buffer->data + descriptor->offset;
+
+	for(size_t i = 0; i < rows->count; i++)
+	{
+		uint64_t value = get_column_value(field, rows->rows + i * rows->stride);
+		uint8_t value8 = (uint8_t)value;
+		uint16_t value16 = (uint16_t)value;
+		uint32_t value32 = (uint32_t)value;
+
+		switch(width)
+		{
+		case 1:
+			memcpy(values + i, &value8, 1);
+			break;
+		case 2:
+			memcpy(values + i * 2, &value16, 2);
+			break;
+		case 4:
+			memcpy(values + i * 4, &value32, 4);
+			break;
+		default:
+			memcpy(values + i * 8, &value, 8);
+			break;
+		}
+	}
+}
+
+// symbols of .symtab and .dynsym, names point into the image
+static size_t load_symbol_rows(const struct elf_image *image, const char *filename, struct symbol_row **rows, const char ***names)
+{
+	struct symbol_table symbols;
+	size_t count = 0;
+	int ret;
+
+	*rows = NULL;
+	*names = NULL;
+
+	for(size_t i = 0; i < image->header.e_shnum; i++)
+	{
+		const Elf64_Shdr *section = &image->section_headers[i];
+
+		if(section->sh_type != SHT_SYMTAB && section->sh_type != SHT_DYNSYM)
+			continue;
+
+		ret = load_symbol_table(image, section, &symbols);
+		if(ret != 0)
+			error(0, ret, "\'%s\': cannot read symbol table \'%s\'", filename, get_section_name(image, section));
+		else if(symbols.count > 0)
+		{
+			*rows = realloc_wrap(*rows, sizeof(struct symbol_row) * (count + symbols.count));
+			*names = realloc_wrap(*names, sizeof(char*) * (count + symbols.count));
+
+			for(size_t j = 0; j < symbols.count; j++)
+			{
+				(*rows)[count + j].symbol = symbols.symbols[j];
+				(*rows)[count + j].table = (uint32_t)i;
+				(*names)[count + j] = get_symbol_name(&symbols, &symbols.symbols[j]);
+			}
+			count += symbols.count;
+		}
+		free_symbol_table(&symbols);
+	}
+
+	return count;
+}
+
+// one batch holds every table of one file
+static int build_batch(struct column_result *result)
+{
+	struct elf_image image;
+	struct column_buffer *buffer = &result->batch;
+	struct column_rows tables[COLUMN_SYMBOLS + 1];
+	struct column_descriptor descriptor;
+	struct column_batch header;
+	struct symbol_row *symbol_rows = NULL;
+	const char **section_names = NULL;
+	const char **symbol_names = NULL;
+	size_t symbol_count, path_size, descriptors;
+	int ret;
+
+	ret = open_elf_image(&image, result->filename);
+	if(ret != 0)
+	{
+		free_elf_image(&image);
+		return ret;
+	}
+
+	section_names = malloc_wrap(sizeof(char*) * (image.header.e_shnum + 1));
+	for(size_t i = 0; i < image.header.e_shnum; i++)
+		section_names[i] = get_section_name(&image, &image.section_headers[i]);
+	symbol_count = load_symbol_rows(&image, result->filename, &symbol_rows, &symbol_names);
+
+	memset(tables, 0, sizeof(tables));
+	tables[COLUMN_SECTIONS] = (struct column_rows){(const unsigned char*)image.section_headers, sizeof(Elf64_Shdr), image.header.e_shnum, section_names};
+	tables[COLUMN_SEGMENTS] = (struct column_rows){(const unsigned char*)image.program_headers, sizeof(Elf64_Phdr), image.header.e_phnum, NULL};
+	tables[COLUMN_SYMBOLS] = (struct column_rows){(const unsigned char*)symbol_rows, sizeof(struct symbol_row), symbol_count, symbol_names};
+
+	path_size = strlen(result->filename);
+	reserve_bytes(buffer, sizeof(struct column_batch));
+	descriptors = reserve_bytes(buffer, sizeof(struct column_descriptor) * COLUMN_FIELD_COUNT);
+
+	memset(&header, 0, sizeof(header));
+	header.path = reserve_bytes(buffer, path_size);
+	header.path_size = (uint32_t)path_size;
+	header.column_count = COLUMN_FIELD_COUNT;
+	header.elf_class = (uint32_t)image.elf_class;
+	header.machine = image.header.e_machine;
+	memcpy(buffer->data + header.path, result->filename, path_size);
+
+	for(size_t i = 0; i < COLUMN_FIELD_COUNT; i++)
+	{
+		const struct column_field *field = &column_fields[i];
+		const struct column_rows *rows = &tables[field->table];
+
+		memset(&descriptor, 0, sizeof(descriptor));
+		memcpy(descriptor.name, field->name, strlen(field->name));
+		descriptor.table = field->table;
+		descriptor.type = field->type;
+		descriptor.rows = rows->count;
+
+		if(field->source == SOURCE_NAME)
+			add_string_column(buffer, &descriptor, rows);
+		else
+			add_fixed_column(buffer, &descriptor, field, rows);
+
+		memcpy(buffer->data + descriptors + i * sizeof(descriptor), &descriptor, sizeof(descriptor));
+	}
+
+	reserve_bytes(buffer, 0);
+	header.size = buffer->size;
+	memcpy(buffer->data, &header, sizeof(header));
+
+	for(size_t i = COLUMN_SECTIONS; i <= COLUMN_SYMBOLS; i++)
+		result->row_counts[i] = tables[i].count;
+
+	free(section_names);
+	free(symbol_names);
+	free(symbol_rows);
+	free_elf_image(&image);
+	return 0;
+}
+
+static void build_batch_job(size_t index, void *arg)
+{
+	struct column_job *job = arg;
+
+	job->results[index].status = build_batch(&job->results[index]);
+}
+
+static void write_bytes(FILE *fp, const void *data, size_t size, const char *output)
+{
+	if(size > 0 && fwrite(data, 1, size, fp) != size)
+		error(EXIT_FAILURE, errno, "cannot write file \'%s\'", output);
+}
+
+/*
+ * writes the section, program header and symbol tables of every file as
+ * typed columns to output ('-' is stdout), one batch per file in the order
+ * given. files are parsed in parallel in groups, so only a group of batches
+ * is held in memory at once
+ */
+void export_columns(char **filenames, size_t count, const char *output)
+{
+	assert(filenames != NULL);
+	assert(output != NULL);
+
+	struct columns_header header;
+	struct column_result *results = NULL;
+	struct column_job job;
+	uint64_t *batch_offsets = NULL;
+	uint64_t position = 0, batch_count = 0;
+	size_t totals[COLUMN_SYMBOLS + 1] = {0};
+	bool to_stdout = strcmp(output, "-") == 0;
+	FILE *fp = NULL;
+
+	fp = to_stdout ? stdout : fopen_wrap(output, "wb");
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, COLUMNS_MAGIC, sizeof(header.magic));
+	header.version = COLUMNS_VERSION;
+	write_bytes(fp, &header, sizeof(header), output);
+	position += sizeof(header);
+
+	batch_offsets = malloc_wrap(sizeof(uint64_t) * (count + 1));
+	results = malloc_wrap(sizeof(struct column_result) * COLUMNS_GROUP_SIZE);
+	job.results = results;
+
+	for(size_t start = 0; start < count; start += COLUMNS_GROUP_SIZE)
+	{
+		size_t group_size = count - start < COLUMNS_GROUP_SIZE ? count - start : COLUMNS_GROUP_SIZE;
+
+		memset(results, 0, sizeof(struct column_result) * group_size);
+		for(size_t i = 0; i < group_size; i++)
+			results[i].filename = filenames[start + i];
+
+		parallel_for(group_size, build_batch_job, &job);
+
+		for(size_t i = 0; i < group_size; i++)
+		{
+			struct column_result *result = &results[i];
+
+			if(result->status != 0)
+				error(0, result->status, "\'%s\' is not a valid elf file", result->filename);
+			else
+			{
+				batch_offsets[batch_count++] = position;
+				write_bytes(fp, result->batch.data, result->batch.size, output);
+				position += result->batch.size;
+
+				for(size_t j = COLUMN_SECTIONS; j <= COLUMN_SYMBOLS; j++)
+					totals[j] += result->row_counts[j];
+			}
+			free(result->batch.data);
+		}
+	}
+
+	write_bytes(fp, batch_offsets, sizeof(uint64_t) * batch_count, output);
+	write_bytes(fp, &batch_count, sizeof(batch_count), output);
+	write_bytes(fp, COLUMNS_MAGIC, 8, output);
+	position += sizeof(uint64_t) * (batch_count + 1) + 8;
+
+	if(fflush(fp) != 0 || (!to_stdout && fclose(fp) != 0))
+		error(EXIT_FAILURE, errno, "cannot write file \'%s\'", output);
+
+	// the summary must not mix with the columns written to stdout
+	fprintf(to_stdout ? stderr : stdout, "%lu files, %zu sections, %zu program headers, %zu symbols: %lu bytes written to \'%s\'\n",
+		batch_count, totals[COLUMN_SECTIONS], totals[COLUMN_SEGMENTS], totals[COLUMN_SYMBOLS], position, output);
+
+	free(results);
+	free(batch_offsets);
+}
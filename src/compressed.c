@@ -0,0 +1,424 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "misc.h"
+#include "image.h"
+#include "parallel.h"
+#include "compressed.h"
+
+#ifndef ELFCOMPRESS_ZSTD
+#define ELFCOMPRESS_ZSTD 2
+#endif
+
+// size of the buffer decompressed content is handed out in, this bounds
+// the memory needed per section no matter how large it inflates
+#define SECTION_CHUNK_SIZE (64 * 1024)
+
+struct compressed_section {
+	Elf64_Shdr *section;
+	Elf64_Chdr chdr;
+	uint64_t inflated;	// bytes actually produced by decompression
+	int status;
+};
+
+int read_section_chdr(const struct elf_image *image, const Elf64_Shdr *section, Elf64_Chdr *chdr, size_t *chdr_size)
+{
+	assert(image != NULL);
+	assert(section != NULL);
+	assert(chdr != NULL);
+
+	unsigned char *data = NULL;
+
+	if(!(section->sh_flags & SHF_COMPRESSED))
+		return EINVAL;
+
+	data = get_section_data(image, section);
+	if(!data)
+		return EBADF;
+
+	if(image->elf_class == ELFCLASS32)
+	{
+		Elf32_Chdr chdr32;
+
+		if(section->sh_size < sizeof(Elf32_Chdr))
+			return EBADF;
+
+		memcpy(&chdr32, data, sizeof(Elf32_Chdr));
+		chdr->ch_type = chdr32.ch_type;
+		chdr->ch_reserved = 0;
+		chdr->ch_size = chdr32.ch_size;
+		chdr->ch_addralign = chdr32.ch_addralign;
+		*chdr_size = sizeof(Elf32_Chdr);
+	}
+	else
+	{
+		if(section->sh_size < sizeof(Elf64_Chdr))
+			return EBADF;
+
+		memcpy(chdr, data, sizeof(Elf64_Chdr));
+		*chdr_size = sizeof(Elf64_Chdr);
+	}
+
+	return 0;
+}
+
+uint64_t get_section_content_size(const struct elf_image *image, const Elf64_Shdr *section)
+{
+	Elf64_Chdr chdr;
+	size_t chdr_size;
+
+	if(read_section_chdr(image, section, &chdr, &chdr_size) == 0)
+		return chdr.ch_size;
+
+	return section->sh_size;
+}
+
+static int inflate_zlib_chunks(const unsigned char *src, size_t size, section_chunk_func func, void *arg)
+{
+	unsigned char *chunk = NULL;
+	z_stream zs;
+	int ret, status = 0;
+
+	memset(&zs, 0, sizeof(zs));
+	if(inflateInit(&zs) != Z_OK)
+		return ENOMEM;
+
+	chunk = malloc_wrap(SECTION_CHUNK_SIZE);
+
+	zs.next_in = (Bytef*)(uintptr_t)src;
+	zs.avail_in = 0;
+
+	do {
+		// avail_in is an uInt, so huge sections are fed in pieces
+		if(zs.avail_in == 0)
+		{
+			size_t feed = size > UINT32_MAX ? UINT32_MAX : size;
+			zs.avail_in = (uInt)feed;
+			size -= feed;
+		}
+
+		zs.next_out = chunk;
+		zs.avail_out = SECTION_CHUNK_SIZE;
+
+		ret = inflate(&zs, Z_NO_FLUSH);
+		if(ret != Z_OK && ret != Z_STREAM_END)
+		{
+			status = EBADMSG;
+			break;
+		}
+
+		if(SECTION_CHUNK_SIZE - zs.avail_out > 0 &&
+			func(chunk, SECTION_CHUNK_SIZE - zs.avail_out, arg) != 0)
+			break;
+
+		if(ret != Z_STREAM_END && zs.avail_in == 0 && size == 0 && zs.avail_out != 0)
+		{
+			status = EBADMSG;	// truncated stream
+			break;
+		}
+	} while(ret != Z_STREAM_END);
+
+	inflateEnd(&zs);
+	free(chunk);
+	return status;
+}
+
+#ifdef HAVE_ZSTD
+static int inflate_zstd_chunks(const unsigned char *src, size_t size, section_chunk_func func, void *arg)
+{
+	unsigned char *chunk = NULL;
+	ZSTD_DStream *zs = NULL;
+	ZSTD_inBuffer in = { src, size, 0 };
+	size_t ret = 1;
+	int status = 0;
+
+	zs = ZSTD_createDStream();
+	if(!zs)
+		return ENOMEM;
+
+	chunk = malloc_wrap(SECTION_CHUNK_SIZE);
+
+	// a section may hold several concatenated frames
+	while(in.pos < in.size || ret != 0)
+	{
+		ZSTD_outBuffer out = { chunk, SECTION_CHUNK_SIZE, 0 };
+		size_t consumed = in.pos;
+
+		ret = ZSTD_decompressStream(zs, &out, &in);
+		if(ZSTD_isError(ret))
+		{
+			status = EBADMSG;
+			break;
+		}
+
+		if(out.pos > 0 && func(chunk, out.pos, arg) != 0)
+			break;
+
+		if(out.pos == 0 && in.pos == consumed)
+		{
+			if(ret != 0)
+				status = EBADMSG;	// truncated stream
+			break;
+		}
+	}
+
+	ZSTD_freeDStream(zs);
+	free(chunk);
+	return status;
+}
+#endif
+
+// hands the section content to func piece by piece: plain sections straight
+// from the mapping, compressed ones through a fixed size decompression buffer
+int read_section_chunks(const struct elf_image *image, const Elf64_Shdr *section, section_chunk_func func, void *arg)
+{
+	assert(image != NULL);
+	assert(section != NULL);
+	assert(func != NULL);
+
+	unsigned char *data = NULL;
+	Elf64_Chdr chdr;
+	size_t chdr_size;
+	int ret;
+
+	data = get_section_data(image, section);
+	if(!data)
+		return section->sh_type == SHT_NOBITS ? 0 : EBADF;
+
+	if(!(section->sh_flags & SHF_COMPRESSED))
+	{
+		for(uint64_t offset = 0; offset < section->sh_size; offset += SECTION_CHUNK_SIZE)
+		{
+			uint64_t size = section->sh_size - offset;
+
+			if(size > SECTION_CHUNK_SIZE)
+				size = SECTION_CHUNK_SIZE;
+			if(func(data + offset, (size_t)size, arg) != 0)
+				break;
+		}
+		return 0;
+	}
+
+	ret = read_section_chdr(image, section, &chdr, &chdr_size);
+	if(ret != 0)
+		return ret;
+
+	switch(chdr.ch_type)
+	{
+	case ELFCOMPRESS_ZLIB:
+		return inflate_zlib_chunks(data + chdr_size, section->sh_size - chdr_size, func, arg);
+#ifdef HAVE_ZSTD
+	case ELFCOMPRESS_ZSTD:
+		return inflate_zstd_chunks(data + chdr_size, section->sh_size - chdr_size, func, arg);
+#endif
+	default:
+		return ENOTSUP;
+	}
+}
+
+struct content_buffer {
+	unsigned char *data;
+	size_t size;
+	size_t capacity;
+};
+
+static int append_chunk(const unsigned char *chunk, size_t size, void *arg)
+{
+	struct content_buffer *buffer = arg;
+
+	if(size > buffer->capacity - buffer->size)
+		return 1;	// more than ch_size promised
+
+	memcpy(buffer->data + buffer->size, chunk, size);
+	buffer->size += size;
+	return 0;
+}
+
+// for consumers that need random access to a section: plain sections are
+// returned in place, compressed ones are inflated into a buffer of ch_size
+int load_section_content(const struct elf_image *image, const Elf64_Shdr *section, struct section_content *content)
+{
+	assert(image != NULL);
+	assert(section != NULL);
+	assert(content != NULL);
+
+	struct content_buffer buffer;
+	Elf64_Chdr chdr;
+	size_t chdr_size;
+	int ret;
+
+	memset(content, 0, sizeof(struct section_content));
+
+	if(!(section->sh_flags & SHF_COMPRESSED))
+	{
+		content->data = get_section_data(image, section);
+		content->size = (size_t)section->sh_size;
+		return content->data ? 0 : EBADF;
+	}
+
+	ret = read_section_chdr(image, section, &chdr, &chdr_size);
+	if(ret != 0)
+		return ret;
+
+	if(chdr.ch_size > SIZE_MAX - 1)
+		return EFBIG;
+
+	buffer.data = malloc_wrap((size_t)chdr.ch_size + 1);
+	buffer.size = 0;
+	buffer.capacity = (size_t)chdr.ch_size;
+
+	ret = read_section_chunks(image, section, append_chunk, &buffer);
+	if(ret == 0 && buffer.size != buffer.capacity)
+		ret = EBADMSG;
+
+	if(ret != 0)
+	{
+		free(buffer.data);
+		return ret;
+	}
+
+	content->data = buffer.data;
+	content->size = buffer.size;
+	content->allocated = true;
+	return 0;
+}
+
+void free_section_content(struct section_content *content)
+{
+	assert(content != NULL);
+
+	if(content->allocated)
+		free(content->data);
+
+	memset(content, 0, sizeof(struct section_content));
+}
+
+static const char* get_compression_type(uint32_t type)
+{
+	switch(type)
+	{
+	case ELFCOMPRESS_ZLIB:
+		return "ZLIB";
+	case ELFCOMPRESS_ZSTD:
+		return "ZSTD";
+	default:
+		return "Unknown";
+	}
+}
+
+static int count_chunk(const unsigned char *chunk, size_t size, void *arg)
+{
+	uint64_t *inflated = arg;
+
+	(void)chunk;
+	*inflated += size;
+	return 0;
+}
+
+struct compressed_job {
+	struct elf_image *image;
+	struct compressed_section *sections;
+};
+
+static void inflate_compressed_section(size_t index, void *arg)
+{
+	struct compressed_job *job = arg;
+	struct compressed_section *cs = &job->sections[index];
+
+	cs->status = read_section_chunks(job->image, cs->section, count_chunk, &cs->inflated);
+	if(cs->status == 0 && cs->inflated != cs->chdr.ch_size)
+		cs->status = EBADMSG;
+}
+
+static const char* get_compression_status(int status)
+{
+	switch(status)
+	{
+	case 0:
+		return "ok";
+	case ENOTSUP:
+		return "unsupported";
+	default:
+		return "corrupt";
+	}
+}
+
+void print_compressed_sections(const char *filename)
+{
+	assert(filename != NULL);
+
+	struct elf_image image;
+	struct compressed_section *sections = NULL;
+	struct compressed_job job;
+	size_t count = 0;
+	uint64_t total_compressed = 0, total_uncompressed = 0;
+	int ret;
+
+	ret = open_elf_image(&image, filename);
+	if(ret != 0)
+	{
+		error(0, ret, "\'%s\' is not a valid elf file", filename);
+		free_elf_image(&image);
+		return;
+	}
+
+	sections = malloc_wrap(sizeof(struct compressed_section) * (image.header.e_shnum + 1u));
+
+	for(size_t i = 0; i < image.header.e_shnum; i++)
+	{
+		struct compressed_section *cs = &sections[count];
+		size_t chdr_size;
+
+		cs->section = &image.section_headers[i];
+		cs->inflated = 0;
+		if(read_section_chdr(&image, cs->section, &cs->chdr, &chdr_size) == 0)
+			count++;
+	}
+
+	// sections are independent, so they are decompressed concurrently
+	job.image = &image;
+	job.sections = sections;
+	parallel_for(count, inflate_compressed_section, &job);
+
+	printf("There are %zu compressed sections\n\n", count);
+
+	printf("Compressed sections:\n");
+	printf("  [Nr] Name               Type Compressed       Uncompressed     Ratio   Status\n");
+
+	for(size_t i = 0; i < count; i++)
+	{
+		struct compressed_section *cs = &sections[i];
+		double ratio = cs->chdr.ch_size ? (double)cs->section->sh_size / (double)cs->chdr.ch_size : 0.0;
+
+		printf("  [%2zu] %-18s %-4s %016lx %016lx %6.2f%% %s\n",
+			(size_t)(cs->section - image.section_headers),
+			get_section_name(&image, cs->section),
+			get_compression_type(cs->chdr.ch_type),
+			cs->section->sh_size,
+			cs->chdr.ch_size,
+			ratio * 100.0,
+			get_compression_status(cs->status));
+
+		total_compressed += cs->section->sh_size;
+		total_uncompressed += cs->chdr.ch_size;
+	}
+
+	if(count > 0)
+		printf("\n  Total: %lu bytes compressed, %lu bytes uncompressed (%.2f%%)\n",
+			total_compressed, total_uncompressed,
+			total_uncompressed ? 100.0 * (double)total_compressed / (double)total_uncompressed : 0.0);
+
+	free(sections);
+	free_elf_image(&image);
+}
\ No newline at end of file
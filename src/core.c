@@ -0,0 +1,612 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "misc.h"
+#include "elf_header.h"
+#include "core.h"
+
+/*
+ * core files are read with pread: the elf header, the program headers and
+ * the PT_NOTE segments, one at a time. memory contents (PT_LOAD) are never
+ * touched, so the size of the core does not matter.
+ */
+
+// a note segment bigger than this is not a note segment
+#define CORE_NOTE_MAX (256 * 1024 * 1024)
+
+struct core_file {
+	const char *filename;
+	int fd;
+	off_t size;
+	int elf_class;
+	size_t word_size;
+	Elf64_Ehdr header;
+	Elf64_Phdr *program_headers;
+	size_t phnum;
+	// NT_FILE table, kept to name the load segments
+	uint64_t *file_ranges;	// start, end, offset (in pages) of every mapping
+	char **file_names;
+	size_t file_count;
+	uint64_t page_size;
+	size_t thread_count;
+};
+
+static const char * const x86_64_registers[] = {
+	"r15", "r14", "r13", "r12", "rbp", "rbx", "r11", "r10", "r9", "r8",
+	"rax", "rcx", "rdx", "rsi", "rdi", "orig_rax", "rip", "cs", "eflags",
+	"rsp", "ss", "fs_base", "gs_base", "ds", "es", "fs", "gs"
+};
+
+static const char * const i386_registers[] = {
+	"ebx", "ecx", "edx", "esi", "edi", "ebp", "eax", "ds", "es", "fs", "gs",
+	"orig_eax", "eip", "cs", "eflags", "esp", "ss"
+};
+
+static const char * const aarch64_registers[] = {
+	"x0", "x1", "x2", "x3", "x4", "x5", "x6", "x7", "x8", "x9", "x10",
+	"x11", "x12", "x13", "x14", "x15", "x16", "x17", "x18", "x19", "x20",
+	"x21", "x22", "x23", "x24", "x25", "x26", "x27", "x28", "x29", "x30",
+	"sp", "pc", "pstate"
+};
+
+struct auxv_name {
+	uint64_t type;
+	const char *name;
+};
+
+static const struct auxv_name auxv_names[] = {
+	{AT_PHDR, "AT_PHDR"},
+	{AT_PHENT, "AT_PHENT"},
+	{AT_PHNUM, "AT_PHNUM"},
+	{AT_PAGESZ, "AT_PAGESZ"},
+	{AT_BASE, "AT_BASE"},
+	{AT_FLAGS, "AT_FLAGS"},
+	{AT_ENTRY, "AT_ENTRY"},
+	{AT_UID, "AT_UID"},
+	{AT_EUID, "AT_EUID"},
+	{AT_GID, "AT_GID"},
+	{AT_EGID, "AT_EGID"},
+	{AT_PLATFORM, "AT_PLATFORM"},
+	{AT_HWCAP, "AT_HWCAP"},
+	{AT_CLKTCK, "AT_CLKTCK"},
+	{AT_SECURE, "AT_SECURE"},
+	{AT_BASE_PLATFORM, "AT_BASE_PLATFORM"},
+	{AT_RANDOM, "AT_RANDOM"},
+	{AT_HWCAP2, "AT_HWCAP2"},
+	{AT_EXECFN, "AT_EXECFN"},
+	{AT_SYSINFO_EHDR, "AT_SYSINFO_EHDR"},
+	// newer than some elf.h
+	{27, "AT_RSEQ_FEATURE_SIZE"},
+	{28, "AT_RSEQ_ALIGN"},
+	{51, "AT_MINSIGSTKSZ"},
+	{0, NULL}
+};
+
+static bool read_at(const struct core_file *core, void *buffer, size_t size, uint64_t offset)
+{
+	unsigned char *pos = buffer;
+
+	if(offset > (uint64_t)core->size || size > (uint64_t)core->size - offset)
+		return false;
+
+	while(size > 0)
+	{
+		ssize_t ret = pread(core->fd, pos, size, (off_t)offset);
+
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			return false;
+
+		pos += ret;
+		offset += (uint64_t)ret;
+		size -= (size_t)ret;
+	}
+
+	return true;
+}
+
+// a word of the core's class at pos, 0 past end
+static uint64_t read_word(const struct core_file *core, const unsigned char *desc, size_t size, size_t offset)
+{
+	if(offset > size || core->word_size > size - offset)
+		return 0;
+
+	if(core->word_size == 4)
+	{
+		uint32_t value;
+
+		memcpy(&value, desc + offset, sizeof(value));
+		return value;
+	}
+	else
+	{
+		uint64_t value;
+
+		memcpy(&value, desc + offset, sizeof(value));
+		return value;
+	}
+}
+
+static uint32_t read_u32(const unsigned char *desc, size_t size, size_t offset)
+{
+	uint32_t value = 0;
+
+	if(offset <= size && sizeof(value) <= size - offset)
+		memcpy(&value, desc + offset, sizeof(value));
+
+	return value;
+}
+
+static int read_core_headers(struct core_file *core)
+{
+	unsigned char ident[EI_NIDENT];
+
+	if(!read_at(core, ident, EI_NIDENT, 0) || memcmp(ident, ELFMAG, SELFMAG) != 0)
+		return ENOEXEC;
+
+	core->elf_class = ident[EI_CLASS];
+	if(core->elf_class == ELFCLASS64)
+	{
+		if(!read_at(core, &core->header, sizeof(Elf64_Ehdr), 0))
+			return EBADF;
+		core->word_size = 8;
+	}
+	else if(core->elf_class == ELFCLASS32)
+	{
+		Elf32_Ehdr header;
+
+		if(!read_at(core, &header, sizeof(Elf32_Ehdr), 0))
+			return EBADF;
+		memcpy(core->header.e_ident, header.e_ident, EI_NIDENT);
+		core->header.e_type = header.e_type;
+		core->header.e_machine = header.e_machine;
+		core->header.e_phoff = header.e_phoff;
+		core->header.e_shoff = header.e_shoff;
+		core->header.e_phentsize = header.e_phentsize;
+		core->header.e_phnum = header.e_phnum;
+		core->word_size = 4;
+	}
+	else
+		return EBADF;
+
+	if(core->header.e_type != ET_CORE)
+		return ENOEXEC;
+
+	core->phnum = core->header.e_phnum;
+
+	// more than 65534 mappings: the count is in sh_info of section 0
+	if(core->phnum == PN_XNUM)
+	{
+		if(core->elf_class == ELFCLASS64)
+		{
+			Elf64_Shdr section;
+
+			if(!read_at(core, &section, sizeof(section), core->header.e_shoff))
+				return EBADF;
+			core->phnum = section.sh_info;
+		}
+		else
+		{
+			Elf32_Shdr section;
+
+			if(!read_at(core, &section, sizeof(section), core->header.e_shoff))
+				return EBADF;
+			core->phnum = section.sh_info;
+		}
+	}
+
+	core->program_headers = malloc_wrap(sizeof(Elf64_Phdr) * (core->phnum + 1));
+
+	for(size_t i = 0; i < core->phnum; i++)
+	{
+		Elf64_Phdr *phdr = &core->program_headers[i];
+
+		if(core->elf_class == ELFCLASS64)
+		{
+			if(!read_at(core, phdr, sizeof(Elf64_Phdr), core->header.e_phoff + i * sizeof(Elf64_Phdr)))
+				return EBADF;
+		}
+		else
+		{
+			Elf32_Phdr header;
+
+			if(!read_at(core, &header, sizeof(Elf32_Phdr), core->header.e_phoff + i * sizeof(Elf32_Phdr)))
+				return EBADF;
+			phdr->p_type = header.p_type;
+			phdr->p_flags = header.p_flags;
+			phdr->p_offset = header.p_offset;
+			phdr->p_vaddr = header.p_vaddr;
+			phdr->p_paddr = header.p_paddr;
+			phdr->p_filesz = header.p_filesz;
+			phdr->p_memsz = header.p_memsz;
+			phdr->p_align = header.p_align;
+		}
+	}
+
+	return 0;
+}
+
+static void get_register_names(const struct core_file *core, const char * const **names, size_t *count)
+{
+	*names = NULL;
+	*count = 0;
+
+	if(core->header.e_machine == EM_X86_64 && core->elf_class == ELFCLASS64)
+	{
+		*names = x86_64_registers;
+		*count = sizeof(x86_64_registers) / sizeof(x86_64_registers[0]);
+	}
+	else if(core->header.e_machine == EM_386)
+	{
+		*names = i386_registers;
+		*count = sizeof(i386_registers) / sizeof(i386_registers[0]);
+	}
+	else if(core->header.e_machine == EM_AARCH64)
+	{
+		*names = aarch64_registers;
+		*count = sizeof(aarch64_registers) / sizeof(aarch64_registers[0]);
+	}
+}
+
+/*
+ * struct elf_prstatus: siginfo, cursig, sigpend, sighold, pid, ppid, pgrp,
+ * sid, four timevals, the general registers and fpvalid (padded to a word)
+ */
+static void print_prstatus(struct core_file *core, const unsigned char *desc, size_t size)
+{
+	size_t word = core->word_size;
+	size_t pid_offset = 16 + 2 * word;
+	size_t reg_offset = pid_offset + 16 + 8 * word;
+	size_t reg_count = 0, name_count;
+	const char * const *names = NULL;
+	int16_t cursig = 0;
+
+	if(size > reg_offset + 2 * word)
+		reg_count = (size - reg_offset - (word == 8 ? 8 : 4)) / word;
+
+	if(size >= 14)
+		memcpy(&cursig, desc + 12, sizeof(cursig));
+
+	core->thread_count++;
+	printf("\nThread %zu: pid %u, signal %d", core->thread_count, read_u32(desc, size, pid_offset), cursig);
+	if(cursig > 0)
+		printf(" (%s)", strsignal(cursig));
+	printf("\n");
+
+	get_register_names(core, &names, &name_count);
+
+	for(size_t i = 0; i < reg_count; i++)
+	{
+		char name[24];
+
+		if(i < name_count)
+			snprintf(name, sizeof(name), "%s", names[i]);
+		else
+			snprintf(name, sizeof(name), "r%zu", i);
+
+		printf("  %-8s 0x%0*lx%s", name, (int)word * 2, read_word(core, desc, size, reg_offset + i * word),
+			i % 3 == 2 || i + 1 == reg_count ? "\n" : "");
+	}
+}
+
+/*
+ * struct elf_prpsinfo ends with fname[16] and psargs[80]; the ids in front
+ * of them are ints, except uid and gid which are 16 bit on i386
+ */
+static void print_prpsinfo(const struct core_file *core, const unsigned char *desc, size_t size)
+{
+	size_t fname_offset, pid_offset;
+	char fname[17], psargs[81];
+	char state = '?';
+
+	if(size < 96 + 16)
+	{
+		error(0, EBADMSG, "\'%s\': truncated NT_PRPSINFO note", core->filename);
+		return;
+	}
+
+	fname_offset = size - 96;
+	pid_offset = fname_offset - 16;
+
+	memcpy(fname, desc + fname_offset, 16);
+	fname[16] = '\0';
+	memcpy(psargs, desc + fname_offset + 16, 80);
+	psargs[80] = '\0';
+	if(desc[1] >= ' ' && desc[1] < 0x7f)
+		state = (char)desc[1];
+
+	printf("\nProcess: pid %u, ppid %u, pgrp %u, sid %u, state %c, command \'%s\'\n",
+		read_u32(desc, size, pid_offset),
+		read_u32(desc, size, pid_offset + 4),
+		read_u32(desc, size, pid_offset + 8),
+		read_u32(desc, size, pid_offset + 12),
+		state,
+		fname);
+	printf("  Arguments: %s\n", psargs);
+
+	if(core->word_size == 8)
+		printf("  uid %u, gid %u\n", read_u32(desc, size, 16), read_u32(desc, size, 20));
+}
+
+// siginfo_t: signo, errno, code, then (for faults) the address, word aligned
+static void print_siginfo(const struct core_file *core, const unsigned char *desc, size_t size)
+{
+	uint32_t signo = read_u32(desc, size, 0);
+	uint32_t code = read_u32(desc, size, 8);
+
+	printf("\nSignal: %u (%s), code %d", signo, strsignal((int)signo), (int)code);
+	if(signo == SIGSEGV || signo == SIGBUS || signo == SIGILL || signo == SIGFPE || signo == SIGTRAP)
+		printf(", address %#lx", read_word(core, desc, size, core->word_size == 8 ? 16 : 12));
+	printf("\n");
+}
+
+static void print_auxv(const struct core_file *core, const unsigned char *desc, size_t size)
+{
+	size_t word = core->word_size;
+
+	printf("\nAuxiliary vector:\n");
+
+	for(size_t offset = 0; offset + 2 * word <= size; offset += 2 * word)
+	{
+		uint64_t type = read_word(core, desc, size, offset);
+		uint64_t value = read_word(core, desc, size, offset + word);
+		const struct auxv_name *name = auxv_names;
+
+		if(type == AT_NULL)
+			break;
+
+		while(name->name && name->type != type)
+			name++;
+
+		if(name->name)
+			printf("  %-18s %#lx\n", name->name, value);
+		else
+			printf("  %-18lu %#lx\n", type, value);
+	}
+}
+
+// count, page size, count * (start, end, page offset), then count names
+static void read_file_note(struct core_file *core, const unsigned char *desc, size_t size)
+{
+	size_t word = core->word_size;
+	uint64_t count = read_word(core, desc, size, 0);
+	const char *name = NULL, *end = (const char*)desc + size;
+
+	if(core->file_ranges)
+		return;
+
+	if(count > size / (3 * word) || size < 2 * word + count * 3 * word)
+	{
+		error(0, EBADMSG, "\'%s\': truncated NT_FILE note", core->filename);
+		return;
+	}
+
+	core->page_size = read_word(core, desc, size, word);
+	core->file_count = (size_t)count;
+	core->file_ranges = malloc_wrap(sizeof(uint64_t) * 3 * (core->file_count + 1));
+	core->file_names = malloc_wrap(sizeof(char*) * (core->file_count + 1));
+
+	name = (const char*)desc + 2 * word + core->file_count * 3 * word;
+	for(size_t i = 0; i < core->file_count; i++)
+	{
+		size_t length = name < end ? strnlen(name, (size_t)(end - name)) : 0;
+
+		for(size_t j = 0; j < 3; j++)
+			core->file_ranges[i * 3 + j] = read_word(core, desc, size, 2 * word + (i * 3 + j) * word);
+
+		core->file_names[i] = strndup(name < end ? name : "", length);
+		if(!core->file_names[i])
+			error(EXIT_FAILURE, errno, "cannot allocate memory");
+		name += length + 1;
+	}
+}
+
+static void print_note(struct core_file *core, uint32_t type, const char *name, const unsigned char *desc, size_t size)
+{
+	if(strcmp(name, "CORE") != 0)
+		return;
+
+	switch(type)
+	{
+	case NT_PRSTATUS:
+		print_prstatus(core, desc, size);
+		break;
+	case NT_PRPSINFO:
+		print_prpsinfo(core, desc, size);
+		break;
+	case NT_SIGINFO:
+		print_siginfo(core, desc, size);
+		break;
+	case NT_AUXV:
+		print_auxv(core, desc, size);
+		break;
+	case NT_FILE:
+		read_file_note(core, desc, size);
+		break;
+	default:
+		break;
+	}
+}
+
+static void read_note_segment(struct core_file *core, const Elf64_Phdr *segment)
+{
+	unsigned char *notes = NULL;
+	size_t offset = 0, size;
+
+	if(segment->p_filesz > CORE_NOTE_MAX)
+	{
+		error(0, EFBIG, "\'%s\': note segment of %lu bytes", core->filename, segment->p_filesz);
+		return;
+	}
+
+	size = (size_t)segment->p_filesz;
+	notes = malloc_wrap(size + 1);
+	if(!read_at(core, notes, size, segment->p_offset))
+	{
+		error(0, EBADMSG, "\'%s\': note segment past end of file", core->filename);
+		free(notes);
+		return;
+	}
+
+	// core notes are 4 byte aligned for both classes
+	while(offset + sizeof(Elf64_Nhdr) <= size)
+	{
+		Elf64_Nhdr note;
+		char name[16] = "";
+		size_t name_size, desc_offset;
+
+		memcpy(&note, notes + offset, sizeof(note));
+		name_size = (note.n_namesz + 3u) & ~3u;
+		desc_offset = offset + sizeof(note) + name_size;
+
+		if(name_size > size - offset - sizeof(note) || note.n_descsz > size - desc_offset)
+		{
+			error(0, EBADMSG, "\'%s\': truncated note at offset %#lx", core->filename, segment->p_offset + offset);
+			break;
+		}
+
+		if(note.n_namesz > 0 && note.n_namesz <= sizeof(name))
+		{
+			memcpy(name, notes + offset + sizeof(note), note.n_namesz);
+			name[note.n_namesz - 1] = '\0';
+		}
+
+		print_note(core, note.n_type, name, notes + desc_offset, note.n_descsz);
+		offset = desc_offset + ((note.n_descsz + 3u) & ~(size_t)3);
+	}
+
+	free(notes);
+}
+
+static const char* find_mapped_file(const struct core_file *core, uint64_t vaddr)
+{
+	for(size_t i = 0; i < core->file_count; i++)
+		if(vaddr >= core->file_ranges[i * 3] && vaddr < core->file_ranges[i * 3 + 1])
+			return core->file_names[i];
+
+	return "";
+}
+
+static void print_mapped_files(const struct core_file *core)
+{
+	if(!core->file_ranges)
+		return;
+
+	printf("\nMapped files (%zu, page size %lu):\n", core->file_count, core->page_size);
+	printf("  Start              End                FileOffset         Path\n");
+
+	for(size_t i = 0; i < core->file_count; i++)
+		printf("  0x%016lx 0x%016lx 0x%016lx %s\n",
+			core->file_ranges[i * 3],
+			core->file_ranges[i * 3 + 1],
+			core->file_ranges[i * 3 + 2] * core->page_size,
+			core->file_names[i]);
+}
+
+/*
+ * every load segment with how much of it the core holds: memory that was
+ * not dumped (filesz < memsz) and segments cut off by a truncated file
+ */
+static void print_load_coverage(const struct core_file *core)
+{
+	uint64_t memory = 0, dumped = 0, present = 0;
+	size_t load_count = 0, truncated_count = 0;
+
+	printf("\nLoad segments:\n");
+	printf("  VirtAddr           MemSize            FileSize           Flg In core  Path\n");
+
+	for(size_t i = 0; i < core->phnum; i++)
+	{
+		const Elf64_Phdr *segment = &core->program_headers[i];
+		uint64_t in_file = 0;
+
+		if(segment->p_type != PT_LOAD)
+			continue;
+
+		if(segment->p_offset < (uint64_t)core->size)
+			in_file = (uint64_t)core->size - segment->p_offset;
+		if(in_file > segment->p_filesz)
+			in_file = segment->p_filesz;
+
+		load_count++;
+		memory += segment->p_memsz;
+		dumped += segment->p_filesz;
+		present += in_file;
+		if(in_file < segment->p_filesz)
+			truncated_count++;
+
+		printf("  0x%016lx 0x%016lx 0x%016lx %c%c%c %6.1f%%  %s\n",
+			segment->p_vaddr,
+			segment->p_memsz,
+			segment->p_filesz,
+			segment->p_flags & PF_R ? 'R' : ' ',
+			segment->p_flags & PF_W ? 'W' : ' ',
+			segment->p_flags & PF_X ? 'E' : ' ',
+			segment->p_memsz ? 100.0 * (double)in_file / (double)segment->p_memsz : 100.0,
+			find_mapped_file(core, segment->p_vaddr));
+	}
+
+	printf("\n%zu load segments cover %lu bytes of memory, %lu bytes (%.1f%%) were dumped",
+		load_count, memory, dumped, memory ? 100.0 * (double)dumped / (double)memory : 100.0);
+	if(truncated_count > 0)
+		printf(", %zu segments are cut off by the end of the file (%lu bytes missing)", truncated_count, dumped - present);
+	printf("\n");
+}
+
+void print_core(const char *filename)
+{
+	if(!filename)
+		error(EXIT_FAILURE, EINVAL, "you did not provide input file");
+
+	struct core_file core;
+	struct stat st;
+	int ret;
+
+	memset(&core, 0, sizeof(core));
+	core.filename = filename;
+
+	core.fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if(core.fd < 0)
+		error(EXIT_FAILURE, errno, "cannot open \'%s\'", filename);
+	if(fstat(core.fd, &st) < 0)
+		error(EXIT_FAILURE, errno, "cannot stat \'%s\'", filename);
+	core.size = st.st_size;
+
+	ret = read_core_headers(&core);
+	if(ret != 0)
+	{
+		error(0, ret, "\'%s\' is not a core file", filename);
+		free(core.program_headers);
+		close(core.fd);
+		return;
+	}
+
+	printf("Core file \'%s\': %s, ELF%d, %zu program headers\n",
+		filename, get_elf_machine(core.header.e_machine), core.elf_class == ELFCLASS64 ? 64 : 32, core.phnum);
+
+	for(size_t i = 0; i < core.phnum; i++)
+		if(core.program_headers[i].p_type == PT_NOTE)
+			read_note_segment(&core, &core.program_headers[i]);
+
+	print_mapped_files(&core);
+	print_load_coverage(&core);
+
+	for(size_t i = 0; i < core.file_count; i++)
+		free(core.file_names[i]);
+	free(core.file_names);
+	free(core.file_ranges);
+	free(core.program_headers);
+	close(core.fd);
+}
@@ -0,0 +1,1093 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include "misc.h"
+#include "image.h"
+#include "parallel.h"
+#include "compressed.h"
+#include "dwarf.h"
+#include "debug_line.h"
+
+#define DW_AT_stmt_list 0x10
+#define DW_AT_comp_dir 0x1b
+
+#define DW_LNS_copy 1
+#define DW_LNS_advance_pc 2
+#define DW_LNS_advance_line 3
+#define DW_LNS_set_file 4
+#define DW_LNS_const_add_pc 8
+#define DW_LNS_fixed_advance_pc 9
+
+#define DW_LNE_end_sequence 1
+#define DW_LNE_set_address 2
+#define DW_LNE_define_file 3
+
+#define DW_LNCT_path 1
+#define DW_LNCT_directory_index 2
+
+// file id of rows closing a sequence; rows naming a file that does not exist
+// use LINE_NO_FILE in a unit and the "??" entry LINE_UNKNOWN_FILE in the index
+#define LINE_END_SEQUENCE UINT32_MAX
+#define LINE_NO_FILE (UINT32_MAX - 1)
+#define LINE_UNKNOWN_FILE 0
+
+// rows per block of the address index, deltas inside a block are 32 bit
+#define LINE_BLOCK_SIZE 64
+// addresses answered per parallel job
+#define LINE_QUERY_BATCH 4096
+
+struct line_row {
+	uint64_t address;
+	uint64_t order;		// position in the decoded programs, keeps sort stable
+	uint32_t file;
+	uint32_t line;
+};
+
+struct line_unit {
+	size_t offset;		// offset of the program in .debug_line
+	const char *comp_dir;
+	bool wanted;
+	bool decoded;
+	int status;
+	char **files;
+	size_t file_count;
+	size_t file_capacity;
+	uint32_t file_base;	// global id of files[0]
+	struct line_row *rows;
+	size_t row_count;
+	size_t row_capacity;
+};
+
+/*
+ * sorted address index in structure-of-arrays form: a query binary searches
+ * the short block_base array, then the 32 bit deltas of a single block
+ */
+struct line_index {
+	size_t count;
+	size_t block_count;
+	uint64_t *block_base;
+	size_t *block_start;	// block_count + 1 entries
+	uint32_t *address_delta;
+	uint32_t *file;
+	uint32_t *line;
+	const char **files;
+	size_t file_count;
+};
+
+struct line_context {
+	struct elf_image image;
+	struct section_content line;
+	struct section_content line_str;
+	struct section_content str;
+	struct section_content info;
+	struct section_content abbrev;
+	struct section_content aranges;
+	bool drop_zero_sequences;	// linked files keep sequences of discarded code at 0
+	struct line_unit *units;
+	size_t unit_count;
+};
+
+// file points into the unit that resolved the query, file ids change when more units are decoded
+struct line_query {
+	uint64_t address;
+	const char *file;
+	uint32_t line;
+	bool found;
+};
+
+static void load_debug_section(struct line_context *ctx, const char *name, struct section_content *content)
+{
+	Elf64_Shdr *section = NULL;
+	int ret;
+
+	section = find_section(&ctx->image, name);
+	if(!section)
+		return;
+
+	ret = load_section_content(&ctx->image, section, content);
+	if(ret != 0)
+		error(0, ret, "\'%s\': cannot read section \'%s\'", ctx->image.name, name);
+}
+
+static const char* read_section_string(const struct section_content *content, uint64_t offset)
+{
+	if(!content->data || offset >= content->size || !memchr(content->data + offset, '\0', content->size - offset))
+		return "??";
+
+	return (const char*)content->data + offset;
+}
+
+// value of a string form in a line program header
+static const char* read_form_string(const struct line_context *ctx, struct dwarf_cursor *cursor, uint64_t form, size_t offset_size)
+{
+	switch(form)
+	{
+	case DW_FORM_string:
+		return dwarf_read_string(cursor);
+	case DW_FORM_line_strp:
+		return read_section_string(&ctx->line_str, dwarf_read_uint(cursor, offset_size));
+	case DW_FORM_strp:
+		return read_section_string(&ctx->str, dwarf_read_uint(cursor, offset_size));
+	default:
+		dwarf_skip_form(cursor, form, offset_size, 8);
+		return "??";
+	}
+}
+
+static uint64_t read_form_number(struct dwarf_cursor *cursor, uint64_t form, size_t offset_size)
+{
+	switch(form)
+	{
+	case DW_FORM_data1:
+		return dwarf_read_u8(cursor);
+	case DW_FORM_data2:
+		return dwarf_read_u16(cursor);
+	case DW_FORM_data4:
+		return dwarf_read_u32(cursor);
+	case DW_FORM_data8:
+		return dwarf_read_u64(cursor);
+	case DW_FORM_udata:
+		return dwarf_read_uleb(cursor);
+	default:
+		dwarf_skip_form(cursor, form, offset_size, 8);
+		return 0;
+	}
+}
+
+static char* join_path(const char *dir, const char *name)
+{
+	char *path = NULL;
+
+	if(name[0] == '/' || !dir || dir[0] == '\0')
+		path = strdup(name);
+	else if(asprintf(&path, "%s/%s", dir, name) < 0)
+		path = NULL;
+
+	if(!path)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	return path;
+}
+
+static void add_unit_file(struct line_unit *unit, const char *dir, const char *name)
+{
+	if(unit->file_count == unit->file_capacity)
+	{
+		unit->file_capacity = unit->file_capacity ? unit->file_capacity * 2 : 16;
+		unit->files = realloc_wrap(unit->files, sizeof(char*) * unit->file_capacity);
+	}
+	unit->files[unit->file_count++] = join_path(dir, name);
+}
+
+static void add_row(struct line_unit *unit, uint64_t address, uint32_t file, uint32_t line)
+{
+	if(unit->row_count == unit->row_capacity)
+	{
+		unit->row_capacity = unit->row_capacity ? unit->row_capacity * 2 : 256;
+		unit->rows = realloc_wrap(unit->rows, sizeof(struct line_row) * unit->row_capacity);
+	}
+
+	unit->rows[unit->row_count].address = address;
+	unit->rows[unit->row_count].order = unit->row_count;
+	unit->rows[unit->row_count].file = file;
+	unit->rows[unit->row_count].line = line;
+	unit->row_count++;
+}
+
+// dwarf 5 directory and file tables are described by (content type, form) lists
+static bool read_v5_entries(const struct line_context *ctx, struct dwarf_cursor *cursor, size_t offset_size, char **dirs, size_t dir_count, struct line_unit *unit, char ***out_dirs, size_t *out_count)
+{
+	uint8_t format_count;
+	uint64_t formats[32][2];
+	uint64_t count;
+
+	format_count = dwarf_read_u8(cursor);
+	if(format_count > 32)
+		return false;
+
+	for(size_t i = 0; i < format_count; i++)
+	{
+		formats[i][0] = dwarf_read_uleb(cursor);
+		formats[i][1] = dwarf_read_uleb(cursor);
+	}
+
+	count = dwarf_read_uleb(cursor);
+	if(cursor->error || count > dwarf_remaining(cursor))
+		return false;
+
+	if(out_dirs)
+	{
+		*out_dirs = malloc_wrap(sizeof(char*) * (count + 1));
+		*out_count = 0;
+	}
+
+	for(uint64_t i = 0; i < count && !cursor->error; i++)
+	{
+		const char *path = "??";
+		uint64_t dir_index = 0;
+
+		for(size_t j = 0; j < format_count; j++)
+		{
+			if(formats[j][0] == DW_LNCT_path)
+				path = read_form_string(ctx, cursor, formats[j][1], offset_size);
+			else if(formats[j][0] == DW_LNCT_directory_index)
+				dir_index = read_form_number(cursor, formats[j][1], offset_size);
+			else
+				dwarf_skip_form(cursor, formats[j][1], offset_size, 8);
+		}
+
+		// directory 0 is the compilation directory, the others are relative to it
+		if(out_dirs)
+			(*out_dirs)[(*out_count)++] = join_path(i == 0 ? unit->comp_dir : (*out_dirs)[0], path);
+		else
+			add_unit_file(unit, dir_index < dir_count ? dirs[dir_index] : NULL, path);
+	}
+
+	return !cursor->error;
+}
+
+static bool read_v4_entries(struct dwarf_cursor *cursor, struct line_unit *unit, char ***out_dirs, size_t *out_count)
+{
+	char **dirs = NULL;
+	size_t dir_count = 1, dir_capacity = 16;
+	const char *name = NULL;
+
+	// directory 0 is the compilation directory, which is not in the table
+	dirs = malloc_wrap(sizeof(char*) * dir_capacity);
+	dirs[0] = join_path(NULL, unit->comp_dir ? unit->comp_dir : "");
+	*out_dirs = dirs;
+	*out_count = dir_count;
+
+	while(!cursor->error && *(name = dwarf_read_string(cursor)) != '\0')
+	{
+		if(dir_count == dir_capacity)
+		{
+			dir_capacity *= 2;
+			dirs = realloc_wrap(dirs, sizeof(char*) * dir_capacity);
+		}
+		dirs[dir_count++] = join_path(unit->comp_dir, name);
+		*out_dirs = dirs;
+		*out_count = dir_count;
+	}
+
+	// file 0 does not exist before dwarf 5, an empty slot keeps indexes aligned
+	add_unit_file(unit, NULL, "??");
+
+	while(!cursor->error && *(name = dwarf_read_string(cursor)) != '\0')
+	{
+		uint64_t dir_index = dwarf_read_uleb(cursor);
+
+		dwarf_read_uleb(cursor);	// modification time
+		dwarf_read_uleb(cursor);	// file size
+		add_unit_file(unit, dir_index < dir_count ? dirs[dir_index] : NULL, name);
+	}
+
+	return !cursor->error;
+}
+
+static void free_dirs(char **dirs, size_t count)
+{
+	for(size_t i = 0; i < count; i++)
+		free(dirs[i]);
+	free(dirs);
+}
+
+static void end_sequence(struct line_context *ctx, struct line_unit *unit, size_t sequence_start, uint64_t address)
+{
+	// sequences of code discarded by the linker are left at address 0 (or -1)
+	if(ctx->drop_zero_sequences && sequence_start < unit->row_count &&
+		(unit->rows[sequence_start].address == 0 || unit->rows[sequence_start].address == UINT64_MAX))
+	{
+		unit->row_count = sequence_start;
+		return;
+	}
+
+	add_row(unit, address, LINE_END_SEQUENCE, 0);
+}
+
+static uint32_t get_row_file(const struct line_unit *unit, uint64_t file)
+{
+	return file < unit->file_count ? (uint32_t)file : LINE_NO_FILE;
+}
+
+static int decode_line_unit(struct line_context *ctx, struct line_unit *unit)
+{
+	struct dwarf_cursor cursor, program;
+	uint64_t unit_length, header_length;
+	size_t offset_size;
+	uint16_t version;
+	uint8_t min_inst_length, max_ops = 1, default_is_stmt, line_range, opcode_base;
+	int8_t line_base;
+	const uint8_t *standard_lengths = NULL;
+	char **dirs = NULL;
+	size_t dir_count = 0;
+	bool ok;
+
+	dwarf_init_cursor(&cursor, ctx->line.data + unit->offset, ctx->line.size - unit->offset);
+
+	unit_length = dwarf_read_initial_length(&cursor, &offset_size);
+	if(cursor.error || unit_length > dwarf_remaining(&cursor))
+		return EBADMSG;
+	cursor.end = cursor.pos + unit_length;
+
+	version = dwarf_read_u16(&cursor);
+	if(version < 2 || version > 5)
+		return ENOTSUP;
+
+	if(version >= 5)
+	{
+		dwarf_read_u8(&cursor);		// address size
+		dwarf_read_u8(&cursor);		// segment selector size
+	}
+
+	header_length = dwarf_read_uint(&cursor, offset_size);
+	if(cursor.error || header_length > dwarf_remaining(&cursor))
+		return EBADMSG;
+
+	program = cursor;
+	dwarf_skip(&program, header_length);
+
+	min_inst_length = dwarf_read_u8(&cursor);
+	if(version >= 4)
+		max_ops = dwarf_read_u8(&cursor);
+	default_is_stmt = dwarf_read_u8(&cursor);
+	line_base = (int8_t)dwarf_read_u8(&cursor);
+	line_range = dwarf_read_u8(&cursor);
+	opcode_base = dwarf_read_u8(&cursor);
+	(void)default_is_stmt;
+
+	if(line_range == 0 || max_ops == 0 || opcode_base == 0 || dwarf_remaining(&cursor) < opcode_base - 1u)
+		return EBADMSG;
+
+	standard_lengths = cursor.pos;
+	dwarf_skip(&cursor, opcode_base - 1u);
+
+	if(version >= 5)
+	{
+		ok = read_v5_entries(ctx, &cursor, offset_size, NULL, 0, unit, &dirs, &dir_count) &&
+			read_v5_entries(ctx, &cursor, offset_size, dirs, dir_count, unit, NULL, NULL);
+	}
+	else
+		ok = read_v4_entries(&cursor, unit, &dirs, &dir_count);
+
+	if(!ok)
+	{
+		free_dirs(dirs, dir_count);
+		return EBADMSG;
+	}
+
+	// the state machine
+	uint64_t address = 0, file = 1, op_index = 0;
+	int64_t line = 1;
+	size_t sequence_start = unit->row_count;
+
+	while(dwarf_remaining(&program) > 0 && !program.error)
+	{
+		uint8_t opcode = dwarf_read_u8(&program);
+		uint64_t advance = 0;
+
+		if(opcode >= opcode_base)
+		{
+			uint8_t adjusted = (uint8_t)(opcode - opcode_base);
+
+			advance = adjusted / line_range;
+			line += line_base + adjusted % line_range;
+		}
+		else if(opcode == 0)
+		{
+			uint64_t length = dwarf_read_uleb(&program);
+			const unsigned char *next = program.pos + (length < dwarf_remaining(&program) ? length : dwarf_remaining(&program));
+			uint8_t sub_opcode;
+
+			if(length == 0)
+				continue;
+
+			sub_opcode = dwarf_read_u8(&program);
+			if(sub_opcode == DW_LNE_end_sequence)
+			{
+				end_sequence(ctx, unit, sequence_start, address);
+				address = 0;
+				file = 1;
+				line = 1;
+				op_index = 0;
+				sequence_start = unit->row_count;
+			}
+			else if(sub_opcode == DW_LNE_set_address)
+			{
+				address = dwarf_read_uint(&program, (size_t)(length - 1));
+				op_index = 0;
+			}
+			else if(sub_opcode == DW_LNE_define_file)
+			{
+				const char *name = dwarf_read_string(&program);
+				uint64_t dir_index = dwarf_read_uleb(&program);
+
+				add_unit_file(unit, dir_index < dir_count ? dirs[dir_index] : NULL, name);
+			}
+
+			program.pos = next;
+			continue;
+		}
+		else
+		{
+			switch(opcode)
+			{
+			case DW_LNS_copy:
+				break;
+			case DW_LNS_advance_pc:
+				advance = dwarf_read_uleb(&program);
+				break;
+			case DW_LNS_advance_line:
+				line += dwarf_read_sleb(&program);
+				continue;
+			case DW_LNS_set_file:
+				file = dwarf_read_uleb(&program);
+				continue;
+			case DW_LNS_const_add_pc:
+				advance = (255u - opcode_base) / line_range;
+				break;
+			case DW_LNS_fixed_advance_pc:
+				address += dwarf_read_u16(&program);
+				op_index = 0;
+				continue;
+			default:
+				// column, negate_stmt, basic_block, prologue_end, ... carry nothing we need
+				for(uint8_t i = 0; i < standard_lengths[opcode - 1]; i++)
+					dwarf_read_uleb(&program);
+				continue;
+			}
+		}
+
+		if(max_ops == 1)
+			address += min_inst_length * advance;
+		else
+		{
+			address += min_inst_length * ((op_index + advance) / max_ops);
+			op_index = (op_index + advance) % max_ops;
+		}
+
+		// copy and special opcodes append a row, the advances alone do not
+		if(opcode >= opcode_base || opcode == DW_LNS_copy)
+			add_row(unit, address, get_row_file(unit, file), (uint32_t)line);
+	}
+
+	free_dirs(dirs, dir_count);
+	return program.error ? EBADMSG : 0;
+}
+
+static void decode_unit_job(size_t index, void *arg)
+{
+	struct line_context *ctx = arg;
+	struct line_unit *unit = &ctx->units[index];
+
+	if(!unit->wanted || unit->decoded)
+		return;
+
+	unit->status = decode_line_unit(ctx, unit);
+	unit->decoded = true;
+}
+
+static void find_line_units(struct line_context *ctx)
+{
+	size_t offset = 0;
+	size_t capacity = 0;
+
+	while(offset < ctx->line.size)
+	{
+		struct dwarf_cursor cursor;
+		size_t offset_size;
+		uint64_t length;
+
+		dwarf_init_cursor(&cursor, ctx->line.data + offset, ctx->line.size - offset);
+		length = dwarf_read_initial_length(&cursor, &offset_size);
+		if(cursor.error || length > dwarf_remaining(&cursor))
+			break;
+
+		if(ctx->unit_count == capacity)
+		{
+			capacity = capacity ? capacity * 2 : 64;
+			ctx->units = realloc_wrap(ctx->units, sizeof(struct line_unit) * capacity);
+		}
+
+		memset(&ctx->units[ctx->unit_count], 0, sizeof(struct line_unit));
+		ctx->units[ctx->unit_count++].offset = offset;
+
+		offset += dwarf_offset(&cursor) + (size_t)length;
+	}
+}
+
+static struct line_unit* find_unit_by_offset(struct line_context *ctx, uint64_t offset)
+{
+	size_t low = 0, high = ctx->unit_count;
+
+	while(low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+
+		if(ctx->units[mid].offset < offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if(low < ctx->unit_count && ctx->units[low].offset == offset)
+		return &ctx->units[low];
+
+	return NULL;
+}
+
+// DW_AT_stmt_list and DW_AT_comp_dir of the compilation unit at the given
+// .debug_info offset, only the first entry of the unit is read
+static bool read_unit_line_info(const struct line_context *ctx, uint64_t info_offset, uint64_t *stmt_list, const char **comp_dir)
+{
+	struct dwarf_cursor info, abbrev;
+	size_t offset_size, address_size;
+	uint64_t length, abbrev_offset, code;
+	uint16_t version;
+	bool found = false;
+
+	if(!ctx->info.data || !ctx->abbrev.data || info_offset >= ctx->info.size)
+		return false;
+
+	dwarf_init_cursor(&info, ctx->info.data + info_offset, ctx->info.size - info_offset);
+	length = dwarf_read_initial_length(&info, &offset_size);
+	if(info.error || length > dwarf_remaining(&info))
+		return false;
+	info.end = info.pos + length;
+
+	version = dwarf_read_u16(&info);
+	if(version >= 5)
+	{
+		uint8_t unit_type = dwarf_read_u8(&info);
+
+		address_size = dwarf_read_u8(&info);
+		abbrev_offset = dwarf_read_uint(&info, offset_size);
+		if(unit_type == 4 || unit_type == 5)	// skeleton and split units carry a dwo id
+			dwarf_skip(&info, 8);
+		else if(unit_type != 1 && unit_type != 3)
+			return false;
+	}
+	else
+	{
+		abbrev_offset = dwarf_read_uint(&info, offset_size);
+		address_size = dwarf_read_u8(&info);
+	}
+
+	code = dwarf_read_uleb(&info);
+	if(info.error || code == 0 || abbrev_offset >= ctx->abbrev.size)
+		return false;
+
+	dwarf_init_cursor(&abbrev, ctx->abbrev.data + abbrev_offset, ctx->abbrev.size - abbrev_offset);
+
+	// skip abbreviations until the one of the first entry
+	while(!abbrev.error)
+	{
+		uint64_t entry_code = dwarf_read_uleb(&abbrev);
+
+		if(entry_code == 0)
+			return false;
+
+		dwarf_read_uleb(&abbrev);	// tag
+		dwarf_read_u8(&abbrev);		// has children
+
+		if(entry_code == code)
+			break;
+
+		while(!abbrev.error)
+		{
+			uint64_t name = dwarf_read_uleb(&abbrev);
+			uint64_t form = dwarf_read_uleb(&abbrev);
+
+			if(form == DW_FORM_implicit_const)
+				dwarf_read_sleb(&abbrev);
+			if(name == 0 && form == 0)
+				break;
+		}
+	}
+
+	*comp_dir = NULL;
+
+	while(!abbrev.error && !info.error)
+	{
+		uint64_t name = dwarf_read_uleb(&abbrev);
+		uint64_t form = dwarf_read_uleb(&abbrev);
+		int64_t implicit_const = 0;
+
+		if(form == DW_FORM_implicit_const)
+			implicit_const = dwarf_read_sleb(&abbrev);
+		if(name == 0 && form == 0)
+			break;
+
+		if(name == DW_AT_stmt_list && (form == DW_FORM_sec_offset || form == DW_FORM_data4 || form == DW_FORM_data8))
+		{
+			*stmt_list = dwarf_read_uint(&info, form == DW_FORM_sec_offset ? offset_size : form == DW_FORM_data4 ? 4 : 8);
+			found = true;
+		}
+		else if(name == DW_AT_stmt_list && form == DW_FORM_implicit_const)
+		{
+			*stmt_list = (uint64_t)implicit_const;
+			found = true;
+		}
+		else if(name == DW_AT_comp_dir && (form == DW_FORM_string || form == DW_FORM_strp || form == DW_FORM_line_strp))
+			*comp_dir = read_form_string(ctx, &info, form, offset_size);
+		else
+			dwarf_skip_form(&info, form, offset_size, address_size);
+	}
+
+	return found && !info.error;
+}
+
+// line programs name directories relative to the compilation directory,
+// which only the compilation unit knows
+static void find_comp_dirs(struct line_context *ctx)
+{
+	size_t offset = 0;
+
+	while(ctx->info.data && offset < ctx->info.size)
+	{
+		struct dwarf_cursor cursor;
+		size_t offset_size;
+		uint64_t length, stmt_list;
+		const char *comp_dir = NULL;
+
+		dwarf_init_cursor(&cursor, ctx->info.data + offset, ctx->info.size - offset);
+		length = dwarf_read_initial_length(&cursor, &offset_size);
+		if(cursor.error || length > dwarf_remaining(&cursor))
+			break;
+
+		if(read_unit_line_info(ctx, offset, &stmt_list, &comp_dir))
+		{
+			struct line_unit *unit = find_unit_by_offset(ctx, stmt_list);
+
+			if(unit)
+				unit->comp_dir = comp_dir;
+		}
+
+		offset += dwarf_offset(&cursor) + (size_t)length;
+	}
+}
+
+static bool any_query_in_range(const struct line_query *queries, size_t count, uint64_t start, uint64_t length)
+{
+	size_t low = 0, high = count;
+
+	while(low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+
+		if(queries[mid].address < start)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low < count && queries[low].address - start < length;
+}
+
+// marks the line programs of the compilation units whose .debug_aranges
+// cover a queried address; returns false when there is no usable index
+static bool select_units_by_aranges(struct line_context *ctx, const struct line_query *sorted, size_t count)
+{
+	struct dwarf_cursor cursor;
+	bool selected = false;
+
+	if(!ctx->aranges.data)
+		return false;
+
+	dwarf_init_cursor(&cursor, ctx->aranges.data, ctx->aranges.size);
+
+	while(dwarf_remaining(&cursor) > 0 && !cursor.error)
+	{
+		struct dwarf_cursor set = cursor;
+		size_t offset_size, address_size, set_start = dwarf_offset(&cursor);
+		uint64_t length, info_offset, stmt_list;
+		const char *comp_dir = NULL;
+		bool wanted = false;
+
+		length = dwarf_read_initial_length(&set, &offset_size);
+		if(set.error || length > dwarf_remaining(&set))
+			return selected;
+		set.end = set.pos + length;
+		cursor.pos = set.end;
+
+		dwarf_read_u16(&set);	// version
+		info_offset = dwarf_read_uint(&set, offset_size);
+		address_size = dwarf_read_u8(&set);
+		dwarf_read_u8(&set);	// segment selector size
+
+		if(address_size == 0 || address_size > 8)
+			continue;
+
+		// tuples are aligned to twice the address size from the set start
+		while((dwarf_offset(&set) - set_start) % (address_size * 2))
+			dwarf_skip(&set, 1);
+
+		while(dwarf_remaining(&set) >= address_size * 2 && !wanted)
+		{
+			uint64_t start = dwarf_read_uint(&set, address_size);
+			uint64_t range = dwarf_read_uint(&set, address_size);
+
+			if(start == 0 && range == 0)
+				break;
+			wanted = any_query_in_range(sorted, count, start, range);
+		}
+
+		if(wanted && read_unit_line_info(ctx, info_offset, &stmt_list, &comp_dir))
+		{
+			struct line_unit *unit = find_unit_by_offset(ctx, stmt_list);
+
+			if(unit)
+			{
+				unit->wanted = true;
+				unit->comp_dir = comp_dir;
+			}
+		}
+		selected = true;
+	}
+
+	return selected;
+}
+
+static int compare_rows(const void *a, const void *b)
+{
+	const struct line_row *ra = a;
+	const struct line_row *rb = b;
+
+	if(ra->address != rb->address)
+		return ra->address < rb->address ? -1 : 1;
+	if(ra->order != rb->order)
+		return ra->order < rb->order ? -1 : 1;
+	return 0;
+}
+
+static void free_line_index(struct line_index *index)
+{
+	free(index->block_base);
+	free(index->block_start);
+	free(index->address_delta);
+	free(index->file);
+	free(index->line);
+	free(index->files);
+	memset(index, 0, sizeof(struct line_index));
+}
+
+static void build_line_index(struct line_context *ctx, struct line_index *index)
+{
+	struct line_row *rows = NULL;
+	size_t count = 0, file_count = 1, order = 0;
+
+	free_line_index(index);
+
+	for(size_t i = 0; i < ctx->unit_count; i++)
+	{
+		ctx->units[i].file_base = (uint32_t)file_count;
+		file_count += ctx->units[i].file_count;
+		count += ctx->units[i].row_count;
+	}
+
+	index->files = malloc_wrap(sizeof(char*) * file_count);
+	index->files[LINE_UNKNOWN_FILE] = "??";
+	index->file_count = file_count;
+
+	rows = malloc_wrap(sizeof(struct line_row) * (count + 1));
+	count = 0;
+
+	for(size_t i = 0; i < ctx->unit_count; i++)
+	{
+		struct line_unit *unit = &ctx->units[i];
+
+		for(size_t j = 0; j < unit->file_count; j++)
+			index->files[unit->file_base + j] = unit->files[j];
+
+		for(size_t j = 0; j < unit->row_count; j++)
+		{
+			rows[count] = unit->rows[j];
+			rows[count].order = order++;
+			if(rows[count].file == LINE_NO_FILE)
+				rows[count].file = LINE_UNKNOWN_FILE;
+			else if(rows[count].file != LINE_END_SEQUENCE)
+				rows[count].file += unit->file_base;
+			count++;
+		}
+	}
+
+	qsort(rows, count, sizeof(struct line_row), compare_rows);
+
+	index->count = count;
+	index->address_delta = malloc_wrap(sizeof(uint32_t) * (count + 1));
+	index->file = malloc_wrap(sizeof(uint32_t) * (count + 1));
+	index->line = malloc_wrap(sizeof(uint32_t) * (count + 1));
+	index->block_base = malloc_wrap(sizeof(uint64_t) * (count + 1));
+	index->block_start = malloc_wrap(sizeof(size_t) * (count + 2));
+
+	for(size_t i = 0; i < count; i++)
+	{
+		size_t block = index->block_count;
+
+		// a new block every LINE_BLOCK_SIZE rows, or when the delta gets too wide
+		if(block == 0 || i - index->block_start[block - 1] == LINE_BLOCK_SIZE ||
+			rows[i].address - index->block_base[block - 1] > UINT32_MAX)
+		{
+			index->block_base[block] = rows[i].address;
+			index->block_start[block] = i;
+			index->block_count++;
+		}
+
+		index->address_delta[i] = (uint32_t)(rows[i].address - index->block_base[index->block_count - 1]);
+		index->file[i] = rows[i].file;
+		index->line[i] = rows[i].line;
+	}
+
+	index->block_start[index->block_count] = count;
+	free(rows);
+}
+
+static bool lookup_line(const struct line_index *index, uint64_t address, uint32_t *file, uint32_t *line)
+{
+	size_t low = 0, high = index->block_count;
+	size_t block, first, last;
+	uint64_t delta;
+
+	// last block starting at or below the address
+	while(low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+
+		if(index->block_base[mid] <= address)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if(low == 0)
+		return false;
+
+	block = low - 1;
+	delta = address - index->block_base[block];
+	if(delta > UINT32_MAX)
+		delta = UINT32_MAX;
+
+	first = index->block_start[block];
+	low = first;
+	high = index->block_start[block + 1];
+
+	while(low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+
+		if(index->address_delta[mid] <= delta)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	last = low - 1;
+	if(index->file[last] == LINE_END_SEQUENCE)
+		return false;
+
+	*file = index->file[last];
+	*line = index->line[last];
+	return true;
+}
+
+struct query_job {
+	const struct line_index *index;
+	struct line_query *queries;
+	size_t count;
+};
+
+static void answer_queries(size_t batch, void *arg)
+{
+	struct query_job *job = arg;
+	size_t end = (batch + 1) * LINE_QUERY_BATCH;
+
+	if(end > job->count)
+		end = job->count;
+
+	for(size_t i = batch * LINE_QUERY_BATCH; i < end; i++)
+	{
+		struct line_query *query = &job->queries[i];
+		uint32_t file;
+
+		if(!query->found && lookup_line(job->index, query->address, &file, &query->line))
+		{
+			query->file = job->index->files[file];
+			query->found = true;
+		}
+	}
+}
+
+static int compare_queries(const void *a, const void *b)
+{
+	const struct line_query *qa = a;
+	const struct line_query *qb = b;
+
+	return qa->address < qb->address ? -1 : qa->address > qb->address;
+}
+
+static struct line_query* read_queries(FILE *input, size_t *count)
+{
+	struct line_query *queries = NULL;
+	size_t capacity = 0;
+	char token[64];
+
+	*count = 0;
+
+	while(fscanf(input, "%63s", token) == 1)
+	{
+		char *end = NULL;
+		uint64_t address;
+
+		errno = 0;
+		address = strtoull(token, &end, 16);
+		if(errno != 0 || end == token || *end != '\0')
+		{
+			error(0, EINVAL, "invalid address \'%s\'", token);
+			continue;
+		}
+
+		if(*count == capacity)
+		{
+			capacity = capacity ? capacity * 2 : 1024;
+			queries = realloc_wrap(queries, sizeof(struct line_query) * capacity);
+		}
+
+		memset(&queries[*count], 0, sizeof(struct line_query));
+		queries[(*count)++].address = address;
+	}
+
+	return queries;
+}
+
+static void decode_wanted_units(struct line_context *ctx, struct line_index *index, struct line_query *queries, size_t count)
+{
+	struct query_job job = { index, queries, count };
+
+	parallel_for(ctx->unit_count, decode_unit_job, ctx);
+
+	for(size_t i = 0; i < ctx->unit_count; i++)
+		if(ctx->units[i].wanted && ctx->units[i].status != 0)
+			error(0, ctx->units[i].status, "\'%s\': bad line program at offset %#zx", ctx->image.name, ctx->units[i].offset);
+
+	build_line_index(ctx, index);
+	parallel_for((count + LINE_QUERY_BATCH - 1) / LINE_QUERY_BATCH, answer_queries, &job);
+}
+
+/*
+ * maps the addresses read from input to file:line; only line programs of
+ * units covering the queried addresses (by .debug_aranges) are decoded, the
+ * rest is decoded only if some address stays unresolved
+ */
+void print_addr2line(const char *filename, FILE *input)
+{
+	assert(filename != NULL);
+	assert(input != NULL);
+
+	struct line_context ctx;
+	struct line_index index;
+	struct line_query *queries = NULL;
+	struct line_query *sorted = NULL;
+	size_t count = 0;
+	bool unresolved = false;
+	int ret;
+
+	memset(&ctx, 0, sizeof(ctx));
+	memset(&index, 0, sizeof(index));
+
+	ret = open_elf_image(&ctx.image, filename);
+	if(ret != 0)
+	{
+		error(0, ret, "\'%s\' is not a valid elf file", filename);
+		free_elf_image(&ctx.image);
+		return;
+	}
+
+	ctx.drop_zero_sequences = ctx.image.header.e_type != ET_REL;
+
+	load_debug_section(&ctx, ".debug_line", &ctx.line);
+	if(!ctx.line.data)
+	{
+		error(0, ENODATA, "\'%s\' has no .debug_line section", filename);
+		free_elf_image(&ctx.image);
+		return;
+	}
+
+	load_debug_section(&ctx, ".debug_line_str", &ctx.line_str);
+	load_debug_section(&ctx, ".debug_str", &ctx.str);
+	load_debug_section(&ctx, ".debug_info", &ctx.info);
+	load_debug_section(&ctx, ".debug_abbrev", &ctx.abbrev);
+	load_debug_section(&ctx, ".debug_aranges", &ctx.aranges);
+
+	find_line_units(&ctx);
+	queries = read_queries(input, &count);
+
+	sorted = malloc_wrap(sizeof(struct line_query) * (count + 1));
+	memcpy(sorted, queries, sizeof(struct line_query) * count);
+	qsort(sorted, count, sizeof(struct line_query), compare_queries);
+
+	if(!select_units_by_aranges(&ctx, sorted, count))
+	{
+		find_comp_dirs(&ctx);
+		for(size_t i = 0; i < ctx.unit_count; i++)
+			ctx.units[i].wanted = true;
+	}
+
+	decode_wanted_units(&ctx, &index, queries, count);
+
+	for(size_t i = 0; i < count; i++)
+		if(!queries[i].found)
+			unresolved = true;
+
+	if(unresolved)
+	{
+		bool pending = false;
+
+		for(size_t i = 0; i < ctx.unit_count; i++)
+		{
+			pending |= !ctx.units[i].wanted;
+			ctx.units[i].wanted = true;
+		}
+
+		if(pending)
+		{
+			find_comp_dirs(&ctx);
+			decode_wanted_units(&ctx, &index, queries, count);
+		}
+	}
+
+	for(size_t i = 0; i < count; i++)
+	{
+		if(queries[i].found)
+			printf("%#018lx %s:%u\n", queries[i].address, queries[i].file, queries[i].line);
+		else
+			printf("%#018lx ??:0\n", queries[i].address);
+	}
+
+	free_line_index(&index);
+
+	for(size_t i = 0; i < ctx.unit_count; i++)
+	{
+		for(size_t j = 0; j < ctx.units[i].file_count; j++)
+			free(ctx.units[i].files[j]);
+		free(ctx.units[i].files);
+		free(ctx.units[i].rows);
+	}
+
+	free(ctx.units);
+	free(sorted);
+	free(queries);
+	free_section_content(&ctx.aranges);
+	free_section_content(&ctx.abbrev);
+	free_section_content(&ctx.info);
+	free_section_content(&ctx.str);
+	free_section_content(&ctx.line_str);
+	free_section_content(&ctx.line);
+	free_elf_image(&ctx.image);
+}
\ No newline at end of file
@@ -0,0 +1,337 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include <pthread.h>
+#include "misc.h"
+#include "parallel.h"
+#include "demangle.h"
+
+#ifdef HAVE_DEMANGLE
+// from the c++ runtime, reallocs buffer as needed and returns it
+char* __cxa_demangle(const char *mangled_name, char *buffer, size_t *length, int *status);
+#endif
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define DEMANGLE_TABLE_MIN 1024
+// names handed to one parallel job
+#define DEMANGLE_BLOCK_SIZE 1024
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t used;
+	size_t size;
+	char data[];
+};
+
+struct demangle_entry {
+	uint64_t hash;
+	const char *name;	// NULL if the slot is empty
+	const char *demangled;
+};
+
+/*
+ * cache of one thread: mangled and demangled names are copied into an arena
+ * that is only freed as a whole, and the demangler output buffer is reused,
+ * so a miss costs no malloc of its own
+ */
+struct demangle_cache {
+	struct demangle_entry *entries;
+	size_t capacity;
+	size_t count;
+	struct arena_chunk *chunks;
+	char *buffer;
+	size_t buffer_size;
+	uint64_t lookups;
+	uint64_t hits;
+	uint64_t demangled;
+};
+
+/*
+ * caches are checked out by one thread at a time, so lookups take no lock;
+ * idle caches wait on a stack and are reused by the next parallel job
+ */
+struct demangler {
+	pthread_mutex_t lock;
+	struct demangle_cache **caches;
+	size_t cache_count;
+	size_t cache_capacity;		// of caches and idle
+	struct demangle_cache **idle;
+	size_t idle_count;
+	uint64_t elapsed_ns;
+	uint64_t names;
+};
+
+struct demangle_job {
+	struct demangler *demangler;
+	const char **names;
+	size_t count;
+};
+
+static char* arena_alloc(struct demangle_cache *cache, size_t size)
+{
+	struct arena_chunk *chunk = cache->chunks;
+	char *ptr = NULL;
+
+	if(!chunk || chunk->size - chunk->used < size)
+	{
+		size_t chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+
+		chunk = malloc_wrap(sizeof(struct arena_chunk) + chunk_size);
+		chunk->next = cache->chunks;
+		chunk->used = 0;
+		chunk->size = chunk_size;
+		cache->chunks = chunk;
+	}
+
+	ptr = chunk->data + chunk->used;
+	chunk->used += size;
+	return ptr;
+}
+
+static char* arena_strdup(struct demangle_cache *cache, const char *str)
+{
+	size_t size = strlen(str) + 1;
+
+	return memcpy(arena_alloc(cache, size), str, size);
+}
+
+static void grow_cache(struct demangle_cache *cache)
+{
+	struct demangle_entry *entries = cache->entries;
+	size_t capacity = cache->capacity;
+
+	cache->capacity = capacity ? capacity * 2 : DEMANGLE_TABLE_MIN;
+	cache->entries = calloc(cache->capacity, sizeof(struct demangle_entry));
+	if(!cache->entries)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	for(size_t i = 0; i < capacity; i++)
+	{
+		size_t slot;
+
+		if(!entries[i].name)
+			continue;
+
+		slot = (size_t)entries[i].hash & (cache->capacity - 1);
+		while(cache->entries[slot].name)
+			slot = (slot + 1) & (cache->capacity - 1);
+		cache->entries[slot] = entries[i];
+	}
+
+	free(entries);
+}
+
+// demangled form of name in the arena of the cache, name itself if it is not c++
+static const char* demangle_cached(struct demangle_cache *cache, const char *name)
+{
+	struct demangle_entry *entry = NULL;
+	const char *demangled = NULL;
+	uint64_t hash;
+	size_t slot;
+
+	// itanium abi names all start with _Z
+	if(name[0] != '_' || name[1] != 'Z')
+		return name;
+
+	cache->lookups++;
+	hash = hash_string(HASH_SEED, name);
+
+	if(cache->count * 2 >= cache->capacity)
+		grow_cache(cache);
+
+	slot = (size_t)hash & (cache->capacity - 1);
+	for(entry = &cache->entries[slot]; entry->name; entry = &cache->entries[slot])
+	{
+		if(entry->hash == hash && strcmp(entry->name, name) == 0)
+		{
+			cache->hits++;
+			return entry->demangled;
+		}
+		slot = (slot + 1) & (cache->capacity - 1);
+	}
+
+	entry->hash = hash;
+	entry->name = arena_strdup(cache, name);
+	entry->demangled = entry->name;
+	cache->count++;
+
+#ifdef HAVE_DEMANGLE
+	{
+		int status = 0;
+		char *buffer = NULL;
+
+		if(!cache->buffer)
+		{
+			cache->buffer_size = 256;
+			cache->buffer = malloc_wrap(cache->buffer_size);
+		}
+
+		buffer = __cxa_demangle(name, cache->buffer, &cache->buffer_size, &status);
+		if(buffer)
+			cache->buffer = buffer;
+		if(buffer && status == 0)
+		{
+			demangled = arena_strdup(cache, buffer);
+			cache->demangled++;
+		}
+	}
+#endif
+
+	if(demangled)
+		entry->demangled = demangled;
+
+	return entry->demangled;
+}
+
+static struct demangle_cache* take_cache(struct demangler *demangler)
+{
+	struct demangle_cache *cache = NULL;
+
+	pthread_mutex_lock(&demangler->lock);
+
+	if(demangler->idle_count > 0)
+		cache = demangler->idle[--demangler->idle_count];
+	else
+	{
+		cache = calloc(1, sizeof(struct demangle_cache));
+		if(!cache)
+			error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+		if(demangler->cache_count == demangler->cache_capacity)
+		{
+			demangler->cache_capacity = demangler->cache_capacity ? demangler->cache_capacity * 2 : 16;
+			demangler->caches = realloc_wrap(demangler->caches, sizeof(struct demangle_cache*) * demangler->cache_capacity);
+			demangler->idle = realloc_wrap(demangler->idle, sizeof(struct demangle_cache*) * demangler->cache_capacity);
+		}
+		demangler->caches[demangler->cache_count++] = cache;
+	}
+
+	pthread_mutex_unlock(&demangler->lock);
+	return cache;
+}
+
+static void return_cache(struct demangler *demangler, struct demangle_cache *cache)
+{
+	pthread_mutex_lock(&demangler->lock);
+	demangler->idle[demangler->idle_count++] = cache;
+	pthread_mutex_unlock(&demangler->lock);
+}
+
+struct demangler* create_demangler(void)
+{
+	struct demangler *demangler = NULL;
+
+#ifndef HAVE_DEMANGLE
+	error(0, ENOTSUP, "relf was built without c++ demangling, names are left as they are");
+#endif
+
+	demangler = calloc(1, sizeof(struct demangler));
+	if(!demangler)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+	pthread_mutex_init(&demangler->lock, NULL);
+
+	return demangler;
+}
+
+void free_demangler(struct demangler *demangler)
+{
+	if(!demangler)
+		return;
+
+	for(size_t i = 0; i < demangler->cache_count; i++)
+	{
+		struct demangle_cache *cache = demangler->caches[i];
+
+		while(cache->chunks)
+		{
+			struct arena_chunk *next = cache->chunks->next;
+
+			free(cache->chunks);
+			cache->chunks = next;
+		}
+
+		free(cache->entries);
+		free(cache->buffer);
+		free(cache);
+	}
+
+	pthread_mutex_destroy(&demangler->lock);
+	free(demangler->caches);
+	free(demangler->idle);
+	free(demangler);
+}
+
+// the result lives until free_demangler
+const char* demangle_name(struct demangler *demangler, const char *name)
+{
+	assert(demangler != NULL);
+	assert(name != NULL);
+
+	struct demangle_cache *cache = NULL;
+	const char *demangled = NULL;
+
+	cache = take_cache(demangler);
+	demangled = demangle_cached(cache, name);
+	return_cache(demangler, cache);
+
+	return demangled;
+}
+
+static void demangle_block(size_t index, void *arg)
+{
+	struct demangle_job *job = arg;
+	size_t end = (index + 1) * DEMANGLE_BLOCK_SIZE;
+
+	if(end > job->count)
+		end = job->count;
+
+	struct demangle_cache *cache = NULL;
+
+	cache = take_cache(job->demangler);
+	for(size_t i = index * DEMANGLE_BLOCK_SIZE; i < end; i++)
+		job->names[i] = demangle_cached(cache, job->names[i]);
+	return_cache(job->demangler, cache);
+}
+
+// replaces every name of the array by its demangled form, big arrays in parallel
+void demangle_names(struct demangler *demangler, const char **names, size_t count)
+{
+	assert(demangler != NULL);
+	assert(names != NULL);
+
+	struct demangle_job job = { demangler, names, count };
+	uint64_t start = get_time_ns();
+
+	parallel_for((count + DEMANGLE_BLOCK_SIZE - 1) / DEMANGLE_BLOCK_SIZE, demangle_block, &job);
+
+	demangler->elapsed_ns += get_time_ns() - start;
+	demangler->names += count;
+}
+
+void print_demangle_stats(const struct demangler *demangler)
+{
+	assert(demangler != NULL);
+
+	uint64_t lookups = 0, hits = 0, demangled = 0;
+
+	for(size_t i = 0; i < demangler->cache_count; i++)
+	{
+		lookups += demangler->caches[i]->lookups;
+		hits += demangler->caches[i]->hits;
+		demangled += demangler->caches[i]->demangled;
+	}
+
+	fprintf(stderr, "demangle: %lu names, %lu c++ names, cache hit rate %.1f%%, %lu distinct names demangled in %zu caches, %.0f names/s\n",
+		demangler->names,
+		lookups,
+		lookups ? 100.0 * (double)hits / (double)lookups : 0.0,
+		demangled,
+		demangler->cache_count,
+		demangler->elapsed_ns ? (double)demangler->names * 1e9 / (double)demangler->elapsed_ns : 0.0);
+}
@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include "dwarf.h"
+
+void dwarf_init_cursor(struct dwarf_cursor *cursor, const unsigned char *data, size_t size)
+{
+	assert(cursor != NULL);
+
+	cursor->start = data;
+	cursor->pos = data;
+	cursor->end = data + size;
+	cursor->error = 0;
+}
+
+size_t dwarf_offset(const struct dwarf_cursor *cursor)
+{
+	return (size_t)(cursor->pos - cursor->start);
+}
+
+size_t dwarf_remaining(const struct dwarf_cursor *cursor)
+{
+	return (size_t)(cursor->end - cursor->pos);
+}
+
+void dwarf_skip(struct dwarf_cursor *cursor, uint64_t size)
+{
+	if(size > dwarf_remaining(cursor))
+	{
+		cursor->pos = cursor->end;
+		cursor->error = 1;
+		return;
+	}
+
+	cursor->pos += size;
+}
+
+// little-endian unsigned value of 1 to 8 bytes
+uint64_t dwarf_read_uint(struct dwarf_cursor *cursor, size_t size)
+{
+	uint64_t value = 0;
+
+	if(size > 8 || size > dwarf_remaining(cursor))
+	{
+		cursor->pos = cursor->end;
+		cursor->error = 1;
+		return 0;
+	}
+
+	for(size_t i = 0; i < size; i++)
+		value |= (uint64_t)cursor->pos[i] << (i * 8);
+
+	cursor->pos += size;
+	return value;
+}
+
+uint8_t dwarf_read_u8(struct dwarf_cursor *cursor)
+{
+	return (uint8_t)dwarf_read_uint(cursor, 1);
+}
+
+uint16_t dwarf_read_u16(struct dwarf_cursor *cursor)
+{
+	return (uint16_t)dwarf_read_uint(cursor, 2);
+}
+
+uint32_t dwarf_read_u32(struct dwarf_cursor *cursor)
+{
+	return (uint32_t)dwarf_read_uint(cursor, 4);
+}
+
+uint64_t dwarf_read_u64(struct dwarf_cursor *cursor)
+{
+	return dwarf_read_uint(cursor, 8);
+}
+
+uint64_t dwarf_read_uleb(struct dwarf_cursor *cursor)
+{
+	uint64_t value = 0;
+	unsigned int shift = 0;
+
+	while(cursor->pos < cursor->end)
+	{
+		uint8_t byte = *cursor->pos++;
+
+		if(shift < 64)
+			value |= (uint64_t)(byte & 0x7f) << shift;
+		shift += 7;
+
+		if(!(byte & 0x80))
+			return value;
+	}
+
+	cursor->error = 1;
+	return value;
+}
+
+int64_t dwarf_read_sleb(struct dwarf_cursor *cursor)
+{
+	uint64_t value = 0;
+	unsigned int shift = 0;
+
+	while(cursor->pos < cursor->end)
+	{
+		uint8_t byte = *cursor->pos++;
+
+		if(shift < 64)
+			value |= (uint64_t)(byte & 0x7f) << shift;
+		shift += 7;
+
+		if(!(byte & 0x80))
+		{
+			if(shift < 64 && (byte & 0x40))
+				value |= ~(uint64_t)0 << shift;
+			return (int64_t)value;
+		}
+	}
+
+	cursor->error = 1;
+	return (int64_t)value;
+}
+
+const char* dwarf_read_string(struct dwarf_cursor *cursor)
+{
+	const char *str = (const char*)cursor->pos;
+	const unsigned char *nul = NULL;
+
+	nul = memchr(cursor->pos, '\0', dwarf_remaining(cursor));
+	if(!nul)
+	{
+		cursor->pos = cursor->end;
+		cursor->error = 1;
+		return "";
+	}
+
+	cursor->pos = nul + 1;
+	return str;
+}
+
+// unit length of the 32 bit (4 byte) or 64 bit (0xffffffff + 8 byte) dwarf format
+uint64_t dwarf_read_initial_length(struct dwarf_cursor *cursor, size_t *offset_size)
+{
+	uint64_t length;
+
+	length = dwarf_read_u32(cursor);
+	*offset_size = 4;
+
+	if(length == 0xffffffff)
+	{
+		length = dwarf_read_u64(cursor);
+		*offset_size = 8;
+	}
+	else if(length >= 0xfffffff0)
+		cursor->error = 1;
+
+	return length;
+}
+
+void dwarf_skip_form(struct dwarf_cursor *cursor, uint64_t form, size_t offset_size, size_t address_size)
+{
+	switch(form)
+	{
+	case DW_FORM_flag_present:
+	case DW_FORM_implicit_const:
+		break;
+	case DW_FORM_data1:
+	case DW_FORM_ref1:
+	case DW_FORM_flag:
+	case DW_FORM_strx1:
+	case DW_FORM_addrx1:
+		dwarf_skip(cursor, 1);
+		break;
+	case DW_FORM_data2:
+	case DW_FORM_ref2:
+	case DW_FORM_strx2:
+	case DW_FORM_addrx2:
+		dwarf_skip(cursor, 2);
+		break;
+	case DW_FORM_strx3:
+	case DW_FORM_addrx3:
+		dwarf_skip(cursor, 3);
+		break;
+	case DW_FORM_data4:
+	case DW_FORM_ref4:
+	case DW_FORM_ref_sup4:
+	case DW_FORM_strx4:
+	case DW_FORM_addrx4:
+		dwarf_skip(cursor, 4);
+		break;
+	case DW_FORM_data8:
+	case DW_FORM_ref8:
+	case DW_FORM_ref_sig8:
+	case DW_FORM_ref_sup8:
+		dwarf_skip(cursor, 8);
+		break;
+	case DW_FORM_data16:
+		dwarf_skip(cursor, 16);
+		break;
+	case DW_FORM_addr:
+		dwarf_skip(cursor, address_size);
+		break;
+	case DW_FORM_strp:
+	case DW_FORM_line_strp:
+	case DW_FORM_sec_offset:
+	case DW_FORM_ref_addr:
+	case DW_FORM_strp_sup:
+	case DW_FORM_GNU_ref_alt:
+	case DW_FORM_GNU_strp_alt:
+		dwarf_skip(cursor, offset_size);
+		break;
+	case DW_FORM_sdata:
+		dwarf_read_sleb(cursor);
+		break;
+	case DW_FORM_udata:
+	case DW_FORM_ref_udata:
+	case DW_FORM_strx:
+	case DW_FORM_addrx:
+	case DW_FORM_loclistx:
+	case DW_FORM_rnglistx:
+	case DW_FORM_GNU_addr_index:
+	case DW_FORM_GNU_str_index:
+		dwarf_read_uleb(cursor);
+		break;
+	case DW_FORM_string:
+		dwarf_read_string(cursor);
+		break;
+	case DW_FORM_block1:
+		dwarf_skip(cursor, dwarf_read_u8(cursor));
+		break;
+	case DW_FORM_block2:
+		dwarf_skip(cursor, dwarf_read_u16(cursor));
+		break;
+	case DW_FORM_block4:
+		dwarf_skip(cursor, dwarf_read_u32(cursor));
+		break;
+	case DW_FORM_block:
+	case DW_FORM_exprloc:
+		dwarf_skip(cursor, dwarf_read_uleb(cursor));
+		break;
+	case DW_FORM_indirect:
+		form = dwarf_read_uleb(cursor);
+		if(form == DW_FORM_indirect)
+			cursor->error = 1;
+		else
+			dwarf_skip_form(cursor, form, offset_size, address_size);
+		break;
+	default:
+		cursor->error = 1;
+		break;
+	}
+}
\ No newline at end of file
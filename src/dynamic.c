@@ -0,0 +1,117 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include "misc.h"
+#include "image.h"
+#include "dynamic.h"
+
+static void widen_dynamic32(Elf64_Dyn *dst, const Elf32_Dyn *src)
+{
+	dst->d_tag = src->d_tag;
+	dst->d_un.d_val = src->d_un.d_val;
+}
+
+static const unsigned char* find_dynamic_data(const struct elf_image *image, uint64_t *size)
+{
+	// the segment is what the dynamic linker reads, sections can be stripped
+	for(size_t i = 0; i < image->header.e_phnum; i++)
+	{
+		const Elf64_Phdr *phdr = &image->program_headers[i];
+
+		if(phdr->p_type == PT_DYNAMIC && phdr->p_offset <= image->size && phdr->p_filesz <= image->size - phdr->p_offset)
+		{
+			*size = phdr->p_filesz;
+			return image->data + phdr->p_offset;
+		}
+	}
+
+	for(size_t i = 0; i < image->header.e_shnum; i++)
+	{
+		const Elf64_Shdr *section = &image->section_headers[i];
+
+		if(section->sh_type == SHT_DYNAMIC && get_section_data(image, section))
+		{
+			*size = section->sh_size;
+			return get_section_data(image, section);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * entries of the dynamic section up to DT_NULL, and the string table named
+ * by DT_STRTAB; returns ENOENT for files without dynamic section
+ */
+int load_dynamic_table(const struct elf_image *image, struct dynamic_table *table)
+{
+	assert(image != NULL);
+	assert(table != NULL);
+
+	size_t entsize = image->elf_class == ELFCLASS32 ? sizeof(Elf32_Dyn) : sizeof(Elf64_Dyn);
+	const unsigned char *data = NULL;
+	uint64_t size = 0, strtab = 0, strsz = 0, available = 0;
+	size_t count;
+
+	memset(table, 0, sizeof(struct dynamic_table));
+
+	data = find_dynamic_data(image, &size);
+	if(!data)
+		return ENOENT;
+
+	count = (size_t)(size / entsize);
+	table->entries = malloc_wrap(sizeof(Elf64_Dyn) * (count + 1));
+
+	for(size_t i = 0; i < count; i++)
+	{
+		Elf64_Dyn *entry = &table->entries[table->count];
+
+		if(image->elf_class == ELFCLASS32)
+		{
+			Elf32_Dyn dyn;
+
+			memcpy(&dyn, data + i * entsize, sizeof(dyn));
+			widen_dynamic32(entry, &dyn);
+		}
+		else
+			memcpy(entry, data + i * entsize, sizeof(Elf64_Dyn));
+
+		if(entry->d_tag == DT_NULL)
+			break;
+		if(entry->d_tag == DT_STRTAB)
+			strtab = entry->d_un.d_ptr;
+		else if(entry->d_tag == DT_STRSZ)
+			strsz = entry->d_un.d_val;
+
+		table->count++;
+	}
+
+	table->strtab = (const char*)get_vaddr_data(image, strtab, &available);
+	table->strtab_size = strsz < available ? strsz : available;
+
+	return 0;
+}
+
+void free_dynamic_table(struct dynamic_table *table)
+{
+	assert(table != NULL);
+
+	free(table->entries);
+	memset(table, 0, sizeof(struct dynamic_table));
+}
+
+const char* get_dynamic_string(const struct dynamic_table *table, uint64_t offset)
+{
+	assert(table != NULL);
+
+	if(!table->strtab || offset >= table->strtab_size || !memchr(table->strtab + offset, '\0', table->strtab_size - offset))
+		return NULL;
+
+	return table->strtab + offset;
+}
@@ -0,0 +1,914 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include "misc.h"
+#include "image.h"
+#include "parallel.h"
+#include "dwarf.h"
+#include "eh_frame.h"
+
+#define DW_EH_PE_absptr 0x00
+#define DW_EH_PE_uleb128 0x01
+#define DW_EH_PE_udata2 0x02
+#define DW_EH_PE_udata4 0x03
+#define DW_EH_PE_udata8 0x04
+#define DW_EH_PE_sleb128 0x09
+#define DW_EH_PE_sdata2 0x0a
+#define DW_EH_PE_sdata4 0x0b
+#define DW_EH_PE_sdata8 0x0c
+#define DW_EH_PE_pcrel 0x10
+#define DW_EH_PE_datarel 0x30
+#define DW_EH_PE_indirect 0x80
+#define DW_EH_PE_omit 0xff
+
+// lookups timed through the search table and by walking .eh_frame
+#define EH_TABLE_SAMPLES (1 << 20)
+#define EH_LINEAR_SAMPLES 1024
+// holes between fdes smaller than this are function alignment padding
+#define EH_GAP_MIN 16
+
+// problems that make an unwinder fall back to a linear search (or fail)
+enum {
+	EH_NO_FRAME = 1 << 0,
+	EH_NO_HDR = 1 << 1,
+	EH_BAD_HDR = 1 << 2,
+	EH_NO_TABLE = 1 << 3,
+	EH_UNSORTED = 1 << 4,
+	EH_INCOMPLETE = 1 << 5,
+	EH_BAD_ENTRY = 1 << 6,
+	EH_BAD_RECORD = 1 << 7,
+	EH_OVERLAP = 1 << 8
+};
+
+static const char * const eh_problem_names[] = {
+	"no .eh_frame",
+	"no .eh_frame_hdr",
+	"bad .eh_frame_hdr",
+	"no search table",
+	"unsorted search table",
+	"incomplete search table",
+	"bad search table entry",
+	"bad cie/fde record",
+	"overlapping fdes"
+};
+
+// part of the file seen at a virtual address
+struct eh_region {
+	const unsigned char *data;
+	uint64_t size;
+	uint64_t vaddr;
+};
+
+struct eh_cie {
+	uint64_t offset;
+	uint8_t fde_encoding;
+	bool augmented;
+};
+
+struct eh_fde {
+	uint64_t offset;	// offset of the record in .eh_frame
+	uint64_t pc_begin;
+	uint64_t pc_range;
+	bool in_table;
+};
+
+// binary search table of .eh_frame_hdr, (initial location, fde address) pairs
+struct eh_table {
+	const unsigned char *data;
+	uint64_t count;
+	size_t entry_size;	// size of one of the two values, 0 when not searchable
+	uint8_t encoding;
+	uint64_t vaddr;
+	uint64_t hdr_vaddr;	// base of datarel values
+};
+
+struct eh_gap {
+	const char *section;
+	uint64_t start;
+	uint64_t size;
+};
+
+// the image stays mapped until the report is printed, frame and table
+// point into it
+struct eh_report {
+	const char *filename;
+	struct elf_image image;
+	int status;
+	int problems;
+	size_t address_size;
+	struct eh_region frame;
+	struct eh_table table;
+	bool has_hdr;
+	size_t cie_count;
+	struct eh_fde *fdes;
+	size_t fde_count;
+	size_t fde_capacity;
+	size_t unsorted_index;	// first table entry out of order
+	size_t missing_count;	// fdes without table entry
+	size_t bad_entry_count;
+	struct eh_gap *gaps;
+	size_t gap_count;
+	size_t gap_capacity;
+	uint64_t gap_bytes;
+};
+
+// called for every fde while walking .eh_frame, true stops the walk
+typedef bool (*eh_fde_func)(const struct eh_fde *fde, void *arg);
+
+static size_t get_encoding_size(uint8_t encoding, size_t address_size)
+{
+	switch(encoding & 0x0f)
+	{
+	case DW_EH_PE_absptr:
+		return address_size;
+	case DW_EH_PE_udata2:
+	case DW_EH_PE_sdata2:
+		return 2;
+	case DW_EH_PE_udata4:
+	case DW_EH_PE_sdata4:
+		return 4;
+	case DW_EH_PE_udata8:
+	case DW_EH_PE_sdata8:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+// pointer stored with a DW_EH_PE_* encoding, pc relative values are relative
+// to the address of the field itself
+static uint64_t read_encoded(struct dwarf_cursor *cursor, uint8_t encoding, const struct eh_region *region, uint64_t data_base, size_t address_size)
+{
+	uint64_t field = region->vaddr + dwarf_offset(cursor);
+	uint64_t value = 0;
+
+	switch(encoding & 0x0f)
+	{
+	case DW_EH_PE_absptr:
+		value = dwarf_read_uint(cursor, address_size);
+		break;
+	case DW_EH_PE_uleb128:
+		value = dwarf_read_uleb(cursor);
+		break;
+	case DW_EH_PE_udata2:
+		value = dwarf_read_u16(cursor);
+		break;
+	case DW_EH_PE_udata4:
+		value = dwarf_read_u32(cursor);
+		break;
+	case DW_EH_PE_udata8:
+	case DW_EH_PE_sdata8:
+		value = dwarf_read_u64(cursor);
+		break;
+	case DW_EH_PE_sleb128:
+		value = (uint64_t)dwarf_read_sleb(cursor);
+		break;
+	case DW_EH_PE_sdata2:
+		value = (uint64_t)(int64_t)(int16_t)dwarf_read_u16(cursor);
+		break;
+	case DW_EH_PE_sdata4:
+		value = (uint64_t)(int64_t)(int32_t)dwarf_read_u32(cursor);
+		break;
+	default:
+		cursor->error = 1;
+		return 0;
+	}
+
+	switch(encoding & 0x70)
+	{
+	case 0:
+		break;
+	case DW_EH_PE_pcrel:
+		value += field;
+		break;
+	case DW_EH_PE_datarel:
+		value += data_base;
+		break;
+	default:
+		// text and function relative values need a base we do not know
+		cursor->error = 1;
+		return 0;
+	}
+
+	if(address_size == 4)
+		value &= 0xffffffff;
+
+	return value;
+}
+
+static const struct eh_cie* find_cie(const struct eh_cie *cies, size_t count, uint64_t offset)
+{
+	size_t low = 0, high = count;
+
+	while(low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+
+		if(cies[mid].offset < offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low < count && cies[low].offset == offset ? &cies[low] : NULL;
+}
+
+static bool read_cie(struct dwarf_cursor *record, const struct eh_region *frame, size_t address_size, struct eh_cie *cie)
+{
+	uint8_t version;
+	const char *augmentation = NULL;
+
+	version = dwarf_read_u8(record);
+	if(version != 1 && version != 3)
+		return false;
+
+	augmentation = dwarf_read_string(record);
+	dwarf_read_uleb(record);	// code alignment
+	dwarf_read_sleb(record);	// data alignment
+	if(version == 1)
+		dwarf_read_u8(record);	// return address register
+	else
+		dwarf_read_uleb(record);
+
+	cie->fde_encoding = DW_EH_PE_absptr;
+	cie->augmented = augmentation[0] == 'z';
+	if(!cie->augmented)
+		return !record->error && augmentation[0] == '\0';
+
+	dwarf_read_uleb(record);	// augmentation data length
+
+	// 'S' (signal frame) and 'B' carry no data, anything unknown ends the
+	// list; the instructions after it are never needed here
+	for(const char *c = augmentation + 1; *c != '\0' && !record->error; c++)
+	{
+		if(*c == 'L')
+			dwarf_read_u8(record);
+		else if(*c == 'P')
+		{
+			uint8_t encoding = dwarf_read_u8(record);
+
+			read_encoded(record, encoding & (uint8_t)~DW_EH_PE_indirect, frame, 0, address_size);
+		}
+		else if(*c == 'R')
+			cie->fde_encoding = dwarf_read_u8(record);
+		else if(*c != 'S' && *c != 'B' && *c != 'G')
+			break;
+	}
+
+	return !record->error;
+}
+
+/*
+ * walks the cie and fde records of .eh_frame in place, the same way an
+ * unwinder without a search table has to; returns EH_BAD_RECORD if a record
+ * could not be decoded (the walk stops there)
+ */
+static int walk_eh_frame(const struct eh_region *frame, size_t address_size, size_t *cie_count, eh_fde_func func, void *arg)
+{
+	struct dwarf_cursor cursor;
+	struct eh_cie *cies = NULL;
+	size_t count = 0, capacity = 0;
+	int problems = 0;
+
+	dwarf_init_cursor(&cursor, frame->data, (size_t)frame->size);
+
+	while(dwarf_remaining(&cursor) > 0)
+	{
+		struct dwarf_cursor record;
+		size_t offset_size, record_offset = dwarf_offset(&cursor);
+		uint64_t length, id, id_offset;
+
+		length = dwarf_read_initial_length(&cursor, &offset_size);
+		if(cursor.error || length > dwarf_remaining(&cursor))
+		{
+			problems |= EH_BAD_RECORD;
+			break;
+		}
+		if(length == 0)		// terminator
+			break;
+
+		record = cursor;
+		record.end = record.pos + length;
+		cursor.pos = record.end;
+
+		id_offset = dwarf_offset(&record);
+		id = dwarf_read_uint(&record, offset_size);
+
+		if(id == 0)
+		{
+			struct eh_cie cie;
+
+			if(!read_cie(&record, frame, address_size, &cie))
+			{
+				problems |= EH_BAD_RECORD;
+				break;
+			}
+
+			cie.offset = record_offset;
+			if(count == capacity)
+			{
+				capacity = capacity ? capacity * 2 : 16;
+				cies = realloc_wrap(cies, sizeof(struct eh_cie) * capacity);
+			}
+			cies[count++] = cie;
+		}
+		else
+		{
+			// the cie pointer is relative to the field itself
+			const struct eh_cie *cie = id <= id_offset ? find_cie(cies, count, id_offset - id) : NULL;
+			struct eh_fde fde;
+
+			if(!cie)
+			{
+				problems |= EH_BAD_RECORD;
+				break;
+			}
+
+			fde.offset = record_offset;
+			fde.pc_begin = read_encoded(&record, cie->fde_encoding, frame, 0, address_size);
+			fde.pc_range = read_encoded(&record, cie->fde_encoding & 0x0f, frame, 0, address_size);
+			fde.in_table = false;
+
+			if(record.error)
+			{
+				problems |= EH_BAD_RECORD;
+				break;
+			}
+
+			if(func(&fde, arg))
+				break;
+		}
+	}
+
+	if(cie_count)
+		*cie_count = count;
+
+	free(cies);
+	return problems;
+}
+
+static bool collect_fde(const struct eh_fde *fde, void *arg)
+{
+	struct eh_report *report = arg;
+
+	if(report->fde_count == report->fde_capacity)
+	{
+		report->fde_capacity = report->fde_capacity ? report->fde_capacity * 2 : 256;
+		report->fdes = realloc_wrap(report->fdes, sizeof(struct eh_fde) * report->fde_capacity);
+	}
+	report->fdes[report->fde_count++] = *fde;
+	return false;
+}
+
+static int read_eh_frame_hdr(const struct elf_image *image, const Elf64_Phdr *phdr, struct eh_report *report)
+{
+	struct eh_region hdr;
+	struct dwarf_cursor cursor;
+	uint8_t version, frame_encoding, count_encoding, table_encoding;
+	uint64_t frame_vaddr, available = 0;
+
+	if(phdr->p_offset > image->size || phdr->p_filesz > image->size - phdr->p_offset)
+		return EH_BAD_HDR;
+
+	hdr.data = image->data + phdr->p_offset;
+	hdr.size = phdr->p_filesz;
+	hdr.vaddr = phdr->p_vaddr;
+
+	dwarf_init_cursor(&cursor, hdr.data, (size_t)hdr.size);
+	version = dwarf_read_u8(&cursor);
+	frame_encoding = dwarf_read_u8(&cursor);
+	count_encoding = dwarf_read_u8(&cursor);
+	table_encoding = dwarf_read_u8(&cursor);
+	if(cursor.error || version != 1)
+		return EH_BAD_HDR;
+
+	frame_vaddr = read_encoded(&cursor, frame_encoding, &hdr, hdr.vaddr, report->address_size);
+	if(cursor.error)
+		return EH_BAD_HDR;
+
+	report->frame.vaddr = frame_vaddr;
+	report->frame.data = get_vaddr_data(image, frame_vaddr, &available);
+	report->frame.size = available;
+
+	// the section header, when there is one, gives the exact size
+	for(size_t i = 0; i < image->header.e_shnum; i++)
+		if(image->section_headers[i].sh_addr == frame_vaddr && image->section_headers[i].sh_type != SHT_NULL &&
+			image->section_headers[i].sh_size <= available)
+			report->frame.size = image->section_headers[i].sh_size;
+
+	if(!report->frame.data)
+		return EH_BAD_HDR;
+
+	report->table.hdr_vaddr = hdr.vaddr;
+	report->table.encoding = table_encoding;
+	if(count_encoding == DW_EH_PE_omit || table_encoding == DW_EH_PE_omit)
+		return EH_NO_TABLE;
+
+	report->table.count = read_encoded(&cursor, count_encoding, &hdr, hdr.vaddr, report->address_size);
+	report->table.entry_size = get_encoding_size(table_encoding, report->address_size);
+	report->table.data = cursor.pos;
+	report->table.vaddr = hdr.vaddr + dwarf_offset(&cursor);
+
+	// binary search needs fixed size entries
+	if(cursor.error || report->table.entry_size == 0)
+		return EH_NO_TABLE;
+	if(report->table.count > dwarf_remaining(&cursor) / (report->table.entry_size * 2))
+		return EH_BAD_HDR;
+
+	return 0;
+}
+
+static void read_table_entry(const struct eh_table *table, uint64_t index, size_t address_size, uint64_t *location, uint64_t *fde)
+{
+	struct dwarf_cursor cursor;
+	struct eh_region region;
+	size_t offset = (size_t)index * table->entry_size * 2;
+
+	region.data = table->data;
+	region.size = table->entry_size * 2 * table->count;
+	region.vaddr = table->vaddr;
+
+	dwarf_init_cursor(&cursor, table->data, (size_t)region.size);
+	dwarf_skip(&cursor, offset);
+	*location = read_encoded(&cursor, table->encoding, &region, table->hdr_vaddr, address_size);
+	*fde = read_encoded(&cursor, table->encoding, &region, table->hdr_vaddr, address_size);
+}
+
+static struct eh_fde* find_fde_by_offset(struct eh_report *report, uint64_t offset)
+{
+	size_t low = 0, high = report->fde_count;
+
+	while(low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+
+		if(report->fdes[mid].offset < offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	return low < report->fde_count && report->fdes[low].offset == offset ? &report->fdes[low] : NULL;
+}
+
+// every table entry must point at an fde of .eh_frame starting at the same
+// location, in ascending order, and every fde must be in the table
+static int check_search_table(struct eh_report *report)
+{
+	int problems = 0;
+	uint64_t previous = 0;
+	size_t required = 0;
+
+	report->unsorted_index = SIZE_MAX;
+
+	for(uint64_t i = 0; i < report->table.count; i++)
+	{
+		uint64_t location, fde_vaddr;
+		struct eh_fde *fde = NULL;
+
+		read_table_entry(&report->table, i, report->address_size, &location, &fde_vaddr);
+
+		if(i > 0 && location <= previous && report->unsorted_index == SIZE_MAX)
+		{
+			report->unsorted_index = (size_t)i;
+			problems |= EH_UNSORTED;
+		}
+		previous = location;
+
+		if(fde_vaddr >= report->frame.vaddr)
+			fde = find_fde_by_offset(report, fde_vaddr - report->frame.vaddr);
+
+		if(!fde || fde->pc_begin != location)
+		{
+			report->bad_entry_count++;
+			problems |= EH_BAD_ENTRY;
+		}
+		else
+			fde->in_table = true;
+	}
+
+	// fdes of code discarded by the linker cover nothing and need no entry
+	for(size_t i = 0; i < report->fde_count; i++)
+	{
+		if(report->fdes[i].pc_range == 0)
+			continue;
+
+		required++;
+		if(!report->fdes[i].in_table)
+			report->missing_count++;
+	}
+
+	if(report->missing_count > 0 || report->table.count < required)
+		problems |= EH_INCOMPLETE;
+
+	return problems;
+}
+
+static int compare_fde_pc(const void *a, const void *b)
+{
+	const struct eh_fde *fa = a;
+	const struct eh_fde *fb = b;
+
+	if(fa->pc_begin != fb->pc_begin)
+		return fa->pc_begin < fb->pc_begin ? -1 : 1;
+	return 0;
+}
+
+static void add_gap(struct eh_report *report, const char *section, uint64_t start, uint64_t end)
+{
+	if(end <= start)
+		return;
+
+	report->gap_bytes += end - start;
+	if(end - start < EH_GAP_MIN)
+		return;
+
+	if(report->gap_count == report->gap_capacity)
+	{
+		report->gap_capacity = report->gap_capacity ? report->gap_capacity * 2 : 16;
+		report->gaps = realloc_wrap(report->gaps, sizeof(struct eh_gap) * report->gap_capacity);
+	}
+	report->gaps[report->gap_count].section = section;
+	report->gaps[report->gap_count].start = start;
+	report->gaps[report->gap_count].size = end - start;
+	report->gap_count++;
+}
+
+// code of executable sections that no fde covers cannot be unwound through
+static int find_coverage_gaps(const struct elf_image *image, struct eh_report *report)
+{
+	struct eh_fde *sorted = NULL;
+	size_t count = 0;
+	int problems = 0;
+
+	sorted = malloc_wrap(sizeof(struct eh_fde) * (report->fde_count + 1));
+	for(size_t i = 0; i < report->fde_count; i++)
+		if(report->fdes[i].pc_range > 0)
+			sorted[count++] = report->fdes[i];
+
+	qsort(sorted, count, sizeof(struct eh_fde), compare_fde_pc);
+
+	for(size_t i = 1; i < count; i++)
+		if(sorted[i].pc_begin < sorted[i - 1].pc_begin + sorted[i - 1].pc_range)
+			problems |= EH_OVERLAP;
+
+	for(size_t i = 0; i < image->header.e_shnum; i++)
+	{
+		const Elf64_Shdr *section = &image->section_headers[i];
+		uint64_t start = section->sh_addr, end = section->sh_addr + section->sh_size;
+		uint64_t position = start;
+		size_t j = 0;
+
+		if(!(section->sh_flags & SHF_EXECINSTR) || !(section->sh_flags & SHF_ALLOC) || section->sh_size == 0)
+			continue;
+
+		// first fde that may reach into the section
+		while(j < count && sorted[j].pc_begin + sorted[j].pc_range <= start)
+			j++;
+
+		for(; j < count && sorted[j].pc_begin < end; j++)
+		{
+			add_gap(report, get_section_name(image, section), position, sorted[j].pc_begin);
+			if(sorted[j].pc_begin + sorted[j].pc_range > position)
+				position = sorted[j].pc_begin + sorted[j].pc_range;
+		}
+
+		add_gap(report, get_section_name(image, section), position, end);
+	}
+
+	free(sorted);
+	return problems;
+}
+
+static void check_eh_frame(const char *filename, struct eh_report *report)
+{
+	struct elf_image *image = &report->image;
+	const Elf64_Phdr *hdr_phdr = NULL;
+	Elf64_Shdr *section = NULL;
+
+	memset(report, 0, sizeof(struct eh_report));
+	report->filename = filename;
+
+	report->status = open_elf_image(image, filename);
+	if(report->status != 0)
+		return;
+
+	report->address_size = image->elf_class == ELFCLASS32 ? 4 : 8;
+
+	for(size_t i = 0; i < image->header.e_phnum; i++)
+		if(image->program_headers[i].p_type == PT_GNU_EH_FRAME)
+			hdr_phdr = &image->program_headers[i];
+
+	if(hdr_phdr)
+	{
+		report->has_hdr = true;
+		report->problems |= read_eh_frame_hdr(image, hdr_phdr, report);
+	}
+	else if((section = find_section(image, ".eh_frame")) != NULL && get_section_data(image, section))
+	{
+		report->frame.data = get_section_data(image, section);
+		report->frame.size = section->sh_size;
+		report->frame.vaddr = section->sh_addr;
+	}
+	else
+		report->problems |= EH_NO_FRAME;
+
+	if(report->frame.data)
+	{
+		report->problems |= walk_eh_frame(&report->frame, report->address_size, &report->cie_count, collect_fde, report);
+
+		// relocatable files get their header from the linker, which leaves
+		// it out when there is nothing to search
+		if(!report->has_hdr && image->header.e_type != ET_REL && report->fde_count > 0)
+			report->problems |= EH_NO_HDR;
+		if(report->table.data && !(report->problems & (EH_BAD_HDR | EH_NO_TABLE)))
+			report->problems |= check_search_table(report);
+		if(image->header.e_type != ET_REL)
+			report->problems |= find_coverage_gaps(image, report);
+	}
+}
+
+struct eh_batch {
+	struct eh_report *reports;
+	size_t count;
+};
+
+static void check_eh_frame_job(size_t index, void *arg)
+{
+	struct eh_batch *batch = arg;
+	struct eh_report *report = &batch->reports[index];
+
+	check_eh_frame(report->filename, report);
+
+	// only a single file is printed in detail, the others need no mapping
+	if(batch->count > 1)
+		free_elf_image(&report->image);
+}
+
+static void free_eh_report(struct eh_report *report)
+{
+	free_elf_image(&report->image);
+	free(report->fdes);
+	free(report->gaps);
+}
+
+static void print_eh_problems(int problems)
+{
+	bool first = true;
+
+	for(size_t i = 0; i < sizeof(eh_problem_names) / sizeof(eh_problem_names[0]); i++)
+	{
+		if(!(problems & (1 << i)))
+			continue;
+
+		printf("%s%s", first ? "" : ", ", eh_problem_names[i]);
+		first = false;
+	}
+
+	if(first)
+		printf("none");
+}
+
+static uint64_t next_random(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+// what an unwinder does with .eh_frame_hdr: binary search on the raw table
+static uint64_t lookup_table(const struct eh_report *report, uint64_t pc)
+{
+	uint64_t low = 0, high = report->table.count;
+	uint64_t location, fde = 0;
+
+	// the encoding every linker emits is searched without decoding
+	if(report->table.encoding == (DW_EH_PE_datarel | DW_EH_PE_sdata4) && report->address_size == 8)
+	{
+		const unsigned char *table = report->table.data;
+		int32_t entry[2];
+
+		while(low < high)
+		{
+			uint64_t mid = low + (high - low) / 2;
+
+			memcpy(entry, table + mid * 8, 4);
+			if(report->table.hdr_vaddr + (uint64_t)(int64_t)entry[0] <= pc)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+
+		if(low == 0)
+			return 0;
+
+		memcpy(entry, table + (low - 1) * 8, 8);
+		return report->table.hdr_vaddr + (uint64_t)(int64_t)entry[1];
+	}
+
+	while(low < high)
+	{
+		uint64_t mid = low + (high - low) / 2;
+
+		read_table_entry(&report->table, mid, report->address_size, &location, &fde);
+		if(location <= pc)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if(low == 0)
+		return 0;
+
+	read_table_entry(&report->table, low - 1, report->address_size, &location, &fde);
+	return fde;
+}
+
+struct linear_lookup {
+	uint64_t pc;
+	uint64_t offset;
+};
+
+static bool match_fde(const struct eh_fde *fde, void *arg)
+{
+	struct linear_lookup *lookup = arg;
+
+	if(lookup->pc - fde->pc_begin < fde->pc_range)
+	{
+		lookup->offset = fde->offset;
+		return true;
+	}
+
+	return false;
+}
+
+static void print_lookup_timing(const struct eh_report *report)
+{
+	uint64_t *samples = NULL;
+	uint64_t state = 0x9e3779b97f4a7c15, checksum = 0;
+	volatile uint64_t sink;		// keeps the lookups from being optimized away
+	size_t count = 0;
+	uint64_t start;
+	double table_ns = 0.0, linear_ns;
+
+	samples = malloc_wrap(sizeof(uint64_t) * EH_TABLE_SAMPLES);
+
+	for(size_t i = 0; i < EH_TABLE_SAMPLES && report->fde_count > 0; i++)
+	{
+		const struct eh_fde *fde = &report->fdes[next_random(&state) % report->fde_count];
+
+		if(fde->pc_range > 0)
+			samples[count++] = fde->pc_begin + next_random(&state) % fde->pc_range;
+	}
+
+	if(count == 0)
+	{
+		free(samples);
+		return;
+	}
+
+	printf("\nLookups (%zu random addresses):\n", count);
+
+	if(report->table.count > 0 && report->table.entry_size > 0)
+	{
+		start = get_time_ns();
+		for(size_t i = 0; i < count; i++)
+			checksum += lookup_table(report, samples[i]);
+		table_ns = (double)(get_time_ns() - start) / (double)count;
+		printf("  search table:     %10.1f ns per lookup\n", table_ns);
+	}
+
+	if(count > EH_LINEAR_SAMPLES)
+		count = EH_LINEAR_SAMPLES;
+
+	start = get_time_ns();
+	for(size_t i = 0; i < count; i++)
+	{
+		struct linear_lookup lookup = {samples[i], 0};
+
+		walk_eh_frame(&report->frame, report->address_size, NULL, match_fde, &lookup);
+		checksum += lookup.offset;
+	}
+	linear_ns = (double)(get_time_ns() - start) / (double)count;
+
+	printf("  .eh_frame walk:   %10.1f ns per lookup", linear_ns);
+	if(table_ns > 0.0)
+		printf(" (%.0fx slower)", linear_ns / table_ns);
+	printf("\n");
+
+	sink = checksum;
+	(void)sink;
+
+	free(samples);
+}
+
+static void print_eh_report(const struct eh_report *report)
+{
+	printf("Unwind tables:\n");
+
+	if(report->has_hdr)
+	{
+		if(report->table.data)
+			printf("  .eh_frame_hdr  table encoding %#04x, %lu entries at %#018lx\n",
+				report->table.encoding, report->table.count, report->table.vaddr);
+		else
+			printf("  .eh_frame_hdr  no search table\n");
+	}
+
+	if(report->frame.data)
+	{
+		printf("  .eh_frame      %#018lx size %#lx, %zu cies, %zu fdes\n",
+			report->frame.vaddr, report->frame.size, report->cie_count, report->fde_count);
+	}
+
+	if(report->problems & EH_UNSORTED)
+		printf("  search table is not sorted from entry %zu\n", report->unsorted_index);
+	if(report->missing_count > 0)
+		printf("  %zu fdes are missing from the search table\n", report->missing_count);
+	if(report->bad_entry_count > 0)
+		printf("  %zu table entries do not point to a matching fde\n", report->bad_entry_count);
+
+	if(report->gap_count > 0)
+	{
+		printf("\nCoverage gaps (code without fde, at least %d bytes):\n", EH_GAP_MIN);
+		printf("  Section          Start              Size\n");
+
+		for(size_t i = 0; i < report->gap_count; i++)
+			printf("  %-16s %#018lx %#lx\n", report->gaps[i].section, report->gaps[i].start, report->gaps[i].size);
+	}
+	printf("  %lu bytes of executable sections are not covered by any fde\n", report->gap_bytes);
+
+	if(report->frame.data && !(report->problems & EH_BAD_RECORD))
+		print_lookup_timing(report);
+
+	printf("\nProblems: ");
+	print_eh_problems(report->problems);
+	printf("\n");
+}
+
+/*
+ * checks the unwind tables of every file, one file is printed in detail and
+ * many are checked in parallel with one line per file; returns the number of
+ * elf files with problems
+ */
+size_t print_eh_frame(char **filenames, size_t count)
+{
+	struct eh_report *reports = NULL;
+	struct eh_batch batch;
+	size_t bad_count = 0;
+
+	assert(filenames != NULL);
+
+	reports = malloc_wrap(sizeof(struct eh_report) * (count + 1));
+	for(size_t i = 0; i < count; i++)
+		reports[i].filename = filenames[i];
+
+	batch.reports = reports;
+	batch.count = count;
+	parallel_for(count, check_eh_frame_job, &batch);
+
+	for(size_t i = 0; i < count; i++)
+	{
+		struct eh_report *report = &reports[i];
+
+		if(report->status != 0)
+		{
+			error(0, report->status, "\'%s\' is not a valid elf file", report->filename);
+			free_eh_report(report);
+			bad_count++;
+			continue;
+		}
+
+		if(report->problems)
+			bad_count++;
+
+		if(count == 1)
+			print_eh_report(report);
+		else
+		{
+			printf("%s: %s (%zu fdes)", report->filename, report->problems ? "BAD" : "ok", report->fde_count);
+			if(report->problems)
+			{
+				printf(": ");
+				print_eh_problems(report->problems);
+			}
+			printf("\n");
+		}
+
+		free_eh_report(report);
+	}
+
+	if(count > 1)
+		printf("%zu of %zu files have bad unwind tables or cannot be read\n", bad_count, count);
+
+	free(reports);
+	return bad_count;
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <errno.h>
 #include <error.h>
 #include <assert.h>
@@ -89,7 +90,7 @@ static const char* get_elf_osabi(uint8_t osabi_code)
 	return osabi[OSABI_UNKNOWN];
 }
 
-static const char* get_elf_machine(uint16_t machine_code)
+const char* get_elf_machine(uint16_t machine_code)
 {
 	switch(machine_code)
 	{
@@ -124,6 +125,14 @@ static const char* get_elf_machine(uint16_t machine_code)
 	return machine[MACHINE_UNKNOWN];
 }
 
+const char* get_elf_type(uint16_t type_code)
+{
+	if(type_code > ET_CORE)
+		return type[ET_NONE];
+
+	return type[type_code];
+}
+
 Elf32_Ehdr* read_elf32_header(const char *filename)
 {
 	assert(filename != NULL);
@@ -184,7 +193,7 @@ void print_elf32_header(Elf32_Ehdr *hdr)
 
 	printf("  ABI Version:                       %x\n", hdr->e_ident[EI_ABIVERSION]);;
 
-	printf("  Type:                              %s\n", type[hdr->e_type]);
+	printf("  Type:                              %s\n", get_elf_type(hdr->e_type));
 
 	const char *p_machine = get_elf_machine(hdr->e_machine);
 	printf("  Machine:                           %s\n", p_machine);
@@ -228,7 +237,7 @@ void print_elf64_header(Elf64_Ehdr *hdr)
 
 	printf("  ABI Version:                       %x\n", hdr->e_ident[EI_ABIVERSION]);;
 
-	printf("  Type:                              %s\n", type[hdr->e_type]);
+	printf("  Type:                              %s\n", get_elf_type(hdr->e_type));
 
 	const char *p_machine = get_elf_machine(hdr->e_machine);
 	printf("  Machine:                           %s\n", p_machine);
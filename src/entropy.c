@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include "misc.h"
+#include "image.h"
+#include "parallel.h"
+#include "entropy.h"
+#include "section_header.h"
+
+// big sections and segments are split into ranges of this size, so one of
+// them can be counted by several threads
+#define ENTROPY_RANGE_SIZE (1024 * 1024)
+// bytes counted into the 32 bit sub-histograms before they are flushed
+#define COUNT_BLOCK_SIZE (1u << 30)
+
+struct entropy_range {
+	const unsigned char *data;
+	size_t size;
+	struct byte_stats *stats;	// section or segment the range belongs to
+	uint64_t histogram[256];
+};
+
+struct entropy_ranges {
+	struct entropy_range *items;
+	size_t count;
+	size_t capacity;
+};
+
+/*
+ * a byte histogram has no profitable SIMD formulation without conflict
+ * detection, so the kernel reads 8 bytes at a time and spreads them over four
+ * sub-histograms: consecutive equal bytes no longer wait on each other's store
+ */
+void count_bytes(const unsigned char *data, size_t size, uint64_t *histogram)
+{
+	assert(histogram != NULL);
+
+	uint32_t counts[4][256];
+
+	while(size > 0)
+	{
+		size_t block = size > COUNT_BLOCK_SIZE ? COUNT_BLOCK_SIZE : size;
+		size_t i = 0;
+
+		memset(counts, 0, sizeof(counts));
+
+		for(; i + 8 <= block; i += 8)
+		{
+			uint64_t word;
+
+			memcpy(&word, data + i, sizeof(word));
+			counts[0][word & 0xff]++;
+			counts[1][(word >> 8) & 0xff]++;
+			counts[2][(word >> 16) & 0xff]++;
+			counts[3][(word >> 24) & 0xff]++;
+			counts[0][(word >> 32) & 0xff]++;
+			counts[1][(word >> 40) & 0xff]++;
+			counts[2][(word >> 48) & 0xff]++;
+			counts[3][word >> 56]++;
+		}
+
+		for(; i < block; i++)
+			counts[0][data[i]]++;
+
+		for(size_t b = 0; b < 256; b++)
+			histogram[b] += (uint64_t)counts[0][b] + counts[1][b] + counts[2][b] + counts[3][b];
+
+		data += block;
+		size -= block;
+	}
+}
+
+// order-0 entropy is also the bound of what an entropy coder can achieve,
+// which is used as the compressibility estimate
+void finish_byte_stats(struct byte_stats *stats)
+{
+	assert(stats != NULL);
+
+	double entropy = 0.0;
+
+	stats->total = 0;
+	stats->top_byte = 0;
+
+	for(size_t b = 0; b < 256; b++)
+	{
+		stats->total += stats->histogram[b];
+		if(stats->histogram[b] > stats->histogram[stats->top_byte])
+			stats->top_byte = (uint8_t)b;
+	}
+
+	for(size_t b = 0; b < 256 && stats->total > 0; b++)
+	{
+		if(stats->histogram[b] > 0)
+		{
+			double p = (double)stats->histogram[b] / (double)stats->total;
+			entropy -= p * log2(p);
+		}
+	}
+
+	stats->entropy = entropy;
+	stats->compressibility = entropy / 8.0;
+}
+
+static void count_range(size_t index, void *arg)
+{
+	struct entropy_range *ranges = arg;
+
+	memset(ranges[index].histogram, 0, sizeof(ranges[index].histogram));
+	count_bytes(ranges[index].data, ranges[index].size, ranges[index].histogram);
+}
+
+static void add_ranges(struct entropy_ranges *ranges, const unsigned char *data, uint64_t size, struct byte_stats *stats)
+{
+	for(uint64_t offset = 0; offset < size; offset += ENTROPY_RANGE_SIZE)
+	{
+		struct entropy_range *range = NULL;
+		uint64_t length = size - offset;
+
+		if(length > ENTROPY_RANGE_SIZE)
+			length = ENTROPY_RANGE_SIZE;
+
+		if(ranges->count == ranges->capacity)
+		{
+			ranges->capacity = ranges->capacity ? ranges->capacity * 2 : 64;
+			ranges->items = realloc_wrap(ranges->items, sizeof(struct entropy_range) * ranges->capacity);
+		}
+
+		range = &ranges->items[ranges->count++];
+		range->data = data + offset;
+		range->size = (size_t)length;
+		range->stats = stats;
+	}
+}
+
+static void print_segment_entropy(const struct elf_image *image, const struct byte_stats *segment_stats)
+{
+	printf("\nLoad segments:\n");
+	printf("  [Nr] Offset             FileSize           Flg Entropy EstSize TopByte\n");
+
+	for(size_t i = 0; i < image->header.e_phnum; i++)
+	{
+		const Elf64_Phdr *phdr = &image->program_headers[i];
+		const struct byte_stats *stats = &segment_stats[i];
+
+		if(phdr->p_type != PT_LOAD)
+			continue;
+
+		printf("  [%2zu] %#018lx %#018lx %c%c%c %7.3f %6.2f%% %02x (%5.2f%%)\n",
+			i,
+			phdr->p_offset,
+			phdr->p_filesz,
+			(phdr->p_flags & PF_R) ? 'R' : ' ',
+			(phdr->p_flags & PF_W) ? 'W' : ' ',
+			(phdr->p_flags & PF_X) ? 'E' : ' ',
+			stats->entropy,
+			stats->compressibility * 100.0,
+			stats->top_byte,
+			stats->total ? 100.0 * (double)stats->histogram[stats->top_byte] / (double)stats->total : 0.0);
+	}
+}
+
+void print_entropy(const char *filename)
+{
+	assert(filename != NULL);
+
+	struct elf_image image;
+	struct byte_stats *section_stats = NULL;
+	struct byte_stats *segment_stats = NULL;
+	struct entropy_ranges ranges = {NULL, 0, 0};
+	int ret;
+
+	ret = open_elf_image(&image, filename);
+	if(ret != 0)
+	{
+		error(0, ret, "\'%s\' is not a valid elf file", filename);
+		free_elf_image(&image);
+		return;
+	}
+
+	section_stats = calloc(image.header.e_shnum + 1u, sizeof(struct byte_stats));
+	segment_stats = calloc(image.header.e_phnum + 1u, sizeof(struct byte_stats));
+	if(!section_stats || !segment_stats)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	for(size_t i = 0; i < image.header.e_shnum; i++)
+	{
+		Elf64_Shdr *section = &image.section_headers[i];
+		unsigned char *data = get_section_data(&image, section);
+
+		if(data)
+			add_ranges(&ranges, data, section->sh_size, &section_stats[i]);
+	}
+
+	for(size_t i = 0; i < image.header.e_phnum; i++)
+	{
+		Elf64_Phdr *phdr = &image.program_headers[i];
+
+		if(phdr->p_type == PT_LOAD && phdr->p_offset <= image.size && phdr->p_filesz <= image.size - phdr->p_offset)
+			add_ranges(&ranges, image.data + phdr->p_offset, phdr->p_filesz, &segment_stats[i]);
+	}
+
+	parallel_for(ranges.count, count_range, ranges.items);
+
+	for(size_t i = 0; i < ranges.count; i++)
+		for(size_t b = 0; b < 256; b++)
+			ranges.items[i].stats->histogram[b] += ranges.items[i].histogram[b];
+
+	for(size_t i = 0; i < image.header.e_shnum; i++)
+		finish_byte_stats(&section_stats[i]);
+	for(size_t i = 0; i < image.header.e_phnum; i++)
+		finish_byte_stats(&segment_stats[i]);
+
+	if(image.strtab_buffer)
+		print_section64_headers_stats(image.section_headers, &image.header, image.strtab_buffer, section_stats);
+	else
+		error(0, EBADF, "\'%s\': no valid section name string table", filename);
+
+	if(image.program_headers)
+		print_segment_entropy(&image, segment_stats);
+
+	free(ranges.items);
+	free(segment_stats);
+	free(section_stats);
+	free_elf_image(&image);
+}
\ No newline at end of file
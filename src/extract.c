@@ -0,0 +1,636 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include "misc.h"
+#include "image.h"
+#include "search.h"
+#include "extract.h"
+
+// largest piece handed to one copy call
+#define EXTRACT_CHUNK_SIZE ((uint64_t)1 << 30)
+// sections of at least this size keep their offset within a page in the
+// new file, so block aligned parts can be shared (reflinked) with the source
+#define EXTRACT_PAGE_ALIGN_MIN (64 * 1024)
+#define EXTRACT_PAGE_SIZE 4096
+
+// ways the payload bytes were moved
+enum {
+	COPY_FILE_RANGE = 1 << 0,
+	COPY_SENDFILE = 1 << 1,
+	COPY_WRITE = 1 << 2
+};
+
+struct extract_output {
+	int in_fd;
+	const struct elf_image *image;
+	int methods;
+	uint64_t bytes;
+};
+
+/*
+ * moves length bytes from the input file into the output file without going
+ * through user space buffers: copy_file_range (which reflinks or copies on the
+ * server where the filesystem can), then sendfile, and only when both are
+ * refused (old kernels, special files) a write straight from the mapping
+ */
+static int copy_range(struct extract_output *output, uint64_t in_offset, int out_fd, uint64_t out_offset, uint64_t length)
+{
+	off64_t in_pos = (off64_t)in_offset, out_pos = (off64_t)out_offset;
+	ssize_t ret = 0;
+
+	output->bytes += length;
+
+	while(length > 0)
+	{
+		ret = copy_file_range(output->in_fd, &in_pos, out_fd, &out_pos, length < EXTRACT_CHUNK_SIZE ? length : EXTRACT_CHUNK_SIZE, 0);
+		if(ret <= 0)
+			break;
+
+		output->methods |= COPY_FILE_RANGE;
+		length -= (uint64_t)ret;
+	}
+
+	if(length == 0)
+		return 0;
+	if(ret < 0 && errno != EXDEV && errno != EINVAL && errno != ENOSYS && errno != EOPNOTSUPP && errno != EBADF)
+		return errno;
+
+	// sendfile writes at the file position of the output
+	if(lseek(out_fd, (off_t)out_pos, SEEK_SET) < 0)
+		return errno;
+
+	while(length > 0)
+	{
+		off_t pos = (off_t)in_pos;
+
+		ret = sendfile(out_fd, output->in_fd, &pos, length < EXTRACT_CHUNK_SIZE ? length : EXTRACT_CHUNK_SIZE);
+		if(ret <= 0)
+			break;
+
+		output->methods |= COPY_SENDFILE;
+		in_pos = pos;
+		out_pos += ret;
+		length -= (uint64_t)ret;
+	}
+
+	if(length == 0)
+		return 0;
+	if(ret < 0 && errno != EINVAL && errno != ENOSYS)
+		return errno;
+
+	while(length > 0)
+	{
+		ret = pwrite(out_fd, output->image->data + in_pos, length < EXTRACT_CHUNK_SIZE ? length : EXTRACT_CHUNK_SIZE, (off_t)out_pos);
+		if(ret <= 0)
+			return ret < 0 ? errno : EIO;
+
+		output->methods |= COPY_WRITE;
+		in_pos += ret;
+		out_pos += ret;
+		length -= (uint64_t)ret;
+	}
+
+	return 0;
+}
+
+static int write_buffer(int fd, const void *buffer, size_t size, uint64_t offset)
+{
+	const unsigned char *pos = buffer;
+
+	while(size > 0)
+	{
+		ssize_t ret = pwrite(fd, pos, size, (off_t)offset);
+
+		if(ret <= 0)
+			return ret < 0 ? errno : EIO;
+
+		pos += ret;
+		offset += (uint64_t)ret;
+		size -= (size_t)ret;
+	}
+
+	return 0;
+}
+
+static int open_output(const char *path)
+{
+	int fd;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0)
+		error(EXIT_FAILURE, errno, "cannot create file \'%s\'", path);
+
+	return fd;
+}
+
+static void print_copy_methods(const struct extract_output *output)
+{
+	printf("%lu bytes moved with%s%s%s\n",
+		output->bytes,
+		(output->methods & COPY_FILE_RANGE) ? " copy_file_range" : "",
+		(output->methods & COPY_SENDFILE) ? " sendfile" : "",
+		(output->methods & COPY_WRITE) ? " write" : "");
+}
+
+static int open_input(const char *filename, struct elf_image *image, struct extract_output *output)
+{
+	int ret;
+
+	ret = open_elf_image(image, filename);
+	if(ret != 0)
+	{
+		error(0, ret, "\'%s\' is not a valid elf file", filename);
+		free_elf_image(image);
+		return -1;
+	}
+
+	memset(output, 0, sizeof(struct extract_output));
+	output->image = image;
+	output->in_fd = open(filename, O_RDONLY);
+	if(output->in_fd < 0)
+		error(EXIT_FAILURE, errno, "cannot access file \'%s\'", filename);
+
+	return 0;
+}
+
+// selector entries "segment=N" pick program header N, the others sections
+static bool segment_is_selected(size_t index, const char *selector)
+{
+	while(*selector)
+	{
+		size_t length = strcspn(selector, ",");
+		char *end = NULL;
+
+		if(length > 8 && strncmp(selector, "segment=", 8) == 0 &&
+			strtoul(selector + 8, &end, 10) == index && end == selector + length)
+			return true;
+
+		selector += length;
+		if(*selector == ',')
+			selector++;
+	}
+
+	return false;
+}
+
+static void extract_range(struct extract_output *output, const char *what, char *path, uint64_t offset, uint64_t size)
+{
+	int fd, ret;
+
+	fd = open_output(path);
+	ret = copy_range(output, offset, fd, 0, size);
+	if(ret != 0)
+		error(EXIT_FAILURE, ret, "cannot write file \'%s\'", path);
+	close(fd);
+
+	printf("%s -> %s (%lu bytes)\n", what, path, size);
+	free(path);
+}
+
+/*
+ * writes the content of every selected section to <output dir>/<file><name>
+ * and of every selected segment to <output dir>/<file>.segment<N>
+ */
+void extract_sections(const char *filename, const char *selector, const char *output_dir)
+{
+	assert(filename != NULL);
+	assert(selector != NULL);
+
+	struct elf_image image;
+	struct extract_output output;
+	const char *base = NULL;
+	char *path = NULL;
+
+	if(open_input(filename, &image, &output) != 0)
+		return;
+
+	base = strrchr(filename, '/') ? strrchr(filename, '/') + 1 : filename;
+	if(!output_dir)
+		output_dir = ".";
+
+	for(size_t i = 0; i < image.header.e_shnum; i++)
+	{
+		const Elf64_Shdr *section = &image.section_headers[i];
+		const char *name = get_section_name(&image, section);
+
+		if(!section_is_selected(&image, section, selector) || !get_section_data(&image, section))
+			continue;
+
+		if(asprintf(&path, "%s/%s%s%s", output_dir, base, name[0] == '.' ? "" : ".", name) < 0)
+			error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+		extract_range(&output, name, path, section->sh_offset, section->sh_size);
+	}
+
+	for(size_t i = 0; i < image.header.e_phnum; i++)
+	{
+		const Elf64_Phdr *phdr = &image.program_headers[i];
+		char what[32];
+
+		if(!segment_is_selected(i, selector))
+			continue;
+		if(phdr->p_offset > image.size || phdr->p_filesz > image.size - phdr->p_offset)
+		{
+			error(0, EBADF, "\'%s\': segment %zu is out of file", filename, i);
+			continue;
+		}
+
+		if(asprintf(&path, "%s/%s.segment%zu", output_dir, base, i) < 0)
+			error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+		snprintf(what, sizeof(what), "segment %zu", i);
+		extract_range(&output, what, path, phdr->p_offset, phdr->p_filesz);
+	}
+
+	print_copy_methods(&output);
+
+	close(output.in_fd);
+	free_elf_image(&image);
+}
+
+static uint64_t align_up(uint64_t value, uint64_t align)
+{
+	return align > 1 ? (value + align - 1) / align * align : value;
+}
+
+static void narrow_elf32_header(Elf32_Ehdr *dst, const Elf64_Ehdr *src)
+{
+	memcpy(dst->e_ident, src->e_ident, EI_NIDENT);
+	dst->e_type = src->e_type;
+	dst->e_machine = src->e_machine;
+	dst->e_version = src->e_version;
+	dst->e_entry = (Elf32_Addr)src->e_entry;
+	dst->e_phoff = (Elf32_Off)src->e_phoff;
+	dst->e_shoff = (Elf32_Off)src->e_shoff;
+	dst->e_flags = src->e_flags;
+	dst->e_ehsize = sizeof(Elf32_Ehdr);
+	dst->e_phentsize = src->e_phentsize;
+	dst->e_phnum = src->e_phnum;
+	dst->e_shentsize = sizeof(Elf32_Shdr);
+	dst->e_shnum = src->e_shnum;
+	dst->e_shstrndx = src->e_shstrndx;
+}
+
+static void narrow_section32_header(Elf32_Shdr *dst, const Elf64_Shdr *src)
+{
+	dst->sh_name = src->sh_name;
+	dst->sh_type = src->sh_type;
+	dst->sh_flags = (Elf32_Word)src->sh_flags;
+	dst->sh_addr = (Elf32_Addr)src->sh_addr;
+	dst->sh_offset = (Elf32_Off)src->sh_offset;
+	dst->sh_size = (Elf32_Word)src->sh_size;
+	dst->sh_link = src->sh_link;
+	dst->sh_info = src->sh_info;
+	dst->sh_addralign = (Elf32_Word)src->sh_addralign;
+	dst->sh_entsize = (Elf32_Word)src->sh_entsize;
+}
+
+// sections named by sh_link (and sh_info of relocations) come along, so a
+// kept symbol table keeps its string table
+static void keep_linked_sections(const struct elf_image *image, bool *keep)
+{
+	bool changed = true;
+
+	while(changed)
+	{
+		changed = false;
+
+		for(size_t i = 0; i < image->header.e_shnum; i++)
+		{
+			const Elf64_Shdr *section = &image->section_headers[i];
+
+			if(!keep[i])
+				continue;
+
+			if(section->sh_link > 0 && section->sh_link < image->header.e_shnum && !keep[section->sh_link])
+				keep[section->sh_link] = changed = true;
+
+			if((section->sh_flags & SHF_INFO_LINK) && section->sh_info > 0 &&
+				section->sh_info < image->header.e_shnum && !keep[section->sh_info])
+				keep[section->sh_info] = changed = true;
+		}
+	}
+}
+
+static uint32_t remap_index(const size_t *new_index, size_t count, uint32_t index)
+{
+	return index < count ? (uint32_t)new_index[index] : 0;
+}
+
+static uint32_t read_word(const unsigned char *data)
+{
+	uint32_t value;
+
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static size_t find_shndx_table(const struct elf_image *image, size_t symtab)
+{
+	for(size_t i = 1; i < image->header.e_shnum; i++)
+		if(image->section_headers[i].sh_type == SHT_SYMTAB_SHNDX && image->section_headers[i].sh_link == symtab)
+			return i;
+
+	return 0;
+}
+
+static void remap_symbols(const struct elf_image *image, size_t index, const size_t *new_index, unsigned char *symbols)
+{
+	const Elf64_Shdr *src = &image->section_headers[index];
+	bool is64 = image->elf_class == ELFCLASS64;
+	size_t entsize = is64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+	size_t shndx_offset = is64 ? offsetof(Elf64_Sym, st_shndx) : offsetof(Elf32_Sym, st_shndx);
+	size_t info_offset = is64 ? offsetof(Elf64_Sym, st_info) : offsetof(Elf32_Sym, st_info);
+	size_t value_offset = is64 ? offsetof(Elf64_Sym, st_value) : offsetof(Elf32_Sym, st_value);
+	size_t value_size = is64 ? sizeof(Elf64_Addr) : sizeof(Elf32_Addr);
+	size_t shndx_table = find_shndx_table(image, index);
+	const unsigned char *xindex = NULL;
+	size_t xindex_count = 0;
+
+	if(shndx_table)
+	{
+		xindex = get_section_data(image, &image->section_headers[shndx_table]);
+		xindex_count = xindex ? image->section_headers[shndx_table].sh_size / sizeof(uint32_t) : 0;
+	}
+
+	for(size_t i = 0; (i + 1) * entsize <= src->sh_size; i++)
+	{
+		unsigned char *symbol = symbols + i * entsize;
+		uint32_t section;
+		uint16_t shndx;
+
+		memcpy(&shndx, symbol + shndx_offset, sizeof(shndx));
+		if(shndx == SHN_UNDEF || (shndx >= SHN_LORESERVE && shndx != SHN_XINDEX))
+			continue;
+
+		section = shndx;
+		if(shndx == SHN_XINDEX)
+		{
+			if(i >= xindex_count)
+				continue;
+			section = read_word(xindex + i * sizeof(uint32_t));
+		}
+
+		if(section < image->header.e_shnum && new_index[section])
+		{
+			// extended indexes are renumbered in their own table
+			if(shndx != SHN_XINDEX)
+			{
+				shndx = (uint16_t)new_index[section];
+				memcpy(symbol + shndx_offset, &shndx, sizeof(shndx));
+			}
+			continue;
+		}
+
+		// the section of the symbol was dropped
+		if(ELF64_ST_TYPE(symbol[info_offset]) == STT_SECTION || image->header.e_type == ET_REL)
+		{
+			shndx = SHN_UNDEF;
+			memset(symbol + value_offset, 0, value_size);
+		}
+		else
+			shndx = SHN_ABS;
+		memcpy(symbol + shndx_offset, &shndx, sizeof(shndx));
+	}
+}
+
+/*
+ * copy of a kept section whose contents hold section indexes (symbol
+ * tables, groups and extended index tables), renumbered like the section
+ * headers; NULL for other sections. members of a group that were dropped
+ * are left out of it
+ */
+static unsigned char* remap_section_indexes(const struct elf_image *image, size_t index, const size_t *new_index, Elf64_Shdr *dst)
+{
+	const Elf64_Shdr *src = &image->section_headers[index];
+	const unsigned char *data = get_section_data(image, src);
+	unsigned char *copy = NULL;
+
+	if(src->sh_type != SHT_SYMTAB && src->sh_type != SHT_DYNSYM &&
+		src->sh_type != SHT_GROUP && src->sh_type != SHT_SYMTAB_SHNDX)
+		return NULL;
+
+	copy = malloc_wrap(src->sh_size + 1);
+	memcpy(copy, data, src->sh_size);
+
+	if(src->sh_type == SHT_GROUP)
+	{
+		size_t size = sizeof(uint32_t);
+
+		for(size_t pos = sizeof(uint32_t); pos + sizeof(uint32_t) <= src->sh_size; pos += sizeof(uint32_t))
+		{
+			uint32_t member = read_word(data + pos);
+
+			if(member < image->header.e_shnum && new_index[member])
+			{
+				member = (uint32_t)new_index[member];
+				memcpy(copy + size, &member, sizeof(member));
+				size += sizeof(member);
+			}
+		}
+
+		if(size < src->sh_size)
+			dst->sh_size = size;
+	}
+	else if(src->sh_type == SHT_SYMTAB_SHNDX)
+	{
+		for(size_t pos = 0; pos + sizeof(uint32_t) <= src->sh_size; pos += sizeof(uint32_t))
+		{
+			uint32_t entry = remap_index(new_index, image->header.e_shnum, read_word(data + pos));
+
+			memcpy(copy + pos, &entry, sizeof(entry));
+		}
+	}
+	else
+		remap_symbols(image, index, new_index, copy);
+
+	return copy;
+}
+
+/*
+ * writes a new elf file with only the selected sections (and the sections
+ * they link to): elf header, section contents, a rebuilt .shstrtab and the
+ * section header table, program headers are left out
+ */
+void write_section_subset(const char *filename, const char *selector, const char *output_file)
+{
+	assert(filename != NULL);
+	assert(selector != NULL);
+	assert(output_file != NULL);
+
+	struct elf_image image;
+	struct extract_output output;
+	Elf64_Ehdr header;
+	Elf64_Shdr *sections = NULL;
+	bool *keep = NULL;
+	size_t *new_index = NULL;
+	char *strtab = NULL;
+	size_t count = 1, strtab_size = 1, section_count, shstrndx;
+	size_t ehdr_size, shdr_size;
+	uint64_t position;
+	int fd, ret;
+
+	if(open_input(filename, &image, &output) != 0)
+		return;
+
+	keep = calloc(image.header.e_shnum + 1u, sizeof(bool));
+	new_index = calloc(image.header.e_shnum + 1u, sizeof(size_t));
+	if(!keep || !new_index)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	for(size_t i = 1; i < image.header.e_shnum; i++)
+		keep[i] = section_is_selected(&image, &image.section_headers[i], selector);
+
+	keep_linked_sections(&image, keep);
+
+	// the old name table is replaced by the rebuilt one
+	if(image.header.e_shstrndx < image.header.e_shnum)
+		keep[image.header.e_shstrndx] = false;
+
+	for(size_t i = 1; i < image.header.e_shnum; i++)
+		if(keep[i])
+			new_index[i] = count++;
+
+	section_count = count + 1;
+	shstrndx = count;
+	sections = calloc(section_count, sizeof(Elf64_Shdr));
+	strtab = calloc(1, 1);
+	if(!sections || !strtab)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	ehdr_size = image.elf_class == ELFCLASS32 ? sizeof(Elf32_Ehdr) : sizeof(Elf64_Ehdr);
+	shdr_size = image.elf_class == ELFCLASS32 ? sizeof(Elf32_Shdr) : sizeof(Elf64_Shdr);
+	position = ehdr_size;
+
+	for(size_t i = 1; i < image.header.e_shnum; i++)
+	{
+		const Elf64_Shdr *src = &image.section_headers[i];
+		Elf64_Shdr *dst = &sections[new_index[i]];
+		const char *name = get_section_name(&image, src);
+		size_t name_length = strlen(name) + 1;
+
+		if(!keep[i])
+			continue;
+
+		*dst = *src;
+		dst->sh_name = (uint32_t)strtab_size;
+		dst->sh_link = remap_index(new_index, image.header.e_shnum, src->sh_link);
+		if(src->sh_flags & SHF_INFO_LINK)
+			dst->sh_info = remap_index(new_index, image.header.e_shnum, src->sh_info);
+
+		strtab = realloc_wrap(strtab, strtab_size + name_length);
+		memcpy(strtab + strtab_size, name, name_length);
+		strtab_size += name_length;
+
+		if(src->sh_type == SHT_NOBITS)
+		{
+			dst->sh_offset = position;
+			continue;
+		}
+
+		if(src->sh_size >= EXTRACT_PAGE_ALIGN_MIN)
+			position += (src->sh_offset - position % EXTRACT_PAGE_SIZE) % EXTRACT_PAGE_SIZE;
+		else
+			position = align_up(position, src->sh_addralign);
+
+		dst->sh_offset = position;
+		position += src->sh_size;
+	}
+
+	sections[shstrndx].sh_name = (uint32_t)strtab_size;
+	sections[shstrndx].sh_type = SHT_STRTAB;
+	sections[shstrndx].sh_offset = position;
+	sections[shstrndx].sh_addralign = 1;
+	strtab = realloc_wrap(strtab, strtab_size + sizeof(".shstrtab"));
+	memcpy(strtab + strtab_size, ".shstrtab", sizeof(".shstrtab"));
+	strtab_size += sizeof(".shstrtab");
+	sections[shstrndx].sh_size = strtab_size;
+	position = align_up(position + strtab_size, 8);
+
+	header = image.header;
+	header.e_phoff = 0;
+	header.e_phnum = 0;
+	header.e_phentsize = 0;
+	header.e_shoff = position;
+	header.e_shnum = (uint16_t)section_count;
+	header.e_shstrndx = (uint16_t)shstrndx;
+	header.e_ehsize = (uint16_t)ehdr_size;
+	header.e_shentsize = (uint16_t)shdr_size;
+
+	fd = open_output(output_file);
+
+	// payload first, headers are small and written from memory
+	ret = 0;
+	for(size_t i = 1; i < image.header.e_shnum && ret == 0; i++)
+	{
+		const Elf64_Shdr *src = &image.section_headers[i];
+
+		if(keep[i] && src->sh_type != SHT_NOBITS)
+		{
+			Elf64_Shdr *dst = &sections[new_index[i]];
+			unsigned char *contents = NULL;
+
+			if(!get_section_data(&image, src))
+				error(EXIT_FAILURE, EBADF, "\'%s\': section %zu is out of file", filename, i);
+
+			contents = remap_section_indexes(&image, i, new_index, dst);
+			if(contents)
+				ret = write_buffer(fd, contents, dst->sh_size, dst->sh_offset);
+			else
+				ret = copy_range(&output, src->sh_offset, fd, dst->sh_offset, src->sh_size);
+			free(contents);
+		}
+	}
+
+	if(ret == 0)
+		ret = write_buffer(fd, strtab, strtab_size, sections[shstrndx].sh_offset);
+
+	if(image.elf_class == ELFCLASS32)
+	{
+		Elf32_Ehdr header32;
+
+		narrow_elf32_header(&header32, &header);
+		for(size_t i = 0; i < section_count && ret == 0; i++)
+		{
+			Elf32_Shdr section32;
+
+			narrow_section32_header(&section32, &sections[i]);
+			ret = write_buffer(fd, &section32, sizeof(section32), position + i * sizeof(section32));
+		}
+		if(ret == 0)
+			ret = write_buffer(fd, &header32, sizeof(header32), 0);
+	}
+	else
+	{
+		if(ret == 0)
+			ret = write_buffer(fd, sections, sizeof(Elf64_Shdr) * section_count, position);
+		if(ret == 0)
+			ret = write_buffer(fd, &header, sizeof(header), 0);
+	}
+
+	if(ret != 0)
+		error(EXIT_FAILURE, ret, "cannot write file \'%s\'", output_file);
+
+	close(fd);
+
+	printf("%s: %zu sections written to %s\n", filename, section_count - 2, output_file);
+	print_copy_methods(&output);
+
+	free(strtab);
+	free(sections);
+	free(new_index);
+	free(keep);
+	close(output.in_fd);
+	free_elf_image(&image);
+}
@@ -0,0 +1,406 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "misc.h"
+#include "image.h"
+#include "validate.h"
+
+unsigned char* mmap_file(const char *filename, size_t *size)
+{
+	assert(filename != NULL);
+	assert(size != NULL);
+
+	int fd;
+	struct stat statbuf;
+	void *data = NULL;
+
+	fd = open(filename, O_RDONLY);
+	if(fd < 0)
+		error(EXIT_FAILURE, errno, "cannot access file \'%s\'", filename);
+
+	if(fstat(fd, &statbuf) < 0)
+		error(EXIT_FAILURE, errno, "cannot access file \'%s\'", filename);
+
+	if(!S_ISREG(statbuf.st_mode))
+		error(EXIT_FAILURE, EBADF, "\'%s\' is not an ordinary file", filename);
+
+	*size = (size_t)statbuf.st_size;
+	if(*size == 0)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(data == MAP_FAILED)
+		error(EXIT_FAILURE, errno, "cannot map file \'%s\'", filename);
+
+	close(fd);
+	return data;
+}
+
+static void widen_elf32_header(Elf64_Ehdr *dst, const Elf32_Ehdr *src)
+{
+	memcpy(dst->e_ident, src->e_ident, EI_NIDENT);
+	dst->e_type = src->e_type;
+	dst->e_machine = src->e_machine;
+	dst->e_version = src->e_version;
+	dst->e_entry = src->e_entry;
+	dst->e_phoff = src->e_phoff;
+	dst->e_shoff = src->e_shoff;
+	dst->e_flags = src->e_flags;
+	dst->e_ehsize = src->e_ehsize;
+	dst->e_phentsize = src->e_phentsize;
+	dst->e_phnum = src->e_phnum;
+	dst->e_shentsize = src->e_shentsize;
+	dst->e_shnum = src->e_shnum;
+	dst->e_shstrndx = src->e_shstrndx;
+}
+
+static void widen_program32_header(Elf64_Phdr *dst, const Elf32_Phdr *src)
+{
+	dst->p_type = src->p_type;
+	dst->p_flags = src->p_flags;
+	dst->p_offset = src->p_offset;
+	dst->p_vaddr = src->p_vaddr;
+	dst->p_paddr = src->p_paddr;
+	dst->p_filesz = src->p_filesz;
+	dst->p_memsz = src->p_memsz;
+	dst->p_align = src->p_align;
+}
+
+static void widen_section32_header(Elf64_Shdr *dst, const Elf32_Shdr *src)
+{
+	dst->sh_name = src->sh_name;
+	dst->sh_type = src->sh_type;
+	dst->sh_flags = src->sh_flags;
+	dst->sh_addr = src->sh_addr;
+	dst->sh_offset = src->sh_offset;
+	dst->sh_size = src->sh_size;
+	dst->sh_link = src->sh_link;
+	dst->sh_info = src->sh_info;
+	dst->sh_addralign = src->sh_addralign;
+	dst->sh_entsize = src->sh_entsize;
+}
+
+// tables are copied out of the mapping: archive members are only 2-byte aligned
+static int load_elf_tables(struct elf_image *image)
+{
+	Elf64_Ehdr *hdr = &image->header;
+	size_t phentsize = image->elf_class == ELFCLASS32 ? sizeof(Elf32_Phdr) : sizeof(Elf64_Phdr);
+	size_t shentsize = image->elf_class == ELFCLASS32 ? sizeof(Elf32_Shdr) : sizeof(Elf64_Shdr);
+
+	if(hdr->e_phnum > 0)
+	{
+		if(hdr->e_phentsize != phentsize || !range_is_valid(image->size, hdr->e_phoff, (uint64_t)hdr->e_phnum * phentsize))
+			return EBADF;
+
+		image->program_headers = malloc_wrap(sizeof(Elf64_Phdr) * hdr->e_phnum);
+		for(size_t i = 0; i < hdr->e_phnum; i++)
+		{
+			unsigned char *src = image->data + hdr->e_phoff + i * phentsize;
+
+			if(image->elf_class == ELFCLASS32)
+			{
+				Elf32_Phdr phdr;
+				memcpy(&phdr, src, sizeof(phdr));
+				widen_program32_header(&image->program_headers[i], &phdr);
+			}
+			else
+				memcpy(&image->program_headers[i], src, sizeof(Elf64_Phdr));
+		}
+	}
+
+	if(hdr->e_shnum > 0)
+	{
+		if(hdr->e_shentsize != shentsize || !range_is_valid(image->size, hdr->e_shoff, (uint64_t)hdr->e_shnum * shentsize))
+			return EBADF;
+
+		image->section_headers = malloc_wrap(sizeof(Elf64_Shdr) * hdr->e_shnum);
+		for(size_t i = 0; i < hdr->e_shnum; i++)
+		{
+			unsigned char *src = image->data + hdr->e_shoff + i * shentsize;
+
+			if(image->elf_class == ELFCLASS32)
+			{
+				Elf32_Shdr shdr;
+				memcpy(&shdr, src, sizeof(shdr));
+				widen_section32_header(&image->section_headers[i], &shdr);
+			}
+			else
+				memcpy(&image->section_headers[i], src, sizeof(Elf64_Shdr));
+		}
+
+		if(hdr->e_shstrndx != SHN_UNDEF && hdr->e_shstrndx < hdr->e_shnum)
+		{
+			Elf64_Shdr *strtab = &image->section_headers[hdr->e_shstrndx];
+
+			// every name must be terminated inside of the table
+			if(strtab->sh_type == SHT_STRTAB && strtab->sh_size > 0 &&
+				range_is_valid(image->size, strtab->sh_offset, strtab->sh_size) &&
+				image->data[strtab->sh_offset + strtab->sh_size - 1] == '\0')
+			{
+				image->strtab_buffer = (char*)image->data + strtab->sh_offset;
+				image->strtab_size = strtab->sh_size;
+			}
+		}
+
+		for(size_t i = 0; image->strtab_buffer && i < hdr->e_shnum; i++)
+			if(image->section_headers[i].sh_name >= image->strtab_size)
+				image->strtab_buffer = NULL;
+	}
+
+	return 0;
+}
+
+int load_elf_image(struct elf_image *image, const char *name, unsigned char *data, size_t size)
+{
+	assert(image != NULL);
+	assert(name != NULL);
+
+	int ret;
+
+	memset(image, 0, sizeof(struct elf_image));
+	image->name = name;
+	image->data = data;
+	image->size = size;
+
+	if(!data || size < EI_NIDENT || memcmp(data, ELFMAG, SELFMAG) != 0)
+		return ENOEXEC;
+
+	image->elf_class = data[EI_CLASS];
+	if(image->elf_class == ELFCLASS32)
+	{
+		Elf32_Ehdr hdr;
+
+		if(size < sizeof(Elf32_Ehdr))
+			return EBADF;
+		memcpy(&hdr, data, sizeof(hdr));
+		widen_elf32_header(&image->header, &hdr);
+	}
+	else if(image->elf_class == ELFCLASS64)
+	{
+		if(size < sizeof(Elf64_Ehdr))
+			return EBADF;
+		memcpy(&image->header, data, sizeof(Elf64_Ehdr));
+	}
+	else
+		return EBADF;
+
+	ret = load_elf_tables(image);
+	if(ret != 0)
+	{
+		free(image->program_headers);
+		free(image->section_headers);
+		image->program_headers = NULL;
+		image->section_headers = NULL;
+		image->header.e_phnum = 0;
+		image->header.e_shnum = 0;
+	}
+
+	return ret;
+}
+
+int open_elf_image(struct elf_image *image, const char *filename)
+{
+	assert(image != NULL);
+	assert(filename != NULL);
+
+	int ret;
+	size_t size = 0;
+	unsigned char *data = NULL;
+
+	data = mmap_file(filename, &size);
+
+	ret = load_elf_image(image, filename, data, size);
+	image->mapping = data;
+	image->mapping_size = size;
+
+	return ret;
+}
+
+void free_elf_image(struct elf_image *image)
+{
+	assert(image != NULL);
+
+	free(image->program_headers);
+	free(image->section_headers);
+
+	if(image->mapping)
+		munmap(image->mapping, image->mapping_size);
+
+	memset(image, 0, sizeof(struct elf_image));
+}
+
+/*
+ * like open_elf_image, but a file that cannot be opened or mapped gives an
+ * error code instead of ending the program; st receives the state of the
+ * mapped file
+ */
+int map_elf_image(struct elf_image *image, const char *filename, struct stat *st)
+{
+	assert(image != NULL);
+	assert(filename != NULL);
+	assert(st != NULL);
+
+	int fd, ret;
+	void *data = NULL;
+
+	memset(image, 0, sizeof(struct elf_image));
+
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return errno;
+
+	if(fstat(fd, st) < 0)
+	{
+		ret = errno;
+		close(fd);
+		return ret;
+	}
+
+	if(!S_ISREG(st->st_mode) || st->st_size == 0)
+	{
+		close(fd);
+		return S_ISREG(st->st_mode) ? ENOEXEC : EBADF;
+	}
+
+	data = mmap(NULL, (size_t)st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	ret = errno;
+	close(fd);
+	if(data == MAP_FAILED)
+		return ret;
+
+	ret = load_elf_image(image, filename, data, (size_t)st->st_size);
+	image->mapping = data;
+	image->mapping_size = (size_t)st->st_size;
+
+	return ret;
+}
+
+static const unsigned char* find_note(const unsigned char *data, uint64_t size, uint64_t align, uint32_t type, const char *name, size_t *desc_size)
+{
+	size_t name_length = strlen(name) + 1;
+	uint64_t offset = 0;
+
+	align = align == 8 ? 8 : 4;
+
+	while(size - offset >= sizeof(Elf64_Nhdr))
+	{
+		Elf64_Nhdr note;
+		uint64_t name_space, desc_space;
+
+		memcpy(&note, data + offset, sizeof(note));
+		offset += sizeof(note);
+		name_space = (note.n_namesz + align - 1) / align * align;
+		desc_space = (note.n_descsz + align - 1) / align * align;
+		if(name_space > size - offset || desc_space > size - offset - name_space)
+			return NULL;
+
+		if(note.n_type == type && note.n_namesz == name_length && memcmp(data + offset, name, name_length) == 0)
+		{
+			*desc_size = note.n_descsz;
+			return data + offset + name_space;
+		}
+
+		offset += name_space + desc_space;
+	}
+
+	return NULL;
+}
+
+// descriptor of the NT_GNU_BUILD_ID note, NULL if the file has none
+const unsigned char* find_build_id(const struct elf_image *image, size_t *size)
+{
+	assert(image != NULL);
+	assert(size != NULL);
+
+	const unsigned char *build_id = NULL;
+
+	for(size_t i = 0; i < image->header.e_shnum && !build_id; i++)
+	{
+		const Elf64_Shdr *section = &image->section_headers[i];
+		const unsigned char *data = section->sh_type == SHT_NOTE ? get_section_data(image, section) : NULL;
+
+		if(data)
+			build_id = find_note(data, section->sh_size, section->sh_addralign, NT_GNU_BUILD_ID, "GNU", size);
+	}
+
+	// stripped section headers leave the note segments
+	for(size_t i = 0; i < image->header.e_phnum && !build_id; i++)
+	{
+		const Elf64_Phdr *phdr = &image->program_headers[i];
+
+		if(phdr->p_type == PT_NOTE && range_is_valid(image->size, phdr->p_offset, phdr->p_filesz))
+			build_id = find_note(image->data + phdr->p_offset, phdr->p_filesz, phdr->p_align, NT_GNU_BUILD_ID, "GNU", size);
+	}
+
+	return build_id;
+}
+
+unsigned char* get_section_data(const struct elf_image *image, const Elf64_Shdr *section)
+{
+	assert(image != NULL);
+	assert(section != NULL);
+
+	if(section->sh_type == SHT_NOBITS || !range_is_valid(image->size, section->sh_offset, section->sh_size))
+		return NULL;
+
+	return image->data + section->sh_offset;
+}
+
+// file content backing a virtual address of a load segment, size is set to
+// the number of bytes left in the segment's file image
+unsigned char* get_vaddr_data(const struct elf_image *image, uint64_t vaddr, uint64_t *size)
+{
+	assert(image != NULL);
+	assert(size != NULL);
+
+	for(size_t i = 0; i < image->header.e_phnum; i++)
+	{
+		const Elf64_Phdr *phdr = &image->program_headers[i];
+
+		if(phdr->p_type != PT_LOAD || vaddr < phdr->p_vaddr || vaddr - phdr->p_vaddr >= phdr->p_filesz)
+			continue;
+		if(!range_is_valid(image->size, phdr->p_offset, phdr->p_filesz))
+			return NULL;
+
+		*size = phdr->p_filesz - (vaddr - phdr->p_vaddr);
+		return image->data + phdr->p_offset + (vaddr - phdr->p_vaddr);
+	}
+
+	return NULL;
+}
+
+const char* get_section_name(const struct elf_image *image, const Elf64_Shdr *section)
+{
+	assert(image != NULL);
+	assert(section != NULL);
+
+	if(!image->strtab_buffer)
+		return "";
+
+	return image->strtab_buffer + section->sh_name;
+}
+
+Elf64_Shdr* find_section(const struct elf_image *image, const char *name)
+{
+	assert(image != NULL);
+	assert(name != NULL);
+
+	for(size_t i = 0; i < image->header.e_shnum; i++)
+		if(strcmp(get_section_name(image, &image->section_headers[i]), name) == 0)
+			return &image->section_headers[i];
+
+	return NULL;
+}
\ No newline at end of file
@@ -0,0 +1,744 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include "misc.h"
+#include "image.h"
+#include "symbol.h"
+#include "parallel.h"
+#include "section_header.h"
+#include "isa.h"
+
+#define X86_MAX_LENGTH 15
+// regions (functions and the gaps between them) handed to one parallel job
+#define ISA_BLOCK_SIZE 64
+#define ISA_LARGEST_COUNT 10
+
+// operand bytes following an opcode
+enum {
+	OP_M = 0x01,		// modrm, with sib and displacement
+	OP_I8 = 0x02,
+	OP_I16 = 0x04,
+	OP_I32 = 0x08,
+	OP_IZ = 0x10,		// 16 or 32 bits, by operand size
+	OP_IV = 0x20,		// 16, 32 or 64 bits (mov r, imm)
+	OP_MO = 0x40,		// memory offset of the address size
+	OP_G3 = 0x80,		// immediate only with modrm.reg 0 and 1 (test)
+	OP_X = 0x100		// invalid in 64 bit mode
+};
+
+#define M OP_M
+#define I8 OP_I8
+#define IZ OP_IZ
+#define X OP_X
+#define MI8 (OP_M | OP_I8)
+#define MIZ (OP_M | OP_IZ)
+
+// one byte opcodes; prefixes and escapes are handled before the table is read
+static const uint16_t opcodes_1[256] = {
+	/* 00 */ M, M, M, M, I8, IZ, X, X, M, M, M, M, I8, IZ, X, 0,
+	/* 10 */ M, M, M, M, I8, IZ, X, X, M, M, M, M, I8, IZ, X, X,
+	/* 20 */ M, M, M, M, I8, IZ, 0, X, M, M, M, M, I8, IZ, 0, X,
+	/* 30 */ M, M, M, M, I8, IZ, 0, X, M, M, M, M, I8, IZ, 0, X,
+	/* 40 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	/* 50 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	/* 60 */ X, X, 0, M, 0, 0, 0, 0, IZ, MIZ, I8, MI8, 0, 0, 0, 0,
+	/* 70 */ I8, I8, I8, I8, I8, I8, I8, I8, I8, I8, I8, I8, I8, I8, I8, I8,
+	/* 80 */ MI8, MIZ, X, MI8, M, M, M, M, M, M, M, M, M, M, M, M,
+	/* 90 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, X, 0, 0, 0, 0, 0,
+	/* a0 */ OP_MO, OP_MO, OP_MO, OP_MO, 0, 0, 0, 0, I8, IZ, 0, 0, 0, 0, 0, 0,
+	/* b0 */ I8, I8, I8, I8, I8, I8, I8, I8, OP_IV, OP_IV, OP_IV, OP_IV, OP_IV, OP_IV, OP_IV, OP_IV,
+	/* c0 */ MI8, MI8, OP_I16, 0, 0, 0, MI8, MIZ, OP_I16 | I8, 0, OP_I16, 0, 0, I8, X, 0,
+	/* d0 */ M, M, M, M, X, X, X, 0, M, M, M, M, M, M, M, M,
+	/* e0 */ I8, I8, I8, I8, I8, I8, I8, I8, OP_I32, OP_I32, X, I8, 0, 0, 0, 0,
+	/* f0 */ 0, 0, 0, 0, 0, 0, MI8 | OP_G3, MIZ | OP_G3, 0, 0, 0, 0, 0, 0, M, M
+};
+
+// 0f xx; 0f 38 and 0f 3a are escapes to the three byte maps
+static const uint16_t opcodes_0f[256] = {
+	/* 00 */ M, M, M, M, X, 0, 0, 0, 0, 0, X, 0, X, M, 0, MI8,
+	/* 10 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, M,
+	/* 20 */ M, M, M, M, X, X, X, X, M, M, M, M, M, M, M, M,
+	/* 30 */ 0, 0, 0, 0, 0, 0, X, 0, 0, X, 0, X, X, X, X, X,
+	/* 40 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, M,
+	/* 50 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, M,
+	/* 60 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, M,
+	/* 70 */ MI8, MI8, MI8, MI8, M, M, M, 0, M, M, X, X, M, M, M, M,
+	/* 80 */ OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32, OP_I32,
+	/* 90 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, M,
+	/* a0 */ 0, 0, 0, M, MI8, M, X, X, 0, 0, 0, M, MI8, M, M, M,
+	/* b0 */ M, M, M, M, M, M, M, M, M, M, MI8, M, M, M, M, M,
+	/* c0 */ M, M, MI8, M, MI8, MI8, MI8, M, 0, 0, 0, 0, 0, 0, 0, 0,
+	/* d0 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, M,
+	/* e0 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, M,
+	/* f0 */ M, M, M, M, M, M, M, M, M, M, M, M, M, M, M, M
+};
+
+#undef M
+#undef I8
+#undef IZ
+#undef X
+#undef MI8
+#undef MIZ
+
+enum {
+	MAP_1BYTE,
+	MAP_0F,
+	MAP_0F38,
+	MAP_0F3A
+};
+
+enum {
+	ENCODING_LEGACY,
+	ENCODING_VEX,
+	ENCODING_EVEX,
+	ENCODING_XOP
+};
+
+enum {
+	ISA_BASE,
+	ISA_X87,
+	ISA_SSE,
+	ISA_AVX,
+	ISA_AVX512,
+	ISA_AMX,
+	ISA_XOP,
+	ISA_3DNOW,
+	ISA_NOP,
+	ISA_INVALID,
+	ISA_CLASS_COUNT
+};
+
+static const char * const isa_class_names[ISA_CLASS_COUNT] = {
+	"base",
+	"x87",
+	"sse/mmx",
+	"avx (vex)",
+	"avx-512 (evex)",
+	"amx",
+	"xop",
+	"3dnow",
+	"nop",
+	"invalid"
+};
+
+struct x86_instruction {
+	size_t length;
+	int isa_class;
+	bool is_zmm;			// evex with 512 bit vectors (or embedded rounding)
+};
+
+struct isa_stats {
+	uint64_t instructions[ISA_CLASS_COUNT];
+	uint64_t bytes[ISA_CLASS_COUNT];
+	uint64_t zmm_instructions;
+	uint64_t int3_bytes;
+};
+
+// a function, or the bytes between two functions (or before and after them):
+// padding, or code without a function symbol in stripped files
+struct isa_region {
+	const char *name;
+	uint64_t address;
+	const unsigned char *data;
+	uint64_t size;
+	bool is_function;
+	bool is_gap;			// padding, decoded on its own
+	uint64_t instructions;
+	uint64_t avx512_instructions;
+	uint64_t zmm_instructions;
+};
+
+struct isa_regions {
+	struct isa_region *items;
+	size_t count;
+	size_t capacity;
+};
+
+struct isa_job {
+	struct isa_region *regions;
+	size_t count;
+	struct isa_stats *function_stats;	// one per block
+	struct isa_stats *gap_stats;
+};
+
+// length of modrm, sib and displacement at data, 0 if they are cut off
+static size_t get_modrm_length(const unsigned char *data, size_t size)
+{
+	unsigned int mod, rm;
+	size_t length = 1;
+
+	if(size < 1)
+		return 0;
+
+	mod = data[0] >> 6;
+	rm = data[0] & 7;
+
+	if(mod != 3)
+	{
+		if(rm == 4)
+		{
+			if(size < 2)
+				return 0;
+			length++;
+			if(mod == 0 && (data[1] & 7) == 5)
+				length += 4;
+		}
+
+		if(mod == 1)
+			length += 1;
+		else if(mod == 2)
+			length += 4;
+		else if(rm == 5)
+			length += 4;	// rip relative
+	}
+
+	return length <= size ? length : 0;
+}
+
+static int get_legacy_class(int map, uint8_t opcode, uint8_t modrm, bool has_rex_b, bool has_rep)
+{
+	if(map == MAP_1BYTE)
+	{
+		if(opcode == 0x90 && !has_rex_b && !has_rep)
+			return ISA_NOP;
+		if((opcode >= 0xd8 && opcode <= 0xdf) || opcode == 0x9b)
+			return ISA_X87;
+		return ISA_BASE;
+	}
+
+	if(map == MAP_0F)
+	{
+		if(opcode == 0x1f && ((modrm >> 3) & 7) == 0)
+			return ISA_NOP;
+		if(opcode == 0x0f || opcode == 0x0e)
+			return ISA_3DNOW;
+		if((opcode >= 0x10 && opcode <= 0x17) || (opcode >= 0x28 && opcode <= 0x2f) ||
+			(opcode >= 0x50 && opcode <= 0x77) || (opcode >= 0x7c && opcode <= 0x7f) ||
+			opcode == 0xc2 || (opcode >= 0xc4 && opcode <= 0xc6) || (opcode >= 0xd0 && opcode <= 0xfe))
+			return ISA_SSE;
+		return ISA_BASE;
+	}
+
+	// movbe, crc32, adcx/adox and the bmi-like ones are general purpose
+	if(map == MAP_0F38 && opcode >= 0xf0)
+		return ISA_BASE;
+
+	return ISA_SSE;
+}
+
+/*
+ * decodes the length and isa class of the 64 bit mode instruction at data.
+ * undecodable bytes are one invalid instruction of length 1, so the caller
+ * always makes progress
+ */
+static void decode_x86_instruction(const unsigned char *data, size_t size, struct x86_instruction *insn)
+{
+	const unsigned char *pos = data;
+	const unsigned char *end = data + (size < X86_MAX_LENGTH ? size : X86_MAX_LENGTH);
+	bool has_opsize = false, has_addrsize = false, has_rep = false;
+	uint8_t rex = 0, opcode, modrm = 0;
+	uint16_t operands;
+	int map = MAP_1BYTE, encoding = ENCODING_LEGACY;
+	unsigned int vector_length = 0;
+	bool has_broadcast = false;
+	size_t length;
+
+	insn->length = 1;
+	insn->isa_class = ISA_INVALID;
+	insn->is_zmm = false;
+
+	// legacy prefixes, then at most one rex right before the opcode
+	for(; pos < end; pos++)
+	{
+		if(*pos == 0x66)
+			has_opsize = true;
+		else if(*pos == 0x67)
+			has_addrsize = true;
+		else if(*pos == 0xf2 || *pos == 0xf3)
+			has_rep = true;
+		else if(*pos != 0xf0 && *pos != 0x2e && *pos != 0x36 && *pos != 0x3e &&
+			*pos != 0x26 && *pos != 0x64 && *pos != 0x65)
+			break;
+	}
+	if(pos < end && (*pos & 0xf0) == 0x40)
+		rex = *pos++;
+	if(pos >= end)
+		return;
+
+	opcode = *pos++;
+
+	if(opcode == 0xc4 || opcode == 0xc5 || opcode == 0x62 || (opcode == 0x8f && pos < end && (*pos & 0x38) != 0))
+	{
+		size_t payload = opcode == 0xc5 ? 1 : opcode == 0x62 ? 3 : 2;
+
+		if(rex || (size_t)(end - pos) < payload + 2)
+			return;
+
+		if(opcode == 0xc5)
+			map = MAP_0F;
+		else
+			map = (pos[0] & (opcode == 0x62 ? 0x07 : 0x1f)) + MAP_1BYTE;
+		encoding = opcode == 0xc4 || opcode == 0xc5 ? ENCODING_VEX : opcode == 0x62 ? ENCODING_EVEX : ENCODING_XOP;
+		if(encoding == ENCODING_EVEX)
+		{
+			vector_length = (pos[2] >> 5) & 3;
+			has_broadcast = (pos[2] & 0x10) != 0;
+		}
+
+		pos += payload;
+		opcode = *pos++;
+
+		if(encoding == ENCODING_XOP)
+		{
+			// maps 8, 9 and 0xa: imm8, nothing, imm32
+			operands = OP_M | (map == 8 ? OP_I8 : map == 10 ? OP_I32 : 0);
+			if(map < 8 || map > 10)
+				return;
+		}
+		else if(map == MAP_0F)
+			operands = opcode == 0x77 && encoding == ENCODING_VEX ? 0 : (opcodes_0f[opcode] & OP_I8) | OP_M;
+		else if(map == MAP_0F3A)
+			operands = OP_M | OP_I8;
+		else if(map == MAP_0F38 || (encoding == ENCODING_EVEX && (map == 5 || map == 6)))
+			operands = OP_M;
+		else
+			return;
+	}
+	else if(opcode == 0x0f)
+	{
+		if(pos >= end)
+			return;
+
+		opcode = *pos++;
+		if(opcode == 0x38 || opcode == 0x3a)
+		{
+			map = opcode == 0x38 ? MAP_0F38 : MAP_0F3A;
+			if(pos >= end)
+				return;
+			opcode = *pos++;
+			operands = OP_M | (map == MAP_0F3A ? OP_I8 : 0);
+		}
+		else
+		{
+			map = MAP_0F;
+			operands = opcodes_0f[opcode];
+		}
+	}
+	else
+		operands = opcodes_1[opcode];
+
+	if(operands & OP_X)
+		return;
+
+	if(operands & OP_M)
+	{
+		length = get_modrm_length(pos, (size_t)(end - pos));
+		if(length == 0)
+			return;
+		modrm = *pos;
+		pos += length;
+	}
+
+	length = 0;
+	if((operands & OP_G3) && ((modrm >> 3) & 7) > 1)
+		operands &= (uint16_t)~(OP_I8 | OP_IZ);
+	if(operands & OP_I8)
+		length += 1;
+	if(operands & OP_I16)
+		length += 2;
+	if(operands & OP_I32)
+		length += 4;
+	if(operands & OP_IZ)
+		length += has_opsize ? 2 : 4;
+	if(operands & OP_IV)
+		length += rex & 0x08 ? 8 : has_opsize ? 2 : 4;
+	if(operands & OP_MO)
+		length += has_addrsize ? 4 : 8;
+	if(length > (size_t)(end - pos))
+		return;
+
+	insn->length = (size_t)(pos - data) + length;
+
+	// with a register operand evex.b selects rounding, which implies 512 bits
+	if(encoding == ENCODING_EVEX)
+	{
+		insn->isa_class = ISA_AVX512;
+		insn->is_zmm = vector_length == 2 || (has_broadcast && (modrm >> 6) == 3);
+	}
+	else if(encoding == ENCODING_XOP)
+		insn->isa_class = ISA_XOP;
+	else if(encoding == ENCODING_VEX)
+		insn->isa_class = map == MAP_0F38 && (opcode == 0x49 || opcode == 0x4b || opcode == 0x5c || opcode == 0x5e) ? ISA_AMX : ISA_AVX;
+	else
+		insn->isa_class = get_legacy_class(map, opcode, modrm, rex & 0x01, has_rep);
+}
+
+static void decode_region(struct isa_region *region, struct isa_stats *stats)
+{
+	struct x86_instruction insn;
+
+	for(uint64_t offset = 0; offset < region->size; offset += insn.length)
+	{
+		decode_x86_instruction(region->data + offset, (size_t)(region->size - offset), &insn);
+
+		stats->instructions[insn.isa_class]++;
+		stats->bytes[insn.isa_class] += insn.length;
+		region->instructions++;
+
+		if(insn.isa_class == ISA_AVX512)
+			region->avx512_instructions++;
+		if(insn.is_zmm)
+		{
+			stats->zmm_instructions++;
+			region->zmm_instructions++;
+		}
+		if(region->is_gap && region->data[offset] == 0xcc)
+			stats->int3_bytes++;
+	}
+}
+
+static void decode_block(size_t index, void *arg)
+{
+	struct isa_job *job = arg;
+	size_t end = (index + 1) * ISA_BLOCK_SIZE;
+
+	if(end > job->count)
+		end = job->count;
+
+	for(size_t i = index * ISA_BLOCK_SIZE; i < end; i++)
+	{
+		struct isa_region *region = &job->regions[i];
+
+		decode_region(region, region->is_gap ? &job->gap_stats[index] : &job->function_stats[index]);
+	}
+}
+
+static int compare_functions(const void *a, const void *b)
+{
+	const struct isa_region *x = a, *y = b;
+
+	if(x->address != y->address)
+		return x->address < y->address ? -1 : 1;
+	// of aliases the biggest one is kept
+	return x->size > y->size ? -1 : x->size < y->size;
+}
+
+static int compare_sizes(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int compare_largest(const void *a, const void *b)
+{
+	const struct isa_region *x = *(const struct isa_region * const *)a;
+	const struct isa_region *y = *(const struct isa_region * const *)b;
+
+	return x->size > y->size ? -1 : x->size < y->size;
+}
+
+static void add_region(struct isa_regions *regions, const struct isa_region *region)
+{
+	if(regions->count == regions->capacity)
+	{
+		regions->capacity = regions->capacity ? regions->capacity * 2 : 256;
+		regions->items = realloc_wrap(regions->items, sizeof(struct isa_region) * regions->capacity);
+	}
+	regions->items[regions->count++] = *region;
+}
+
+/*
+ * splits an executable section into its functions, by symbol bounds, and
+ * the gaps between them; sections without function symbols are one region
+ */
+static void add_section_regions(const struct elf_image *image, size_t index, const struct symbol_table *symbols, struct isa_regions *regions)
+{
+	const Elf64_Shdr *section = &image->section_headers[index];
+	const unsigned char *data = get_section_data(image, section);
+	struct isa_regions sorted = {NULL, 0, 0};
+	struct isa_region *functions = NULL;
+	size_t function_count = 0;
+	uint64_t address = section->sh_addr, end = section->sh_addr + section->sh_size;
+
+	if(!data)
+		return;
+
+	for(size_t i = 0; symbols && i < symbols->count; i++)
+	{
+		const Elf64_Sym *symbol = &symbols->symbols[i];
+		unsigned int type = ELF64_ST_TYPE(symbol->st_info);
+		struct isa_region function;
+
+		if((type != STT_FUNC && type != STT_GNU_IFUNC) || symbol->st_shndx != index || symbol->st_size == 0)
+			continue;
+		if(symbol->st_value < address || symbol->st_value >= end)
+			continue;
+
+		memset(&function, 0, sizeof(function));
+		function.is_function = true;
+		function.name = get_symbol_name(symbols, symbol);
+		function.address = symbol->st_value;
+		function.size = symbol->st_size < end - symbol->st_value ? symbol->st_size : end - symbol->st_value;
+		add_region(&sorted, &function);
+	}
+
+	functions = sorted.items;
+	function_count = sorted.count;
+
+	if(function_count > 0)
+		qsort(functions, function_count, sizeof(struct isa_region), compare_functions);
+
+	for(size_t i = 0; i <= function_count; i++)
+	{
+		uint64_t next = i < function_count ? functions[i].address : end;
+		struct isa_region region;
+
+		if(i < function_count && functions[i].address < address)
+			continue;	// alias or overlap of the previous function
+
+		if(next > address)
+		{
+			memset(&region, 0, sizeof(region));
+			region.name = get_section_name(image, section);
+			region.address = address;
+			region.data = data + (address - section->sh_addr);
+			region.size = next - address;
+			region.is_gap = function_count > 0;
+			add_region(regions, &region);
+		}
+
+		if(i == function_count)
+			break;
+
+		region = functions[i];
+		// a function reaching into the next one ends where that one starts
+		for(size_t j = i + 1; j < function_count; j++)
+		{
+			if(functions[j].address > region.address)
+			{
+				if(functions[j].address - region.address < region.size)
+					region.size = functions[j].address - region.address;
+				break;
+			}
+		}
+		region.data = data + (region.address - section->sh_addr);
+		add_region(regions, &region);
+		address = region.address + region.size;
+	}
+
+	free(functions);
+}
+
+static void sum_stats(struct isa_stats *total, const struct isa_stats *stats, size_t count)
+{
+	memset(total, 0, sizeof(struct isa_stats));
+
+	for(size_t i = 0; i < count; i++)
+	{
+		for(size_t j = 0; j < ISA_CLASS_COUNT; j++)
+		{
+			total->instructions[j] += stats[i].instructions[j];
+			total->bytes[j] += stats[i].bytes[j];
+		}
+		total->zmm_instructions += stats[i].zmm_instructions;
+		total->int3_bytes += stats[i].int3_bytes;
+	}
+}
+
+static void print_isa_classes(const struct isa_stats *functions, const struct isa_stats *gaps)
+{
+	uint64_t instructions = 0, bytes = 0;
+
+	for(size_t i = 0; i < ISA_CLASS_COUNT; i++)
+	{
+		instructions += functions->instructions[i] + gaps->instructions[i];
+		bytes += functions->bytes[i] + gaps->bytes[i];
+	}
+
+	printf("\n  Class            Instructions   Share        Bytes   Share Outside\n");
+	for(size_t i = 0; i < ISA_CLASS_COUNT; i++)
+	{
+		uint64_t count = functions->instructions[i] + gaps->instructions[i];
+		uint64_t size = functions->bytes[i] + gaps->bytes[i];
+
+		printf("  %-16s %12lu %6.2f%% %12lu %6.2f%% %7lu\n",
+			isa_class_names[i],
+			count,
+			instructions ? 100.0 * (double)count / (double)instructions : 0.0,
+			size,
+			bytes ? 100.0 * (double)size / (double)bytes : 0.0,
+			gaps->instructions[i]);
+	}
+	printf("  %-16s %12lu %7s %12lu\n", "total", instructions, "", bytes);
+
+	if(functions->instructions[ISA_AVX512] + gaps->instructions[ISA_AVX512] > 0)
+		printf("  avx-512 with 512 bit vectors: %lu\n", functions->zmm_instructions + gaps->zmm_instructions);
+}
+
+static void print_function_sizes(struct isa_region *regions, size_t count)
+{
+	static const uint64_t limits[] = { 16, 64, 256, 1024, 4096, 16384, UINT64_MAX };
+	static const char * const labels[] = { "< 16", "< 64", "< 256", "< 1K", "< 4K", "< 16K", ">= 16K" };
+	size_t histogram[sizeof(limits) / sizeof(limits[0])] = { 0 };
+	struct isa_region **largest = NULL;
+	uint64_t *sizes = NULL, total = 0;
+	size_t function_count = 0, avx512_count = 0, zmm_count = 0;
+
+	sizes = malloc_wrap(sizeof(uint64_t) * (count + 1));
+	largest = malloc_wrap(sizeof(struct isa_region*) * (count + 1));
+
+	for(size_t i = 0; i < count; i++)
+	{
+		if(!regions[i].is_function)
+			continue;
+
+		largest[function_count] = &regions[i];
+		sizes[function_count++] = regions[i].size;
+		total += regions[i].size;
+		avx512_count += regions[i].avx512_instructions > 0;
+		zmm_count += regions[i].zmm_instructions > 0;
+
+		for(size_t j = 0; j < sizeof(limits) / sizeof(limits[0]); j++)
+		{
+			if(regions[i].size < limits[j] || limits[j] == UINT64_MAX)
+			{
+				histogram[j]++;
+				break;
+			}
+		}
+	}
+
+	if(function_count == 0)
+	{
+		printf("\n  No function symbols, sections were decoded as a whole.\n");
+		free(sizes);
+		free(largest);
+		return;
+	}
+
+	qsort(sizes, function_count, sizeof(uint64_t), compare_sizes);
+	qsort(largest, function_count, sizeof(struct isa_region*), compare_largest);
+
+	printf("\n  Functions: %zu, %lu bytes; size min %lu, median %lu, mean %.1f, max %lu\n",
+		function_count, total, sizes[0], sizes[function_count / 2], (double)total / (double)function_count, sizes[function_count - 1]);
+	printf("  Functions using avx-512: %zu (%zu with 512 bit vectors)\n", avx512_count, zmm_count);
+
+	printf("\n  Size       Functions\n");
+	for(size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); i++)
+		printf("  %-8s %11zu\n", labels[i], histogram[i]);
+
+	printf("\n  Largest functions:\n");
+	printf("  Address            Size     Instructions AVX-512 Name\n");
+	for(size_t i = 0; i < function_count && i < ISA_LARGEST_COUNT; i++)
+		printf("  0x%016lx %-8lu %12lu %7lu %s\n",
+			largest[i]->address, largest[i]->size, largest[i]->instructions, largest[i]->avx512_instructions, largest[i]->name);
+
+	free(sizes);
+	free(largest);
+}
+
+void print_isa_stats(const char *filename)
+{
+	if(!filename)
+		error(EXIT_FAILURE, EINVAL, "you did not provide input file");
+
+	struct elf_image image;
+	struct symbol_table symbols;
+	const Elf64_Shdr *symbol_section = NULL;
+	struct isa_regions regions = {NULL, 0, 0};
+	struct isa_job job;
+	struct isa_stats function_stats, gap_stats;
+	size_t block_count, section_count = 0;
+	uint64_t code_bytes = 0, gap_bytes = 0;
+	bool has_symbols = false;
+	uint64_t start;
+	double elapsed;
+	int ret;
+
+	ret = open_elf_image(&image, filename);
+	if(ret != 0)
+	{
+		error(0, ret, "\'%s\' is not a valid elf file", filename);
+		free_elf_image(&image);
+		return;
+	}
+
+	if(image.header.e_machine != EM_X86_64 || image.elf_class != ELFCLASS64)
+	{
+		error(0, ENOTSUP, "\'%s\' is not an x86-64 file", filename);
+		free_elf_image(&image);
+		return;
+	}
+
+	symbol_section = find_symbol_section(&image);
+	if(symbol_section && load_symbol_table(&image, symbol_section, &symbols) == 0)
+		has_symbols = true;
+
+	printf("Instruction mix of \'%s\':\n  Sections:", filename);
+	for(size_t i = 0; i < image.header.e_shnum; i++)
+	{
+		const Elf64_Shdr *section = &image.section_headers[i];
+		char *flags = NULL;
+		bool is_code;
+
+		if(section->sh_type == SHT_NOBITS)
+			continue;
+
+		flags = get_section_header_flags(section->sh_flags);
+		is_code = strchr(flags, 'X') != NULL;
+		free(flags);
+		if(!is_code)
+			continue;
+
+		printf(" %s", get_section_name(&image, section));
+		add_section_regions(&image, i, has_symbols ? &symbols : NULL, &regions);
+		code_bytes += section->sh_size;
+		section_count++;
+	}
+	printf("%s (%lu bytes)\n", section_count ? "" : " none", code_bytes);
+
+	block_count = (regions.count + ISA_BLOCK_SIZE - 1) / ISA_BLOCK_SIZE;
+	job.regions = regions.items;
+	job.count = regions.count;
+	job.function_stats = calloc(block_count + 1, sizeof(struct isa_stats));
+	job.gap_stats = calloc(block_count + 1, sizeof(struct isa_stats));
+	if(!job.function_stats || !job.gap_stats)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	start = get_time_ns();
+	parallel_for(block_count, decode_block, &job);
+	elapsed = (double)(get_time_ns() - start) / 1e9;
+
+	sum_stats(&function_stats, job.function_stats, block_count);
+	sum_stats(&gap_stats, job.gap_stats, block_count);
+	for(size_t i = 0; i < regions.count; i++)
+		if(regions.items[i].is_gap)
+			gap_bytes += regions.items[i].size;
+
+	print_isa_classes(&function_stats, &gap_stats);
+	printf("\n  NOP bytes: %lu (%.2f%% of code), %lu of them outside functions\n",
+		function_stats.bytes[ISA_NOP] + gap_stats.bytes[ISA_NOP],
+		code_bytes ? 100.0 * (double)(function_stats.bytes[ISA_NOP] + gap_stats.bytes[ISA_NOP]) / (double)code_bytes : 0.0,
+		gap_stats.bytes[ISA_NOP]);
+	printf("  Bytes outside functions: %lu (%lu nop, %lu int3)\n", gap_bytes, gap_stats.bytes[ISA_NOP], gap_stats.int3_bytes);
+
+	print_function_sizes(regions.items, regions.count);
+
+	printf("\n  Decoded %lu bytes in %.3f ms, %.1f MB/s on %zu threads\n",
+		code_bytes, elapsed * 1e3, elapsed > 0 ? (double)code_bytes / elapsed / 1e6 : 0.0, get_thread_count());
+
+	free(job.function_stats);
+	free(job.gap_stats);
+	free(regions.items);
+	if(has_symbols)
+		free_symbol_table(&symbols);
+	free_elf_image(&image);
+}
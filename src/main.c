@@ -6,29 +6,124 @@
 #include <stdbool.h>
 #include <errno.h>
 #include <error.h>
+#include <stdint.h>
 #include <elf.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "misc.h"
 #include "elf_header.h"
 #include "program_header.h"
 #include "section_header.h"
+#include "process.h"
+#include "stream.h"
+#include "archive.h"
+#include "image.h"
+#include "compressed.h"
+#include "search.h"
+#include "entropy.h"
+#include "debug_line.h"
+#include "eh_frame.h"
+#include "extract.h"
+#include "watch.h"
+#include "serve.h"
+#include "symbol.h"
+#include "query.h"
+#include "demangle.h"
+#include "startup.h"
+#include "version.h"
+#include "isa.h"
+#include "columns.h"
+#include "core.h"
+#include "validate.h"
 
-static void print_elf_header(const char *filename)
+enum {
+	OPT_PID = 256,
+	OPT_ARMAP,
+	OPT_COMPRESSED,
+	OPT_SEARCH,
+	OPT_IN,
+	OPT_ENTROPY,
+	OPT_ADDR2LINE,
+	OPT_EH_FRAME,
+	OPT_EXTRACT,
+	OPT_KEEP,
+	OPT_OUTPUT,
+	OPT_WATCH,
+	OPT_JSON,
+	OPT_SERVE,
+	OPT_CLIENT,
+	OPT_LOAD,
+	OPT_WHERE,
+	OPT_DEMANGLE,
+	OPT_CORE,
+	OPT_STARTUP,
+	OPT_VERSIONS,
+	OPT_CHECK_VERSIONS,
+	OPT_ISA,
+	OPT_COLUMNS
+};
+
+/*
+ * class of filename if its elf header can be read, 0 (after saying why)
+ * otherwise; the tables are then checked once by the validate functions,
+ * so the readers and printers below need no checks of their own
+ */
+static int get_valid_elf_class(const char *filename, uint64_t *file_size)
 {
-	if(!filename)
-		error(EXIT_FAILURE, EINVAL, "you did not provide input file");
+	struct stat statbuf;
+	int elf_class;
 
-	int is_elf, elf_class;
-	Elf32_Ehdr *elf32_header = NULL;
-	Elf64_Ehdr *elf64_header = NULL;
+	if(stat(filename, &statbuf) < 0)
+		error(EXIT_FAILURE, errno, "cannot access file \'%s\'", filename);
+	*file_size = (uint64_t)statbuf.st_size;
 
-	is_elf = is_elf_file(filename);
-	if(is_elf != 0)
+	if(S_ISREG(statbuf.st_mode) && *file_size < EI_NIDENT)
 	{
 		error(0, ENOEXEC, "\'%s\' is not executable file", filename);
-		return;
+		return 0;
+	}
+
+	if(is_elf_file(filename) != 0)
+	{
+		error(0, ENOEXEC, "\'%s\' is not executable file", filename);
+		return 0;
 	}
 
 	elf_class = get_elf_class(filename);
+	if(elf_class != ELFCLASS32 && elf_class != ELFCLASS64)
+	{
+		error(0, EBADF, "unknown elf file class");
+		return 0;
+	}
+
+	if(*file_size < (elf_class == ELFCLASS32 ? sizeof(Elf32_Ehdr) : sizeof(Elf64_Ehdr)))
+	{
+		error(0, EBADF, "\'%s\': file is too short for an elf header", filename);
+		return 0;
+	}
+
+	return elf_class;
+}
+
+static bool is_valid_elf(const char *filename, const char *problem)
+{
+	if(problem)
+		error(0, EBADF, "\'%s\': %s", filename, problem);
+
+	return problem == NULL;
+}
+
+static void print_elf_header(const char *filename)
+{
+	if(!filename)
+		error(EXIT_FAILURE, EINVAL, "you did not provide input file");
+
+	int elf_class;
+	uint64_t file_size;
+	Elf32_Ehdr *elf32_header = NULL;
+	Elf64_Ehdr *elf64_header = NULL;
+
+	elf_class = get_valid_elf_class(filename, &file_size);
 	if(elf_class == ELFCLASS32)
 	{
 		elf32_header = read_elf32_header(filename);
@@ -41,8 +136,6 @@ static void print_elf_header(const char *filename)
 		print_elf64_header(elf64_header);
 		free(elf64_header);
 	}
-	else
-		error(0, EBADF, "unknown elf file class");
 }
 
 static void print_program_header(const char *filename)
@@ -50,25 +143,22 @@ static void print_program_header(const char *filename)
 	if(!filename)
 		error(EXIT_FAILURE, EINVAL, "you did not provide input file");
 
-	int is_elf, elf_class;
+	int elf_class;
+	uint64_t file_size;
 	Elf32_Ehdr *elf32_header = NULL;
 	Elf64_Ehdr *elf64_header = NULL;
 	Elf32_Phdr *program32_headers = NULL;
 	Elf64_Phdr *program64_headers = NULL;
 
-	is_elf = is_elf_file(filename);
-	if(is_elf != 0)
-	{
-		error(0, ENOEXEC, "\'%s\' is not executable file", filename);
-		return;
-	}
-
-	elf_class = get_elf_class(filename);
+	elf_class = get_valid_elf_class(filename, &file_size);
 	if(elf_class == ELFCLASS32)
 	{
 		elf32_header = read_elf32_header(filename);
-		program32_headers = read_program32_headers(filename, elf32_header);
-		print_program32_headers(program32_headers, elf32_header);
+		if(is_valid_elf(filename, validate_elf32_header(elf32_header, file_size, VALIDATE_SEGMENTS)))
+		{
+			program32_headers = read_program32_headers(filename, elf32_header);
+			print_program32_headers(program32_headers, elf32_header);
+		}
 
 		free(program32_headers);
 		free(elf32_header);
@@ -76,14 +166,15 @@ static void print_program_header(const char *filename)
 	else if(elf_class == ELFCLASS64)
 	{
 		elf64_header = read_elf64_header(filename);
-		program64_headers = read_program64_headers(filename, elf64_header);
-		print_program64_headers(program64_headers, elf64_header);
+		if(is_valid_elf(filename, validate_elf64_header(elf64_header, file_size, VALIDATE_SEGMENTS)))
+		{
+			program64_headers = read_program64_headers(filename, elf64_header);
+			print_program64_headers(program64_headers, elf64_header);
+		}
 
 		free(program64_headers);
 		free(elf64_header);
 	}
-	else
-		error(0, EBADF, "unknown elf file class");
 }
 
 static void print_section_header(const char *filename)
@@ -91,28 +182,27 @@ static void print_section_header(const char *filename)
 	if(!filename)
 		error(EXIT_FAILURE, EINVAL, "you did not provide input file");
 
-	int is_elf, elf_class;
+	int elf_class;
+	uint64_t file_size;
 	char *section_strtab_buffer = NULL;
 	Elf32_Ehdr *elf32_header = NULL;
 	Elf64_Ehdr *elf64_header = NULL;
 	Elf32_Shdr *section32_headers = NULL;
 	Elf64_Shdr *section64_headers = NULL;
 
-	is_elf = is_elf_file(filename);
-	if(is_elf != 0)
-	{
-		error(0, ENOEXEC, "\'%s\' is not executable file", filename);
-		return;
-	}
-
-	elf_class = get_elf_class(filename);
+	elf_class = get_valid_elf_class(filename, &file_size);
 	if(elf_class == ELFCLASS32)
 	{
 		elf32_header = read_elf32_header(filename);
-		section32_headers = read_section32_headers(filename, elf32_header);
-		section_strtab_buffer = read_section32_string_table(filename, elf32_header, section32_headers);
-
-		print_section32_headers(section32_headers, elf32_header, section_strtab_buffer);
+		if(is_valid_elf(filename, validate_elf32_header(elf32_header, file_size, VALIDATE_SECTIONS)))
+		{
+			section32_headers = read_section32_headers(filename, elf32_header);
+			if(is_valid_elf(filename, validate_section32_headers(section32_headers, elf32_header, file_size)))
+			{
+				section_strtab_buffer = read_section32_string_table(filename, elf32_header, section32_headers);
+				print_section32_headers(section32_headers, elf32_header, section_strtab_buffer);
+			}
+		}
 
 		free(elf32_header);
 		free(section32_headers);
@@ -121,50 +211,76 @@ static void print_section_header(const char *filename)
 	else if(elf_class == ELFCLASS64)
 	{
 		elf64_header = read_elf64_header(filename);
-		section64_headers = read_section64_headers(filename, elf64_header);
-		section_strtab_buffer = read_section64_string_table(filename, elf64_header, section64_headers);
-
-		print_section64_headers(section64_headers, elf64_header, section_strtab_buffer);
+		if(is_valid_elf(filename, validate_elf64_header(elf64_header, file_size, VALIDATE_SECTIONS)))
+		{
+			section64_headers = read_section64_headers(filename, elf64_header);
+			if(is_valid_elf(filename, validate_section64_headers(section64_headers, elf64_header, file_size)))
+			{
+				section_strtab_buffer = read_section64_string_table(filename, elf64_header, section64_headers);
+				print_section64_headers(section64_headers, elf64_header, section_strtab_buffer);
+			}
+		}
 
 		free(elf64_header);
 		free(section64_headers);
 		free(section_strtab_buffer);
 	}
-	else
-		error(0, EBADF, "unknown elf file class");
 }
 
-/*static void print_symbol_table(const char *filename)
+static char** get_input_files(char *input_file, char **files, size_t file_count, size_t *count)
 {
-	if(!filename)
+	char **filenames = NULL;
+
+	filenames = malloc_wrap(sizeof(char*) * (file_count + 1));
+	*count = 0;
+
+	if(input_file)
+		filenames[(*count)++] = input_file;
+	for(size_t i = 0; i < file_count; i++)
+		filenames[(*count)++] = files[i];
+
+	if(*count == 0)
 		error(EXIT_FAILURE, EINVAL, "you did not provide input file");
 
-	int is_elf, elf_class;
-	char *section_strtab_buffer = NULL;
-	Elf32_Ehdr *elf32_header = NULL;
-	Elf64_Ehdr *elf64_header = NULL;
-	Elf32_Shdr *section32_headers = NULL;
-	Elf64_Shdr *section64_headers = NULL;
+	return filenames;
+}
 
-	is_elf = is_elf_file(filename);
-	if(is_elf != 0)
-	{
-		error(0, ENOEXEC, "\'%s\' is not executable file", filename);
-		return;
-	}
+static void search_input_files(char *input_file, char **files, size_t file_count, char **patterns, size_t pattern_count, const char *selector)
+{
+	char **filenames = NULL;
+	size_t count;
 
-	elf_class = get_elf_class(filename);
-	if(elf_class == ELFCLASS32)
-	{
+	filenames = get_input_files(input_file, files, file_count, &count);
+	search_files(filenames, count, patterns, pattern_count, selector);
+	free(filenames);
+}
 
-	}
-	else if(elf_class == ELFCLASS64)
-	{
+static pid_t parse_pid(const char *str)
+{
+	char *end = NULL;
+	long value;
 
-	}
-	else
-		error(0, EBADF, "unknown elf file class");
-}*/
+	errno = 0;
+	value = strtol(str, &end, 10);
+	if(errno != 0 || end == str || *end != '\0' || value <= 0 || value > INT32_MAX)
+		error(EXIT_FAILURE, EINVAL, "invalid process id '%s'", str);
+
+	return (pid_t)value;
+}
+
+// every --load connection is a client thread, so their count is kept sane
+static size_t parse_connections(const char *str)
+{
+	char *end = NULL;
+	long value;
+
+	errno = 0;
+	value = strtol(str, &end, 10);
+	if(errno != 0 || end == str || *end != '\0' || value <= 0 || value > 4096)
+		error(EXIT_FAILURE, EINVAL, "invalid connection count '%s' (1 to 4096)", str);
+
+	return (size_t)value;
+}
 
 int main(int argc, char **argv)
 {
@@ -172,11 +288,66 @@ int main(int argc, char **argv)
 	bool is_elf_header = false;
 	bool is_program_header = false;
 	bool is_section_header = false;
-	//bool is_symbol_table = false;
+	bool is_compressed = false;
+	bool is_entropy = false;
+	bool is_addr2line = false;
+	bool is_eh_frame = false;
+	bool is_json = false;
+	bool is_symbol_table = false;
+	bool is_demangle = false;
+	bool is_core = false;
+	bool is_demangle_stats = false;
+	bool is_startup = false;
+	bool is_startup_closure = false;
+	bool is_versions = false;
+	bool is_check_versions = false;
+	bool is_isa = false;
 	char *input_file = NULL;
-	const char * const shortopts = "vhaepsf:";	// S
+	char *armap_symbol = NULL;
+	char *section_selector = NULL;
+	char *extract_selector = NULL;
+	char *keep_selector = NULL;
+	char *output = NULL;
+	char *watch_dir = NULL;
+	char *where = NULL;
+	char *columns_output = NULL;
+	struct demangler *demangler = NULL;
+	char *serve_socket = NULL;
+	char *client_socket = NULL;
+	size_t load_connections = 0;
+	char **patterns = NULL;
+	size_t pattern_count = 0;
+	pid_t pid = 0;
+	const char * const shortopts = "vhaepsSf:";
+	const struct option longopts[] = {
+		{"pid", required_argument, NULL, OPT_PID},
+		{"armap", required_argument, NULL, OPT_ARMAP},
+		{"compressed", no_argument, NULL, OPT_COMPRESSED},
+		{"search", required_argument, NULL, OPT_SEARCH},
+		{"in", required_argument, NULL, OPT_IN},
+		{"entropy", no_argument, NULL, OPT_ENTROPY},
+		{"addr2line", no_argument, NULL, OPT_ADDR2LINE},
+		{"eh-frame", no_argument, NULL, OPT_EH_FRAME},
+		{"extract", required_argument, NULL, OPT_EXTRACT},
+		{"keep", required_argument, NULL, OPT_KEEP},
+		{"output", required_argument, NULL, OPT_OUTPUT},
+		{"watch", required_argument, NULL, OPT_WATCH},
+		{"json", no_argument, NULL, OPT_JSON},
+		{"serve", required_argument, NULL, OPT_SERVE},
+		{"client", required_argument, NULL, OPT_CLIENT},
+		{"load", required_argument, NULL, OPT_LOAD},
+		{"where", required_argument, NULL, OPT_WHERE},
+		{"demangle", optional_argument, NULL, OPT_DEMANGLE},
+		{"core", no_argument, NULL, OPT_CORE},
+		{"startup", optional_argument, NULL, OPT_STARTUP},
+		{"versions", no_argument, NULL, OPT_VERSIONS},
+		{"check-versions", no_argument, NULL, OPT_CHECK_VERSIONS},
+		{"isa", no_argument, NULL, OPT_ISA},
+		{"columns", required_argument, NULL, OPT_COLUMNS},
+		{NULL, 0, NULL, 0}
+	};
 
-	while((result = getopt(argc, argv, shortopts)) != -1)
+	while((result = getopt_long(argc, argv, shortopts, longopts, NULL)) != -1)
 	{
 		switch(result) {
 		case 'v':
@@ -188,8 +359,8 @@ int main(int argc, char **argv)
 		case 'a':
 			is_elf_header =
 			is_program_header =
-			is_section_header = true;
-			//is_symbol_table = true;
+			is_section_header =
+			is_symbol_table = true;
 			break;
 		case 'e':
 			is_elf_header = true;
@@ -200,23 +371,289 @@ int main(int argc, char **argv)
 		case 's':
 			is_section_header = true;
 			break;
-		/*case 'S':
+		case 'S':
 			is_symbol_table = true;
-			break;*/
+			break;
 		case 'f':
 			input_file = strdup(optarg);
 			break;
+		case OPT_PID:
+			pid = parse_pid(optarg);
+			break;
+		case OPT_ARMAP:
+			armap_symbol = optarg;
+			break;
+		case OPT_COMPRESSED:
+			is_compressed = true;
+			break;
+		case OPT_SEARCH:
+			patterns = realloc_wrap(patterns, sizeof(char*) * (pattern_count + 1));
+			patterns[pattern_count++] = optarg;
+			break;
+		case OPT_IN:
+			section_selector = optarg;
+			break;
+		case OPT_ENTROPY:
+			is_entropy = true;
+			break;
+		case OPT_ADDR2LINE:
+			is_addr2line = true;
+			break;
+		case OPT_EH_FRAME:
+			is_eh_frame = true;
+			break;
+		case OPT_EXTRACT:
+			extract_selector = optarg;
+			break;
+		case OPT_KEEP:
+			keep_selector = optarg;
+			break;
+		case OPT_OUTPUT:
+			output = optarg;
+			break;
+		case OPT_WATCH:
+			watch_dir = optarg;
+			break;
+		case OPT_JSON:
+			is_json = true;
+			break;
+		case OPT_SERVE:
+			serve_socket = optarg;
+			break;
+		case OPT_CLIENT:
+			client_socket = optarg;
+			break;
+		case OPT_LOAD:
+			load_connections = parse_connections(optarg);
+			break;
+		case OPT_WHERE:
+			where = optarg;
+			break;
+		case OPT_DEMANGLE:
+			if(optarg && strcmp(optarg, "stats") != 0)
+				error(EXIT_FAILURE, EINVAL, "invalid --demangle argument \'%s\'", optarg);
+			is_demangle = true;
+			is_demangle_stats = optarg != NULL;
+			break;
+		case OPT_CORE:
+			is_core = true;
+			break;
+		case OPT_STARTUP:
+			if(optarg && strcmp(optarg, "closure") != 0)
+				error(EXIT_FAILURE, EINVAL, "invalid --startup argument \'%s\'", optarg);
+			is_startup = true;
+			is_startup_closure = optarg != NULL;
+			break;
+		case OPT_VERSIONS:
+			is_versions = true;
+			break;
+		case OPT_CHECK_VERSIONS:
+			is_check_versions = true;
+			break;
+		case OPT_ISA:
+			is_isa = true;
+			break;
+		case OPT_COLUMNS:
+			columns_output = optarg;
+			break;
+		default:
+			help();
+			exit(EXIT_FAILURE);
 		}
 	}
 
+	if(serve_socket)
+	{
+		free(input_file);
+		serve_queries(serve_socket);
+		return EXIT_SUCCESS;
+	}
+
+	if(client_socket)
+	{
+		free(input_file);
+		if(query_server(client_socket, argv + optind, (size_t)(argc - optind), load_connections) != 0)
+			return EXIT_FAILURE;
+		return EXIT_SUCCESS;
+	}
+
+	if(watch_dir)
+	{
+		free(input_file);
+		watch_directory(watch_dir, is_json);
+		return EXIT_SUCCESS;
+	}
+
+	if(pid > 0)
+	{
+		print_process_images(pid, is_elf_header, is_program_header);
+		free(input_file);
+		return EXIT_SUCCESS;
+	}
+
+	// stdin and pipes can be read only once, so everything is printed in one pass
+	if(input_file && is_stream_file(input_file))
+	{
+		if(is_symbol_table && is_demangle)
+			demangler = create_demangler();
+
+		print_stream_input(input_file, is_elf_header, is_program_header, is_section_header, is_symbol_table, demangler);
+
+		if(is_demangle_stats && demangler)
+			print_demangle_stats(demangler);
+		free_demangler(demangler);
+		free(input_file);
+		return EXIT_SUCCESS;
+	}
+
+	if(pattern_count > 0)
+	{
+		search_input_files(input_file, argv + optind, (size_t)(argc - optind), patterns, pattern_count, section_selector);
+		free(patterns);
+		free(input_file);
+		return EXIT_SUCCESS;
+	}
+
+	if(is_eh_frame)
+	{
+		char **filenames = NULL;
+		size_t count, bad_count;
+
+		filenames = get_input_files(input_file, argv + optind, (size_t)(argc - optind), &count);
+		bad_count = print_eh_frame(filenames, count);
+		free(filenames);
+		free(input_file);
+		return bad_count > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	if(extract_selector || keep_selector)
+	{
+		if(!input_file)
+			error(EXIT_FAILURE, EINVAL, "you did not provide input file");
+		if(keep_selector && !output)
+			error(EXIT_FAILURE, EINVAL, "--keep needs an --output file");
+
+		if(extract_selector)
+			extract_sections(input_file, extract_selector, keep_selector ? NULL : output);
+		if(keep_selector)
+			write_section_subset(input_file, keep_selector, output);
+
+		free(input_file);
+		return EXIT_SUCCESS;
+	}
+
+	if(where)
+	{
+		char **filenames = NULL;
+		size_t count;
+		int tables = 0;
+
+		if(is_section_header)
+			tables |= WHERE_SECTIONS;
+		if(is_program_header)
+			tables |= WHERE_SEGMENTS;
+		if(is_symbol_table)
+			tables |= WHERE_SYMBOLS;
+
+		filenames = get_input_files(input_file, argv + optind, (size_t)(argc - optind), &count);
+		if(is_demangle)
+			demangler = create_demangler();
+
+		print_where(filenames, count, where, tables, is_json, demangler);
+
+		if(is_demangle_stats)
+			print_demangle_stats(demangler);
+		free_demangler(demangler);
+		free(filenames);
+		free(input_file);
+		return EXIT_SUCCESS;
+	}
+
+	if(is_startup)
+	{
+		char **filenames = NULL;
+		size_t count;
+
+		filenames = get_input_files(input_file, argv + optind, (size_t)(argc - optind), &count);
+		print_startup(filenames, count, is_startup_closure);
+
+		free(filenames);
+		free(input_file);
+		return EXIT_SUCCESS;
+	}
+
+	if(is_check_versions)
+	{
+		char **filenames = NULL;
+		size_t count, missing_count;
+
+		filenames = get_input_files(input_file, argv + optind, (size_t)(argc - optind), &count);
+		missing_count = check_versions(filenames, count);
+		free(filenames);
+		free(input_file);
+		return missing_count > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	if(columns_output)
+	{
+		char **filenames = NULL;
+		size_t count;
+
+		filenames = get_input_files(input_file, argv + optind, (size_t)(argc - optind), &count);
+		export_columns(filenames, count, columns_output);
+
+		free(filenames);
+		free(input_file);
+		return EXIT_SUCCESS;
+	}
+
+	if(input_file && armap_symbol)
+		print_archive_symbol(input_file, armap_symbol);
+
+	if(input_file && is_archive_file(input_file))
+	{
+		if(is_symbol_table && is_demangle)
+			demangler = create_demangler();
+
+		if(is_elf_header || is_program_header || is_section_header || is_symbol_table)
+			print_archive(input_file, is_elf_header, is_program_header, is_section_header, is_symbol_table, demangler);
+
+		if(is_demangle_stats && demangler)
+			print_demangle_stats(demangler);
+		free_demangler(demangler);
+		free(input_file);
+		return EXIT_SUCCESS;
+	}
+
 	if(is_elf_header)
 		print_elf_header(input_file);
 	if(is_program_header)
 		print_program_header(input_file);
 	if(is_section_header)
 		print_section_header(input_file);
-	//if(is_symbol_table)
-	//	print_symbol_table(input_file);
+	if(is_compressed)
+		print_compressed_sections(input_file);
+	if(is_entropy)
+		print_entropy(input_file);
+	if(is_addr2line)
+		print_addr2line(input_file, stdin);
+	if(is_core)
+		print_core(input_file);
+	if(is_versions)
+		print_versions(input_file);
+	if(is_isa)
+		print_isa_stats(input_file);
+	if(is_symbol_table)
+	{
+		if(is_demangle)
+			demangler = create_demangler();
+
+		print_symbol_table(input_file, demangler);
+
+		if(is_demangle_stats)
+			print_demangle_stats(demangler);
+		free_demangler(demangler);
+	}
 
 	free(input_file);
 	return EXIT_SUCCESS;
@@ -0,0 +1,217 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#define MATCHER_SSSE3 1
+#endif
+#include "misc.h"
+#include "matcher.h"
+
+static int hex_value(char c)
+{
+	if(c >= '0' && c <= '9')
+		return c - '0';
+	if(c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if(c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+// patterns are literal, except for "\xNN" (any byte) and "\\"
+static void parse_pattern(struct pattern *pattern, const char *text)
+{
+	size_t length = 0;
+
+	pattern->text = text;
+	pattern->bytes = malloc_wrap(strlen(text) + 1);
+
+	for(const char *p = text; *p; p++)
+	{
+		if(p[0] == '\\' && p[1] == 'x' && hex_value(p[2]) >= 0 && hex_value(p[3]) >= 0)
+		{
+			pattern->bytes[length++] = (unsigned char)(hex_value(p[2]) << 4 | hex_value(p[3]));
+			p += 3;
+		}
+		else if(p[0] == '\\' && p[1] == '\\')
+		{
+			pattern->bytes[length++] = '\\';
+			p++;
+		}
+		else
+			pattern->bytes[length++] = (unsigned char)*p;
+	}
+
+	if(length == 0)
+		error(EXIT_FAILURE, EINVAL, "empty search pattern");
+
+	pattern->length = length;
+}
+
+void init_matcher(struct pattern_matcher *matcher, char **patterns, size_t count)
+{
+	assert(matcher != NULL);
+	assert(patterns != NULL);
+	assert(count > 0);
+
+	memset(matcher, 0, sizeof(struct pattern_matcher));
+
+	matcher->patterns = malloc_wrap(sizeof(struct pattern) * count);
+	matcher->count = count;
+	matcher->min_length = SIZE_MAX;
+
+	for(size_t i = 0; i < count; i++)
+	{
+		parse_pattern(&matcher->patterns[i], patterns[i]);
+
+		if(matcher->patterns[i].length < matcher->min_length)
+			matcher->min_length = matcher->patterns[i].length;
+		if(matcher->patterns[i].length > matcher->max_length)
+			matcher->max_length = matcher->patterns[i].length;
+	}
+
+	matcher->prefix_length = matcher->min_length < MATCHER_PREFIX ? matcher->min_length : MATCHER_PREFIX;
+
+	for(size_t b = 0; b < MATCHER_BUCKETS; b++)
+		matcher->buckets[b] = malloc_wrap(sizeof(size_t) * (count / MATCHER_BUCKETS + 1));
+
+	for(size_t i = 0; i < count; i++)
+	{
+		size_t b = i % MATCHER_BUCKETS;
+		uint8_t bit = (uint8_t)(1u << b);
+
+		matcher->buckets[b][matcher->bucket_sizes[b]++] = i;
+
+		for(size_t j = 0; j < matcher->prefix_length; j++)
+		{
+			unsigned char c = matcher->patterns[i].bytes[j];
+
+			matcher->lo_masks[j][c & 0xf] |= bit;
+			matcher->hi_masks[j][c >> 4] |= bit;
+		}
+	}
+}
+
+void free_matcher(struct pattern_matcher *matcher)
+{
+	assert(matcher != NULL);
+
+	for(size_t i = 0; i < matcher->count; i++)
+		free(matcher->patterns[i].bytes);
+	for(size_t b = 0; b < MATCHER_BUCKETS; b++)
+		free(matcher->buckets[b]);
+
+	free(matcher->patterns);
+	memset(matcher, 0, sizeof(struct pattern_matcher));
+}
+
+static void verify_candidate(const struct pattern_matcher *matcher, const unsigned char *data, size_t size, size_t pos, unsigned int buckets, match_func func, void *arg)
+{
+	while(buckets)
+	{
+		unsigned int b = (unsigned int)__builtin_ctz(buckets);
+
+		buckets &= buckets - 1;
+
+		for(size_t i = 0; i < matcher->bucket_sizes[b]; i++)
+		{
+			const struct pattern *pattern = &matcher->patterns[matcher->buckets[b][i]];
+
+			if(pattern->length <= size - pos && memcmp(data + pos, pattern->bytes, pattern->length) == 0)
+				func(matcher->buckets[b][i], pos, arg);
+		}
+	}
+}
+
+static void match_scalar(const struct pattern_matcher *matcher, const unsigned char *data, size_t size, size_t pos, size_t limit, match_func func, void *arg)
+{
+	for(; pos < limit && matcher->min_length <= size - pos; pos++)
+	{
+		unsigned int buckets = 0xff;
+
+		for(size_t j = 0; j < matcher->prefix_length && buckets; j++)
+		{
+			unsigned char c = data[pos + j];
+			buckets &= (unsigned int)(matcher->lo_masks[j][c & 0xf] & matcher->hi_masks[j][c >> 4]);
+		}
+
+		if(buckets)
+			verify_candidate(matcher, data, size, pos, buckets, func, arg);
+	}
+}
+
+#ifdef MATCHER_SSSE3
+__attribute__((target("ssse3")))
+static size_t match_ssse3(const struct pattern_matcher *matcher, const unsigned char *data, size_t size, size_t limit, match_func func, void *arg)
+{
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i lo[MATCHER_PREFIX], hi[MATCHER_PREFIX];
+	size_t n = matcher->prefix_length;
+	size_t pos = 0;
+
+	for(size_t j = 0; j < n; j++)
+	{
+		lo[j] = _mm_loadu_si128((const void*)matcher->lo_masks[j]);
+		hi[j] = _mm_loadu_si128((const void*)matcher->hi_masks[j]);
+	}
+
+	for(; pos < limit && size - pos >= 16 + n - 1; pos += 16)
+	{
+		__m128i result = _mm_set1_epi8(-1);
+		uint8_t buckets[16];
+		unsigned int mask;
+
+		for(size_t j = 0; j < n; j++)
+		{
+			__m128i in = _mm_loadu_si128((const void*)(data + pos + j));
+			__m128i l = _mm_shuffle_epi8(lo[j], _mm_and_si128(in, nibble));
+			__m128i h = _mm_shuffle_epi8(hi[j], _mm_and_si128(_mm_srli_epi16(in, 4), nibble));
+
+			result = _mm_and_si128(result, _mm_and_si128(l, h));
+		}
+
+		mask = ~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(result, zero)) & 0xffff;
+		if(!mask)
+			continue;
+
+		_mm_storeu_si128((void*)buckets, result);
+		while(mask)
+		{
+			unsigned int k = (unsigned int)__builtin_ctz(mask);
+
+			mask &= mask - 1;
+			if(pos + k < limit)
+				verify_candidate(matcher, data, size, pos + k, buckets[k], func, arg);
+		}
+	}
+
+	return pos;
+}
+#endif
+
+// reports every pattern occurrence that starts before limit and ends inside
+// of the data; callers scanning overlapping ranges use limit to avoid duplicates
+void match_patterns(const struct pattern_matcher *matcher, const unsigned char *data, size_t size, size_t limit, match_func func, void *arg)
+{
+	assert(matcher != NULL);
+	assert(func != NULL);
+
+	size_t pos = 0;
+
+	if(limit > size)
+		limit = size;
+
+#ifdef MATCHER_SSSE3
+	if(__builtin_cpu_supports("ssse3"))
+		pos = match_ssse3(matcher, data, size, limit, func, arg);
+#endif
+
+	match_scalar(matcher, data, size, pos, limit, func, arg);
+}
\ No newline at end of file
@@ -1,6 +1,9 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <time.h>
 #include <stdarg.h>
 #include <assert.h>
 #include <elf.h>
@@ -35,6 +38,17 @@ void* malloc_wrap(size_t size)
 	return buf;
 }
 
+void* realloc_wrap(void *ptr, size_t size)
+{
+	void *buf = NULL;
+
+	buf = realloc(ptr, size);
+	if(!buf)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	return buf;
+}
+
 size_t fread_wrap(void *buf, size_t size, size_t n, FILE *fp)
 {
 	assert(buf != NULL);
@@ -71,7 +85,22 @@ int is_elf_file(const char *filename)
 
 	fclose(fp);
 
-	return strcmp(buffer, ELFMAG);
+	return memcmp(buffer, ELFMAG, SELFMAG);
+}
+
+int is_stream_file(const char *filename)
+{
+	assert(filename != NULL);
+
+	struct stat statbuf;
+
+	if(strcmp(filename, "-") == 0)
+		return 1;
+
+	if(stat(filename, &statbuf) < 0)
+		error(EXIT_FAILURE, errno, "cannot access file '%s'", filename);
+
+	return S_ISFIFO(statbuf.st_mode) || S_ISCHR(statbuf.st_mode);
 }
 
 int get_elf_class(const char *filename)
@@ -89,17 +118,92 @@ int get_elf_class(const char *filename)
 	return buffer[EI_CLASS];
 }
 
+void print_json_string(const char *str)
+{
+	putchar('"');
+
+	for(; *str; str++)
+	{
+		if(*str == '"' || *str == '\\')
+			printf("\\%c", *str);
+		else if((unsigned char)*str < 0x20)
+			printf("\\u%04x", (unsigned char)*str);
+		else
+			putchar(*str);
+	}
+
+	putchar('"');
+}
+
+uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+	const unsigned char *bytes = data;
+
+	for(size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3;
+	}
+
+	return hash;
+}
+
+uint64_t hash_string(uint64_t hash, const char *str)
+{
+	for(; *str; str++)
+	{
+		hash ^= (unsigned char)*str;
+		hash *= 0x100000001b3;
+	}
+
+	return hash;
+}
+
+// monotonic clock, for timings and timeouts
+uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
 void help(void)
 {
-	fprintf(stdout, "usage: relf [options...]\n\n");
+	fprintf(stdout, "usage: relf [options...] [files...]\n\n");
 	fprintf(stdout, "options:\n");
 	fprintf(stdout, "\t-v        - prints program version\n");
 	fprintf(stdout, "\t-h        - prints help message\n");
-	fprintf(stdout, "\t-a        - equivalent to: -e -p -s\n");
+	fprintf(stdout, "\t-a        - equivalent to: -e -p -s -S\n");
 	fprintf(stdout, "\t-e        - prints elf header\n");
 	fprintf(stdout, "\t-p        - prints program headers\n");
 	fprintf(stdout, "\t-s        - prints section headers\n");
-	fprintf(stdout, "\t-f [file] - specifies the input executable file\n");
+	fprintf(stdout, "\t-S        - prints symbol tables\n");
+	fprintf(stdout, "\t-f [file] - specifies the input executable file (\'-\' or a pipe is read as a stream)\n");
+	fprintf(stdout, "\t--pid [pid] - prints headers of the elf images mapped by running process\n");
+	fprintf(stdout, "\t--compressed - prints compressed (SHF_COMPRESSED) sections with their sizes\n");
+	fprintf(stdout, "\t--search [pattern] - searches section contents for pattern (repeatable, \\xNN for bytes)\n");
+	fprintf(stdout, "\t--in [sections] - limits --search to sections: names, type=TYPE or flags=FLAGS\n");
+	fprintf(stdout, "\t--entropy - prints section headers and load segments with byte entropy\n");
+	fprintf(stdout, "\t--isa - prints x86-64 instruction counts by isa extension, nop bytes and function sizes of executable sections\n");
+	fprintf(stdout, "\t--columns [file] - writes section, program header and symbol tables of all given files as typed columns to file (\'-\' is stdout)\n");
+	fprintf(stdout, "\t--startup[=closure] - prints init arrays, .ctors and TLS sizes (closure: totals over all DT_NEEDED libraries)\n");
+	fprintf(stdout, "\t--core - prints threads, registers, mapped files and load segments of a core file\n");
+	fprintf(stdout, "\t--versions - prints symbol version definitions, requirements and .dynsym with symbol@version names\n");
+	fprintf(stdout, "\t--check-versions - checks that the versions required by the given files and directory trees are defined by them\n");
+	fprintf(stdout, "\t--addr2line - maps addresses read from stdin to file:line using .debug_line\n");
+	fprintf(stdout, "\t--eh-frame - checks .eh_frame_hdr and .eh_frame unwind tables (of all given files)\n");
+	fprintf(stdout, "\t--extract [sections] - writes section (or segment=N) contents to files in --output dir\n");
+	fprintf(stdout, "\t--keep [sections] - writes a new elf file with only these sections to --output\n");
+	fprintf(stdout, "\t--output [path] - output directory of --extract, output file of --keep\n");
+	fprintf(stdout, "\t--watch [dir] - prints elf files under dir, then only the ones added, changed or removed\n");
+	fprintf(stdout, "\t--json - prints --watch records and --where rows as json lines\n");
+	fprintf(stdout, "\t--serve [socket] - answers queries on a unix socket, keeping parsed files in memory\n");
+	fprintf(stdout, "\t--client [socket] [query] - sends a query to a --serve server and prints the answer\n");
+	fprintf(stdout, "\t--load [connections] - sends the --client query from many connections and prints latencies\n");
+	fprintf(stdout, "\t--where [expr] - prints the sections, program headers or symbols for which expr holds\n");
+	fprintf(stdout, "\t--demangle[=stats] - prints c++ symbol names of -S and --where demangled (stats: cache hit rate and speed)\n");
+	fprintf(stdout, "\t--armap [symbol] - looks up the archive member defining symbol in the archive index\n");
 }
 
 void version(void)
@@ -0,0 +1,80 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "misc.h"
+#include "parallel.h"
+
+struct parallel_job {
+	size_t count;
+	size_t next;		// next index to hand out, taken atomically
+	parallel_func func;
+	void *arg;
+};
+
+size_t get_thread_count(void)
+{
+	long count;
+	const char *env = NULL;
+
+	env = getenv("RELF_THREADS");
+	if(env && atol(env) > 0)
+		return (size_t)atol(env);
+
+	count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (size_t)count : 1;
+}
+
+static void* parallel_worker(void *arg)
+{
+	struct parallel_job *job = arg;
+	size_t index;
+
+	while((index = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->count)
+		job->func(index, job->arg);
+
+	return NULL;
+}
+
+// calls func(i, arg) for every i in [0, count) from a set of worker threads,
+// the calling thread takes part in the work too
+void parallel_for(size_t count, parallel_func func, void *arg)
+{
+	assert(func != NULL);
+
+	size_t thread_count;
+	pthread_t *threads = NULL;
+	struct parallel_job job = { count, 0, func, arg };
+
+	thread_count = get_thread_count();
+	if(thread_count > count)
+		thread_count = count;
+
+	if(thread_count <= 1)
+	{
+		for(size_t i = 0; i < count; i++)
+			func(i, arg);
+		return;
+	}
+
+	threads = malloc_wrap(sizeof(pthread_t) * (thread_count - 1));
+
+	for(size_t i = 0; i < thread_count - 1; i++)
+	{
+		int ret = pthread_create(&threads[i], NULL, parallel_worker, &job);
+		if(ret != 0)
+			error(EXIT_FAILURE, ret, "cannot create thread");
+	}
+
+	parallel_worker(&job);
+
+	for(size_t i = 0; i < thread_count - 1; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+}
\ No newline at end of file
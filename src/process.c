@@ -0,0 +1,339 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "misc.h"
+#include "elf_header.h"
+#include "program_header.h"
+#include "process.h"
+
+// the kernel refuses process_vm_readv() with more iovecs than UIO_MAXIOV
+#define REMOTE_IOV_BATCH 1024
+
+struct process_image {
+	uint64_t start;		// address of the mapping with file offset 0
+	uint64_t length;	// length of that mapping
+	unsigned int dev_major;
+	unsigned int dev_minor;
+	uint64_t inode;
+	char *path;
+	bool not_elf;		// the mapping was read and holds no elf magic, e.g. locale archives
+	bool valid;
+	union {
+		Elf32_Ehdr h32;
+		Elf64_Ehdr h64;
+	} header;
+	void *program_headers;
+	size_t program_headers_size;
+};
+
+struct process_images {
+	struct process_image *images;
+	size_t count;
+	size_t capacity;
+};
+
+static struct process_image* find_image(struct process_images *list, unsigned int dev_major, unsigned int dev_minor, uint64_t inode)
+{
+	for(size_t i = 0; i < list->count; i++)
+	{
+		struct process_image *image = &list->images[i];
+
+		if(image->inode == inode && image->dev_major == dev_major && image->dev_minor == dev_minor)
+			return image;
+	}
+
+	return NULL;
+}
+
+static void add_image(struct process_images *list, uint64_t start, uint64_t end, unsigned int dev_major, unsigned int dev_minor, uint64_t inode, const char *path)
+{
+	struct process_image *image = NULL;
+
+	if(list->count == list->capacity)
+	{
+		list->capacity = list->capacity ? list->capacity * 2 : 32;
+		list->images = realloc_wrap(list->images, list->capacity * sizeof(struct process_image));
+	}
+
+	image = &list->images[list->count++];
+	memset(image, 0, sizeof(struct process_image));
+
+	image->start = start;
+	image->length = end - start;
+	image->dev_major = dev_major;
+	image->dev_minor = dev_minor;
+	image->inode = inode;
+	image->path = strdup(path);
+	if(!image->path)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+}
+
+// collects one entry per file-backed image, identified by device and inode,
+// using the mapping that covers file offset 0 (the one holding the elf header)
+static void read_process_maps(pid_t pid, struct process_images *list)
+{
+	char maps_path[64];
+	char *line = NULL;
+	size_t line_size = 0;
+	FILE *fp = NULL;
+
+	snprintf(maps_path, sizeof(maps_path), "/proc/%d/maps", (int)pid);
+	fp = fopen_wrap(maps_path, "r");
+
+	while(getline(&line, &line_size, fp) != -1)
+	{
+		uint64_t start, end, offset, inode;
+		unsigned int dev_major, dev_minor;
+		char perms[5];
+		int path_pos = 0;
+		char *path = NULL;
+
+		if(sscanf(line, "%lx-%lx %4s %lx %x:%x %lu %n",
+			&start, &end, perms, &offset, &dev_major, &dev_minor, &inode, &path_pos) < 7)
+			continue;
+
+		path = line + path_pos;
+		path[strcspn(path, "\n")] = '\0';
+
+		if(inode == 0 || path[0] != '/' || offset != 0 || perms[0] != 'r')
+			continue;
+
+		if(find_image(list, dev_major, dev_minor, inode) != NULL)
+			continue;
+
+		add_image(list, start, end, dev_major, dev_minor, inode, path);
+	}
+
+	free(line);
+	fclose(fp);
+}
+
+// reads all remote ranges with as few process_vm_readv() calls as possible,
+// falling back to pread() on /proc/<pid>/mem for ranges the batch could not fetch
+static void read_remote_ranges(pid_t pid, int mem_fd, struct iovec *local, struct iovec *remote, bool *done, size_t count)
+{
+	size_t i = 0;
+
+	while(i < count)
+	{
+		size_t batch = count - i;
+		ssize_t readed;
+
+		if(batch > REMOTE_IOV_BATCH)
+			batch = REMOTE_IOV_BATCH;
+
+		readed = process_vm_readv(pid, &local[i], batch, &remote[i], batch, 0);
+		if(readed < 0)
+			readed = 0;
+
+		// mark every range which was transferred completely
+		while(batch > 0 && (size_t)readed >= local[i].iov_len)
+		{
+			readed -= (ssize_t)local[i].iov_len;
+			done[i++] = true;
+			batch--;
+		}
+
+		if(batch == 0)
+			continue;
+
+		if(mem_fd >= 0)
+		{
+			ssize_t ret = pread(mem_fd, local[i].iov_base, local[i].iov_len, (off_t)(uintptr_t)remote[i].iov_base);
+			done[i] = (ret == (ssize_t)local[i].iov_len);
+		}
+		i++;
+	}
+}
+
+static void read_image_headers(pid_t pid, int mem_fd, struct process_images *list)
+{
+	struct iovec *local = NULL;
+	struct iovec *remote = NULL;
+	bool *done = NULL;
+	size_t *index = NULL;
+	size_t count = 0;
+
+	if(list->count == 0)
+		return;
+
+	local = malloc_wrap(sizeof(struct iovec) * list->count);
+	remote = malloc_wrap(sizeof(struct iovec) * list->count);
+	done = malloc_wrap(sizeof(bool) * list->count);
+	index = malloc_wrap(sizeof(size_t) * list->count);
+
+	// first pass: elf headers of every image at once
+	for(size_t i = 0; i < list->count; i++)
+	{
+		local[i].iov_base = &list->images[i].header;
+		local[i].iov_len = sizeof(list->images[i].header);
+		remote[i].iov_base = (void*)(uintptr_t)list->images[i].start;
+		remote[i].iov_len = sizeof(list->images[i].header);
+		done[i] = false;
+	}
+
+	read_remote_ranges(pid, mem_fd, local, remote, done, list->count);
+
+	// second pass: program header tables of the images that turned out to be elf
+	for(size_t i = 0; i < list->count; i++)
+	{
+		struct process_image *image = &list->images[i];
+		unsigned char *ident = image->header.h64.e_ident;
+		uint64_t phoff;
+		size_t phsize;
+
+		if(!done[i])
+			continue;
+		if(memcmp(ident, ELFMAG, SELFMAG) != 0)
+		{
+			image->not_elf = true;
+			continue;
+		}
+
+		if(ident[EI_CLASS] == ELFCLASS32)
+		{
+			if(image->header.h32.e_phentsize != sizeof(Elf32_Phdr))
+				continue;
+			phoff = image->header.h32.e_phoff;
+			phsize = sizeof(Elf32_Phdr) * image->header.h32.e_phnum;
+		}
+		else if(ident[EI_CLASS] == ELFCLASS64)
+		{
+			if(image->header.h64.e_phentsize != sizeof(Elf64_Phdr))
+				continue;
+			phoff = image->header.h64.e_phoff;
+			phsize = sizeof(Elf64_Phdr) * image->header.h64.e_phnum;
+		}
+		else
+			continue;
+
+		// program headers must lie inside the first mapping of the image
+		if(phoff > image->length || phsize > image->length - phoff)
+			continue;
+
+		image->valid = true;
+		image->program_headers_size = phsize;
+		if(phsize == 0)
+			continue;
+
+		image->program_headers = malloc_wrap(phsize);
+
+		local[count].iov_base = image->program_headers;
+		local[count].iov_len = phsize;
+		remote[count].iov_base = (void*)(uintptr_t)(image->start + phoff);
+		remote[count].iov_len = phsize;
+		done[count] = false;
+		index[count] = i;
+		count++;
+	}
+
+	read_remote_ranges(pid, mem_fd, local, remote, done, count);
+
+	for(size_t i = 0; i < count; i++)
+	{
+		if(!done[i])
+			list->images[index[i]].valid = false;
+	}
+
+	free(index);
+	free(done);
+	free(remote);
+	free(local);
+}
+
+static uint64_t get_image_load_bias(struct process_image *image)
+{
+	if(image->header.h64.e_ident[EI_CLASS] == ELFCLASS32)
+	{
+		Elf32_Phdr *phdrs = image->program_headers;
+
+		for(size_t i = 0; i < image->header.h32.e_phnum; i++)
+			if(phdrs[i].p_type == PT_LOAD)
+				return image->start - (uint64_t)(phdrs[i].p_vaddr - phdrs[i].p_offset);
+	}
+	else
+	{
+		Elf64_Phdr *phdrs = image->program_headers;
+
+		for(size_t i = 0; i < image->header.h64.e_phnum; i++)
+			if(phdrs[i].p_type == PT_LOAD)
+				return image->start - (phdrs[i].p_vaddr - phdrs[i].p_offset);
+	}
+
+	return image->start;
+}
+
+static void print_process_image(struct process_image *image, bool is_elf_header, bool is_program_header)
+{
+	printf("Image: %s\n", image->path);
+	printf("  Device: %02x:%02x  Inode: %lu\n", image->dev_major, image->dev_minor, image->inode);
+	printf("  Base address: %#018lx  Load bias: %#018lx\n\n", image->start, get_image_load_bias(image));
+
+	if(image->header.h64.e_ident[EI_CLASS] == ELFCLASS32)
+	{
+		if(is_elf_header)
+			print_elf32_header(&image->header.h32);
+		if(is_program_header && image->program_headers)
+			print_program32_headers(image->program_headers, &image->header.h32);
+	}
+	else
+	{
+		if(is_elf_header)
+			print_elf64_header(&image->header.h64);
+		if(is_program_header && image->program_headers)
+			print_program64_headers(image->program_headers, &image->header.h64);
+	}
+
+	printf("\n");
+}
+
+void print_process_images(pid_t pid, bool is_elf_header, bool is_program_header)
+{
+	char mem_path[64];
+	int mem_fd;
+	size_t image_count = 0;
+	struct process_images list = { NULL, 0, 0 };
+
+	if(!is_elf_header && !is_program_header)
+		is_elf_header = is_program_header = true;
+
+	read_process_maps(pid, &list);
+
+	snprintf(mem_path, sizeof(mem_path), "/proc/%d/mem", (int)pid);
+	mem_fd = open(mem_path, O_RDONLY);
+
+	read_image_headers(pid, mem_fd, &list);
+
+	if(mem_fd >= 0)
+		close(mem_fd);
+
+	for(size_t i = 0; i < list.count; i++)
+		if(!list.images[i].not_elf)
+			image_count++;
+
+	printf("Process %d has %zu mapped images\n\n", (int)pid, image_count);
+
+	for(size_t i = 0; i < list.count; i++)
+	{
+		if(list.images[i].valid)
+			print_process_image(&list.images[i], is_elf_header, is_program_header);
+		else if(!list.images[i].not_elf)
+			error(0, EIO, "cannot read elf headers of \'%s\'", list.images[i].path);
+
+		free(list.images[i].program_headers);
+		free(list.images[i].path);
+	}
+
+	free(list.images);
+}
\ No newline at end of file
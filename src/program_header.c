@@ -8,6 +8,7 @@
 #include <assert.h>
 #include <sys/types.h>
 #include "misc.h"
+#include "program_header.h"
 
 enum {
 	P_NULL = 0,
@@ -203,16 +204,31 @@ void print_program32_headers(Elf32_Phdr *program_headers, Elf32_Ehdr *elf_header
 }
 
 void print_program64_headers(Elf64_Phdr *program_headers, Elf64_Ehdr *elf_header)
+{
+	print_program64_headers_selected(program_headers, elf_header, NULL);
+}
+
+// prints the program headers whose selected byte is set, or all of them when selected is NULL
+void print_program64_headers_selected(Elf64_Phdr *program_headers, Elf64_Ehdr *elf_header, const unsigned char *selected)
 {
 	assert(program_headers != NULL);
 	assert(elf_header != NULL);
 
-	printf("Executable have %d program headers, starting at offset %ld\n\n", elf_header->e_phnum, elf_header->e_phoff);
+	size_t selected_count = 0;
+
+	for(size_t i = 0; selected && i < elf_header->e_phnum; i++)
+		selected_count += selected[i];
+
+	if(selected)
+		printf("%zu of %d program headers selected\n\n", selected_count, elf_header->e_phnum);
+	else
+		printf("Executable have %d program headers, starting at offset %ld\n\n", elf_header->e_phnum, elf_header->e_phoff);
 
 	printf("Program headers:\n");
 	printf("  Type         Offset             VirtAddr           PhysAddr\n");
 	printf("               FileSize           MemSize            Flags Align\n");
 
 	for(size_t i = 0; i < elf_header->e_phnum; i++)
-		print_program64_header(&program_headers[i]);
+		if(!selected || selected[i])
+			print_program64_header(&program_headers[i]);
 }
@@ -0,0 +1,1011 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include <fnmatch.h>
+#include "misc.h"
+#include "image.h"
+#include "symbol.h"
+#include "demangle.h"
+#include "section_header.h"
+#include "program_header.h"
+#include "query.h"
+
+/*
+ * --where expressions are parsed once into a tree, compiled once for every
+ * kind of table (fields and constants resolved) and evaluated over column
+ * copies of the tables: every comparison is one loop over a uint64_t column
+ * that writes a byte mask, and and/or/not combine the masks.
+ */
+
+#define WHERE_FIELDS_MAX 12
+#define WHERE_MESSAGE_SIZE 256
+
+enum field_kind {
+	FIELD_NUMBER,
+	FIELD_NAME,
+	FIELD_SECTION_TYPE,
+	FIELD_SECTION_FLAGS,
+	FIELD_SEGMENT_TYPE,
+	FIELD_SEGMENT_FLAGS,
+	FIELD_SYMBOL_TYPE,
+	FIELD_SYMBOL_BIND,
+	FIELD_SYMBOL_VISIBILITY,
+	FIELD_SECTION_INDEX
+};
+
+struct field {
+	const char *name;
+	enum field_kind kind;
+};
+
+struct named_value {
+	const char *name;
+	uint64_t value;
+};
+
+static const struct field section_fields[] = {
+	{"index", FIELD_NUMBER},
+	{"name", FIELD_NAME},
+	{"type", FIELD_SECTION_TYPE},
+	{"flags", FIELD_SECTION_FLAGS},
+	{"addr", FIELD_NUMBER},
+	{"offset", FIELD_NUMBER},
+	{"size", FIELD_NUMBER},
+	{"entsize", FIELD_NUMBER},
+	{"link", FIELD_NUMBER},
+	{"info", FIELD_NUMBER},
+	{"align", FIELD_NUMBER},
+	{NULL, FIELD_NUMBER}
+};
+
+static const struct field segment_fields[] = {
+	{"index", FIELD_NUMBER},
+	{"type", FIELD_SEGMENT_TYPE},
+	{"flags", FIELD_SEGMENT_FLAGS},
+	{"offset", FIELD_NUMBER},
+	{"vaddr", FIELD_NUMBER},
+	{"paddr", FIELD_NUMBER},
+	{"filesz", FIELD_NUMBER},
+	{"memsz", FIELD_NUMBER},
+	{"align", FIELD_NUMBER},
+	{NULL, FIELD_NUMBER}
+};
+
+static const struct field symbol_fields[] = {
+	{"index", FIELD_NUMBER},
+	{"name", FIELD_NAME},
+	{"value", FIELD_NUMBER},
+	{"size", FIELD_NUMBER},
+	{"type", FIELD_SYMBOL_TYPE},
+	{"bind", FIELD_SYMBOL_BIND},
+	{"vis", FIELD_SYMBOL_VISIBILITY},
+	{"section", FIELD_SECTION_INDEX},
+	{NULL, FIELD_NUMBER}
+};
+
+struct table_kind {
+	int id;
+	const char *name;
+	const struct field *fields;
+};
+
+static const struct table_kind table_kinds[] = {
+	{WHERE_SECTIONS, "section", section_fields},
+	{WHERE_SEGMENTS, "segment", segment_fields},
+	{WHERE_SYMBOLS, "symbol", symbol_fields}
+};
+
+static const struct named_value section_types[] = {
+	{"NULL", SHT_NULL},
+	{"PROGBITS", SHT_PROGBITS},
+	{"SYMTAB", SHT_SYMTAB},
+	{"STRTAB", SHT_STRTAB},
+	{"RELA", SHT_RELA},
+	{"HASH", SHT_HASH},
+	{"DYNAMIC", SHT_DYNAMIC},
+	{"NOTE", SHT_NOTE},
+	{"NOBITS", SHT_NOBITS},
+	{"REL", SHT_REL},
+	{"SHLIB", SHT_SHLIB},
+	{"DYNSYM", SHT_DYNSYM},
+	{"INIT_ARRAY", SHT_INIT_ARRAY},
+	{"FINI_ARRAY", SHT_FINI_ARRAY},
+	{"PREINIT_ARRAY", SHT_PREINIT_ARRAY},
+	{"GROUP", SHT_GROUP},
+	{"SYMTAB_SHNDX", SHT_SYMTAB_SHNDX},
+	{"GNU_HASH", SHT_GNU_HASH},
+	{"VERDEF", SHT_GNU_verdef},
+	{"VERNEED", SHT_GNU_verneed},
+	{"VERSYM", SHT_GNU_versym},
+	{NULL, 0}
+};
+
+static const struct named_value segment_types[] = {
+	{"NULL", PT_NULL},
+	{"LOAD", PT_LOAD},
+	{"DYNAMIC", PT_DYNAMIC},
+	{"INTERP", PT_INTERP},
+	{"NOTE", PT_NOTE},
+	{"SHLIB", PT_SHLIB},
+	{"PHDR", PT_PHDR},
+	{"TLS", PT_TLS},
+	{"GNU_EH_FRAME", PT_GNU_EH_FRAME},
+	{"GNU_STACK", PT_GNU_STACK},
+	{"GNU_RELRO", PT_GNU_RELRO},
+	{"GNU_PROPERTY", PT_GNU_PROPERTY},
+	{NULL, 0}
+};
+
+static const struct named_value special_sections[] = {
+	{"UND", SHN_UNDEF},
+	{"ABS", SHN_ABS},
+	{"COM", SHN_COMMON},
+	{"COMMON", SHN_COMMON},
+	{NULL, 0}
+};
+
+// flag letters as readelf prints them
+static const struct named_value section_flags[] = {
+	{"W", SHF_WRITE},
+	{"A", SHF_ALLOC},
+	{"X", SHF_EXECINSTR},
+	{"M", SHF_MERGE},
+	{"S", SHF_STRINGS},
+	{"I", SHF_INFO_LINK},
+	{"L", SHF_LINK_ORDER},
+	{"O", SHF_OS_NONCONFORMING},
+	{"G", SHF_GROUP},
+	{"T", SHF_TLS},
+	{"C", SHF_COMPRESSED},
+	{NULL, 0}
+};
+
+static const struct named_value segment_flags[] = {
+	{"R", PF_R},
+	{"W", PF_W},
+	{"X", PF_X},
+	{"E", PF_X},
+	{NULL, 0}
+};
+
+enum token_kind {
+	TOKEN_END,
+	TOKEN_WORD,
+	TOKEN_STRING,
+	TOKEN_LPAREN,
+	TOKEN_RPAREN,
+	TOKEN_NOT,
+	TOKEN_AND,
+	TOKEN_OR,
+	TOKEN_OP
+};
+
+enum compare_op {
+	OP_EQ,
+	OP_NE,
+	OP_LT,
+	OP_LE,
+	OP_GT,
+	OP_GE,
+	OP_MATCH,
+	OP_NOT_MATCH
+};
+
+enum node_kind {
+	NODE_COMPARE,
+	NODE_AND,
+	NODE_OR,
+	NODE_NOT
+};
+
+struct where_node {
+	enum node_kind kind;
+	size_t left;
+	size_t right;
+	enum compare_op op;
+	char *field;
+	char *text;
+	// set by compile_expression for the table kind being evaluated
+	size_t column;
+	bool is_name;
+	uint64_t value;
+};
+
+struct where_expression {
+	struct where_node *nodes;
+	size_t count;
+	size_t capacity;
+	size_t root;
+};
+
+struct parser {
+	const char *expression;
+	const char *pos;
+	const char *start;	// of the current token, for error messages
+	enum token_kind token;
+	enum compare_op op;
+	char *text;
+	struct where_expression *tree;
+};
+
+// copy of one table with a column per field, names kept apart
+struct column_table {
+	const struct table_kind *kind;
+	const char *label;
+	size_t count;
+	const char **names;
+	uint64_t *columns[WHERE_FIELDS_MAX];
+};
+
+static void parse_error(const struct parser *parser, const char *message)
+{
+	error(EXIT_FAILURE, EINVAL, "--where \'%s\': %s at \'%s\'", parser->expression, message, parser->start);
+}
+
+static void next_token(struct parser *parser)
+{
+	const char *pos = NULL;
+
+	free(parser->text);
+	parser->text = NULL;
+
+	while(*parser->pos == ' ' || *parser->pos == '\t')
+		parser->pos++;
+
+	pos = parser->start = parser->pos;
+
+	if(*pos == '\0')
+	{
+		parser->token = TOKEN_END;
+		return;
+	}
+
+	parser->token = TOKEN_OP;
+	parser->pos++;
+
+	switch(*pos)
+	{
+	case '(':
+		parser->token = TOKEN_LPAREN;
+		return;
+	case ')':
+		parser->token = TOKEN_RPAREN;
+		return;
+	case '&':
+	case '|':
+		if(pos[1] != pos[0])
+			parse_error(parser, "expected && or ||");
+		parser->token = *pos == '&' ? TOKEN_AND : TOKEN_OR;
+		parser->pos++;
+		return;
+	case '!':
+		if(pos[1] == '=' || pos[1] == '~')
+		{
+			parser->op = pos[1] == '=' ? OP_NE : OP_NOT_MATCH;
+			parser->pos++;
+		}
+		else
+			parser->token = TOKEN_NOT;
+		return;
+	case '=':
+		parser->op = OP_EQ;
+		if(pos[1] == '=')
+			parser->pos++;
+		return;
+	case '<':
+	case '>':
+		if(pos[1] == '=')
+		{
+			parser->op = *pos == '<' ? OP_LE : OP_GE;
+			parser->pos++;
+		}
+		else
+			parser->op = *pos == '<' ? OP_LT : OP_GT;
+		return;
+	case '~':
+		parser->op = OP_MATCH;
+		return;
+	case '\'':
+	case '"':
+		parser->pos = strchr(pos + 1, *pos);
+		if(!parser->pos)
+			parse_error(parser, "unterminated string");
+		parser->token = TOKEN_STRING;
+		parser->text = strndup(pos + 1, (size_t)(parser->pos - pos - 1));
+		parser->pos++;
+		break;
+	default:
+		parser->pos = pos + strcspn(pos, " \t()!=<>~&|'\"");
+		parser->token = TOKEN_WORD;
+		parser->text = strndup(pos, (size_t)(parser->pos - pos));
+		break;
+	}
+
+	if(!parser->text)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	if(parser->token == TOKEN_WORD && strcasecmp(parser->text, "and") == 0)
+		parser->token = TOKEN_AND;
+	else if(parser->token == TOKEN_WORD && strcasecmp(parser->text, "or") == 0)
+		parser->token = TOKEN_OR;
+	else if(parser->token == TOKEN_WORD && strcasecmp(parser->text, "not") == 0)
+		parser->token = TOKEN_NOT;
+}
+
+static size_t add_node(struct where_expression *tree, enum node_kind kind, size_t left, size_t right)
+{
+	struct where_node *node = NULL;
+
+	if(tree->count == tree->capacity)
+	{
+		tree->capacity = tree->capacity ? tree->capacity * 2 : 16;
+		tree->nodes = realloc_wrap(tree->nodes, sizeof(struct where_node) * tree->capacity);
+	}
+
+	node = &tree->nodes[tree->count];
+	memset(node, 0, sizeof(struct where_node));
+	node->kind = kind;
+	node->left = left;
+	node->right = right;
+
+	return tree->count++;
+}
+
+static size_t parse_or(struct parser *parser);
+
+static size_t parse_unary(struct parser *parser)
+{
+	size_t node;
+
+	if(parser->token == TOKEN_NOT)
+	{
+		next_token(parser);
+		node = parse_unary(parser);
+		return add_node(parser->tree, NODE_NOT, node, 0);
+	}
+
+	if(parser->token == TOKEN_LPAREN)
+	{
+		next_token(parser);
+		node = parse_or(parser);
+		if(parser->token != TOKEN_RPAREN)
+			parse_error(parser, "expected )");
+		next_token(parser);
+		return node;
+	}
+
+	if(parser->token != TOKEN_WORD)
+		parse_error(parser, "expected a field name");
+
+	node = add_node(parser->tree, NODE_COMPARE, 0, 0);
+	parser->tree->nodes[node].field = parser->text;
+	parser->text = NULL;
+
+	next_token(parser);
+	if(parser->token != TOKEN_OP)
+		parse_error(parser, "expected ==, !=, <, <=, >, >=, ~ or !~");
+	parser->tree->nodes[node].op = parser->op;
+
+	next_token(parser);
+	if(parser->token != TOKEN_WORD && parser->token != TOKEN_STRING)
+		parse_error(parser, "expected a value");
+	parser->tree->nodes[node].text = parser->text;
+	parser->text = NULL;
+
+	next_token(parser);
+	return node;
+}
+
+static size_t parse_and(struct parser *parser)
+{
+	size_t node = parse_unary(parser);
+
+	while(parser->token == TOKEN_AND)
+	{
+		next_token(parser);
+		node = add_node(parser->tree, NODE_AND, node, parse_unary(parser));
+	}
+
+	return node;
+}
+
+static size_t parse_or(struct parser *parser)
+{
+	size_t node = parse_and(parser);
+
+	while(parser->token == TOKEN_OR)
+	{
+		next_token(parser);
+		node = add_node(parser->tree, NODE_OR, node, parse_and(parser));
+	}
+
+	return node;
+}
+
+static void parse_expression(const char *expression, struct where_expression *tree)
+{
+	struct parser parser;
+
+	memset(tree, 0, sizeof(struct where_expression));
+	memset(&parser, 0, sizeof(parser));
+	parser.expression = parser.pos = expression;
+	parser.tree = tree;
+
+	next_token(&parser);
+	tree->root = parse_or(&parser);
+	if(parser.token != TOKEN_END)
+		parse_error(&parser, "expected and, or or the end");
+}
+
+static void free_expression(struct where_expression *tree)
+{
+	for(size_t i = 0; i < tree->count; i++)
+	{
+		free(tree->nodes[i].field);
+		free(tree->nodes[i].text);
+	}
+
+	free(tree->nodes);
+	memset(tree, 0, sizeof(struct where_expression));
+}
+
+// numbers in any C base with an optional K, M or G (KB, KiB...) suffix
+static bool parse_number(const char *text, uint64_t *value)
+{
+	char *end = NULL;
+	uint64_t scale = 1;
+
+	errno = 0;
+	*value = strtoull(text, &end, 0);
+	if(errno != 0 || end == text || text[0] == '-')
+		return false;
+
+	if(*end == 'k' || *end == 'K')
+		scale = 1ull << 10;
+	else if(*end == 'm' || *end == 'M')
+		scale = 1ull << 20;
+	else if(*end == 'g' || *end == 'G')
+		scale = 1ull << 30;
+
+	if(scale > 1)
+	{
+		end++;
+		if(*end == 'i')
+			end++;
+		if(*end == 'b' || *end == 'B')
+			end++;
+	}
+
+	if(*end != '\0' || *value > UINT64_MAX / scale)
+		return false;
+
+	*value *= scale;
+	return true;
+}
+
+static bool parse_named(const struct named_value *names, const char *text, uint64_t *value)
+{
+	for(; names->name; names++)
+	{
+		if(strcasecmp(names->name, text) == 0)
+		{
+			*value = names->value;
+			return true;
+		}
+	}
+
+	return parse_number(text, value);
+}
+
+// symbol names come from symbol.c, tried for every value of the 4 bit field
+static bool parse_symbol_info(const char* (*get_name)(unsigned int), const char *text, uint64_t *value)
+{
+	for(unsigned int i = 0; i < 16; i++)
+	{
+		const char *name = get_name(i);
+
+		if(name && strcasecmp(name, text) == 0)
+		{
+			*value = i;
+			return true;
+		}
+	}
+
+	return parse_number(text, value);
+}
+
+static bool parse_flags(const struct named_value *flags, const char *text, uint64_t *value)
+{
+	const char *pos = text;
+
+	*value = 0;
+	for(; *pos; pos++)
+	{
+		const struct named_value *flag = flags;
+
+		while(flag->name && flag->name[0] != *pos)
+			flag++;
+		if(!flag->name)
+			return parse_number(text, value);
+
+		*value |= flag->value;
+	}
+
+	return pos != text;
+}
+
+static bool parse_value(enum field_kind kind, const char *text, uint64_t *value)
+{
+	switch(kind)
+	{
+	case FIELD_SECTION_TYPE:
+		return parse_named(section_types, text, value);
+	case FIELD_SEGMENT_TYPE:
+		return parse_named(segment_types, text, value);
+	case FIELD_SECTION_INDEX:
+		return parse_named(special_sections, text, value);
+	case FIELD_SECTION_FLAGS:
+		return parse_flags(section_flags, text, value);
+	case FIELD_SEGMENT_FLAGS:
+		return parse_flags(segment_flags, text, value);
+	case FIELD_SYMBOL_TYPE:
+		return parse_symbol_info(get_symbol_type, text, value);
+	case FIELD_SYMBOL_BIND:
+		return parse_symbol_info(get_symbol_bind, text, value);
+	case FIELD_SYMBOL_VISIBILITY:
+		return parse_symbol_info(get_symbol_visibility, text, value);
+	case FIELD_NUMBER:
+	case FIELD_NAME:
+	default:
+		return parse_number(text, value);
+	}
+}
+
+/*
+ * resolves the fields and constants of the tree for one kind of table,
+ * returns false with a message if the expression does not fit it
+ */
+static bool compile_expression(struct where_expression *tree, const struct table_kind *kind, char *message)
+{
+	for(size_t i = 0; i < tree->count; i++)
+	{
+		struct where_node *node = &tree->nodes[i];
+		const struct field *field = kind->fields;
+		bool is_flags;
+
+		if(node->kind != NODE_COMPARE)
+			continue;
+
+		while(field->name && strcmp(field->name, node->field) != 0)
+			field++;
+		if(!field->name)
+		{
+			snprintf(message, WHERE_MESSAGE_SIZE, "%ss have no field \'%s\'", kind->name, node->field);
+			return false;
+		}
+
+		node->column = (size_t)(field - kind->fields);
+		node->is_name = field->kind == FIELD_NAME;
+		is_flags = field->kind == FIELD_SECTION_FLAGS || field->kind == FIELD_SEGMENT_FLAGS;
+
+		if((node->is_name || is_flags) && node->op != OP_EQ && node->op != OP_NE && node->op != OP_MATCH && node->op != OP_NOT_MATCH)
+		{
+			snprintf(message, WHERE_MESSAGE_SIZE, "%s can only be compared with ==, !=, ~ and !~", node->field);
+			return false;
+		}
+		if(!node->is_name && !is_flags && (node->op == OP_MATCH || node->op == OP_NOT_MATCH))
+		{
+			snprintf(message, WHERE_MESSAGE_SIZE, "%s can not be matched with ~", node->field);
+			return false;
+		}
+
+		if(!node->is_name && !parse_value(field->kind, node->text, &node->value))
+		{
+			snprintf(message, WHERE_MESSAGE_SIZE, "invalid %s value \'%s\'", node->field, node->text);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void compare_numbers(unsigned char *restrict mask, const uint64_t *restrict column, size_t count, enum compare_op op, uint64_t value)
+{
+	switch(op)
+	{
+	case OP_EQ:
+		for(size_t i = 0; i < count; i++)
+			mask[i] = column[i] == value;
+		break;
+	case OP_NE:
+		for(size_t i = 0; i < count; i++)
+			mask[i] = column[i] != value;
+		break;
+	case OP_LT:
+		for(size_t i = 0; i < count; i++)
+			mask[i] = column[i] < value;
+		break;
+	case OP_LE:
+		for(size_t i = 0; i < count; i++)
+			mask[i] = column[i] <= value;
+		break;
+	case OP_GT:
+		for(size_t i = 0; i < count; i++)
+			mask[i] = column[i] > value;
+		break;
+	case OP_GE:
+		for(size_t i = 0; i < count; i++)
+			mask[i] = column[i] >= value;
+		break;
+	case OP_MATCH:
+		// flags: all of the given ones are set
+		for(size_t i = 0; i < count; i++)
+			mask[i] = (column[i] & value) == value;
+		break;
+	case OP_NOT_MATCH:
+		for(size_t i = 0; i < count; i++)
+			mask[i] = (column[i] & value) != value;
+		break;
+	}
+}
+
+static void compare_names(unsigned char *mask, const char **names, size_t count, enum compare_op op, const char *text)
+{
+	for(size_t i = 0; i < count; i++)
+	{
+		if(op == OP_EQ || op == OP_NE)
+			mask[i] = (strcmp(names[i], text) == 0) == (op == OP_EQ);
+		else
+			mask[i] = (fnmatch(text, names[i], 0) == 0) == (op == OP_MATCH);
+	}
+}
+
+// byte mask of the rows for which the subtree holds, table->count + 1 bytes
+static unsigned char* evaluate(const struct where_expression *tree, size_t index, const struct column_table *table)
+{
+	const struct where_node *node = &tree->nodes[index];
+	unsigned char *mask = NULL, *other = NULL;
+	size_t count = table->count;
+
+	if(node->kind != NODE_COMPARE)
+		mask = evaluate(tree, node->left, table);
+	if(node->kind == NODE_AND || node->kind == NODE_OR)
+		other = evaluate(tree, node->right, table);
+
+	switch(node->kind)
+	{
+	case NODE_COMPARE:
+		mask = malloc_wrap(count + 1);
+		if(node->is_name)
+			compare_names(mask, table->names, count, node->op, node->text);
+		else
+			compare_numbers(mask, table->columns[node->column], count, node->op, node->value);
+		break;
+	case NODE_AND:
+		for(size_t i = 0; i < count; i++)
+			mask[i] &= other[i];
+		break;
+	case NODE_OR:
+		for(size_t i = 0; i < count; i++)
+			mask[i] |= other[i];
+		break;
+	case NODE_NOT:
+		for(size_t i = 0; i < count; i++)
+			mask[i] ^= 1;
+		break;
+	}
+
+	free(other);
+	return mask;
+}
+
+static void alloc_columns(struct column_table *table, const struct table_kind *kind, const char *label, size_t count)
+{
+	memset(table, 0, sizeof(struct column_table));
+	table->kind = kind;
+	table->label = label;
+	table->count = count;
+	table->names = malloc_wrap(sizeof(char*) * (count + 1));
+
+	for(size_t i = 0; kind->fields[i].name; i++)
+		table->columns[i] = malloc_wrap(sizeof(uint64_t) * (count + 1));
+}
+
+static void free_columns(struct column_table *table)
+{
+	for(size_t i = 0; i < WHERE_FIELDS_MAX; i++)
+		free(table->columns[i]);
+	free(table->names);
+	memset(table, 0, sizeof(struct column_table));
+}
+
+static void load_section_columns(const struct elf_image *image, struct column_table *table)
+{
+	uint64_t **columns = table->columns;
+
+	alloc_columns(table, &table_kinds[0], "section", image->header.e_shnum);
+
+	for(size_t i = 0; i < table->count; i++)
+	{
+		const Elf64_Shdr *section = &image->section_headers[i];
+
+		table->names[i] = get_section_name(image, section);
+		columns[0][i] = i;
+		columns[1][i] = 0;
+		columns[2][i] = section->sh_type;
+		columns[3][i] = section->sh_flags;
+		columns[4][i] = section->sh_addr;
+		columns[5][i] = section->sh_offset;
+		columns[6][i] = section->sh_size;
+		columns[7][i] = section->sh_entsize;
+		columns[8][i] = section->sh_link;
+		columns[9][i] = section->sh_info;
+		columns[10][i] = section->sh_addralign;
+	}
+}
+
+static void load_segment_columns(const struct elf_image *image, struct column_table *table)
+{
+	uint64_t **columns = table->columns;
+
+	alloc_columns(table, &table_kinds[1], "segment", image->header.e_phnum);
+
+	for(size_t i = 0; i < table->count; i++)
+	{
+		const Elf64_Phdr *segment = &image->program_headers[i];
+
+		table->names[i] = "";
+		columns[0][i] = i;
+		columns[1][i] = segment->p_type;
+		columns[2][i] = segment->p_flags;
+		columns[3][i] = segment->p_offset;
+		columns[4][i] = segment->p_vaddr;
+		columns[5][i] = segment->p_paddr;
+		columns[6][i] = segment->p_filesz;
+		columns[7][i] = segment->p_memsz;
+		columns[8][i] = segment->p_align;
+	}
+}
+
+static void load_symbol_columns(const struct symbol_table *symbols, const char *label, struct column_table *table)
+{
+	uint64_t **columns = table->columns;
+
+	alloc_columns(table, &table_kinds[2], label, symbols->count);
+
+	for(size_t i = 0; i < table->count; i++)
+	{
+		const Elf64_Sym *symbol = &symbols->symbols[i];
+
+		table->names[i] = get_symbol_name(symbols, symbol);
+		columns[0][i] = i;
+		columns[1][i] = 0;
+		columns[2][i] = symbol->st_value;
+		columns[3][i] = symbol->st_size;
+		columns[4][i] = ELF64_ST_TYPE(symbol->st_info);
+		columns[5][i] = ELF64_ST_BIND(symbol->st_info);
+		columns[6][i] = ELF64_ST_VISIBILITY(symbol->st_other);
+		columns[7][i] = symbol->st_shndx;
+	}
+}
+
+static const char* find_value_name(const struct named_value *names, uint64_t value)
+{
+	for(; names->name; names++)
+		if(names->value == value)
+			return names->name;
+
+	return NULL;
+}
+
+static void print_json_value(enum field_kind kind, uint64_t value)
+{
+	const struct named_value *flags = NULL;
+	const char *name = NULL;
+
+	switch(kind)
+	{
+	case FIELD_SECTION_TYPE:
+		name = find_value_name(section_types, value);
+		break;
+	case FIELD_SEGMENT_TYPE:
+		name = find_value_name(segment_types, value);
+		break;
+	case FIELD_SECTION_INDEX:
+		name = find_value_name(special_sections, value);
+		break;
+	case FIELD_SYMBOL_TYPE:
+		name = get_symbol_type((unsigned int)value);
+		break;
+	case FIELD_SYMBOL_BIND:
+		name = get_symbol_bind((unsigned int)value);
+		break;
+	case FIELD_SYMBOL_VISIBILITY:
+		name = get_symbol_visibility((unsigned int)value);
+		break;
+	case FIELD_SECTION_FLAGS:
+		flags = section_flags;
+		break;
+	case FIELD_SEGMENT_FLAGS:
+		flags = segment_flags;
+		break;
+	case FIELD_NUMBER:
+	case FIELD_NAME:
+	default:
+		break;
+	}
+
+	if(flags)
+	{
+		// letters that are aliases (E for X) are printed once
+		putchar('"');
+		for(const struct named_value *flag = flags; flag->name; flag++)
+			if((value & flag->value) && find_value_name(flags, flag->value) == flag->name)
+				putchar(flag->name[0]);
+		putchar('"');
+	}
+	else if(name)
+		printf("\"%s\"", name);
+	else
+		printf("%lu", value);
+}
+
+static void print_json_rows(const char *filename, const struct column_table *table, const unsigned char *mask)
+{
+	for(size_t i = 0; i < table->count; i++)
+	{
+		if(!mask[i])
+			continue;
+
+		printf("{\"file\":");
+		print_json_string(filename);
+		printf(",\"table\":");
+		print_json_string(table->label);
+
+		for(size_t j = 0; table->kind->fields[j].name; j++)
+		{
+			const struct field *field = &table->kind->fields[j];
+
+			printf(",\"%s\":", field->name);
+			if(field->kind == FIELD_NAME)
+				print_json_string(table->names[i]);
+			else
+				print_json_value(field->kind, table->columns[j][i]);
+		}
+
+		printf("}\n");
+	}
+}
+
+// runs the compiled expression over one table and prints the rows it selects
+static void print_selected(const char *filename, struct elf_image *image, const struct where_expression *tree,
+	const struct column_table *table, const struct symbol_table *symbols, bool json)
+{
+	unsigned char *mask = NULL;
+
+	mask = evaluate(tree, tree->root, table);
+
+	if(json)
+		print_json_rows(filename, table, mask);
+	else if(table->kind->id == WHERE_SECTIONS && !image->strtab_buffer)
+		error(0, EBADF, "\'%s\' has no section name table", filename);
+	else if(table->kind->id == WHERE_SECTIONS)
+		print_section64_headers_selected(image->section_headers, &image->header, image->strtab_buffer, mask);
+	else if(table->kind->id == WHERE_SEGMENTS)
+		print_program64_headers_selected(image->program_headers, &image->header, mask);
+	else
+		print_symbols(symbols, table->label, mask, table->names);
+
+	free(mask);
+}
+
+static void where_file(const char *filename, struct where_expression *tree, int tables, bool json, struct demangler *demangler)
+{
+	struct elf_image image;
+	struct column_table table;
+	struct symbol_table symbols;
+	char message[WHERE_MESSAGE_SIZE];
+	int ret;
+
+	ret = open_elf_image(&image, filename);
+	if(ret != 0)
+	{
+		error(0, ret, "\'%s\' is not a valid elf file", filename);
+		free_elf_image(&image);
+		return;
+	}
+
+	if(tables & WHERE_SECTIONS)
+	{
+		compile_expression(tree, &table_kinds[0], message);
+		load_section_columns(&image, &table);
+		print_selected(filename, &image, tree, &table, NULL, json);
+		free_columns(&table);
+	}
+
+	if(tables & WHERE_SEGMENTS)
+	{
+		compile_expression(tree, &table_kinds[1], message);
+		load_segment_columns(&image, &table);
+		print_selected(filename, &image, tree, &table, NULL, json);
+		free_columns(&table);
+	}
+
+	if(tables & WHERE_SYMBOLS)
+	{
+		compile_expression(tree, &table_kinds[2], message);
+
+		for(size_t i = 0; i < image.header.e_shnum; i++)
+		{
+			const Elf64_Shdr *section = &image.section_headers[i];
+
+			if(section->sh_type != SHT_SYMTAB && section->sh_type != SHT_DYNSYM)
+				continue;
+
+			ret = load_symbol_table(&image, section, &symbols);
+			if(ret != 0)
+				error(0, ret, "cannot read symbol table \'%s\'", get_section_name(&image, section));
+			else
+			{
+				load_symbol_columns(&symbols, get_section_name(&image, section), &table);
+				if(demangler)
+					demangle_names(demangler, table.names, table.count);
+				print_selected(filename, &image, tree, &table, &symbols, json);
+				free_columns(&table);
+			}
+			free_symbol_table(&symbols);
+		}
+	}
+
+	free_elf_image(&image);
+}
+
+/*
+ * prints the rows of the chosen tables for which the expression holds; with
+ * no table chosen every table whose fields the expression uses is searched.
+ * with a demangler symbol names are matched and printed demangled
+ */
+void print_where(char **filenames, size_t count, const char *expression, int tables, bool json, struct demangler *demangler)
+{
+	assert(filenames != NULL);
+	assert(expression != NULL);
+
+	struct where_expression tree;
+	char message[WHERE_MESSAGE_SIZE];
+	int usable = 0;
+
+	parse_expression(expression, &tree);
+
+	for(size_t i = 0; i < sizeof(table_kinds) / sizeof(table_kinds[0]); i++)
+	{
+		const struct table_kind *kind = &table_kinds[i];
+
+		if(tables && !(tables & kind->id))
+			continue;
+
+		if(compile_expression(&tree, kind, message))
+			usable |= kind->id;
+		else if(tables)
+			error(EXIT_FAILURE, EINVAL, "--where \'%s\': %s", expression, message);
+	}
+
+	if(!usable)
+		error(EXIT_FAILURE, EINVAL, "--where \'%s\' fits no table: %s", expression, message);
+
+	for(size_t i = 0; i < count; i++)
+	{
+		if(!json && count > 1)
+			printf("%s%s:\n", i > 0 ? "\n" : "", filenames[i]);
+		where_file(filenames[i], &tree, usable, json, demangler);
+	}
+
+	free_expression(&tree);
+}
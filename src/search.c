@@ -0,0 +1,315 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include "misc.h"
+#include "image.h"
+#include "parallel.h"
+#include "matcher.h"
+#include "compressed.h"
+#include "section_header.h"
+#include "search.h"
+
+// big sections are split into ranges of this size, so one section can be
+// scanned by several threads
+#define SEARCH_RANGE_SIZE (1024 * 1024)
+
+struct search_hit {
+	size_t pattern;
+	uint64_t offset;
+};
+
+struct search_item {
+	size_t file;
+	Elf64_Shdr *section;
+	uint64_t start;
+	uint64_t end;
+	struct search_hit *hits;
+	size_t hit_count;
+	size_t hit_capacity;
+	int status;
+};
+
+struct search_file {
+	const char *filename;
+	struct elf_image image;
+	int status;
+};
+
+struct search {
+	struct pattern_matcher matcher;
+	struct search_file *files;
+	struct search_item *items;
+	size_t item_count;
+	size_t item_capacity;
+};
+
+// state for sections that are scanned chunk by chunk after decompression
+struct chunk_scan {
+	const struct pattern_matcher *matcher;
+	struct search_item *item;
+	unsigned char *buffer;
+	size_t buffer_size;
+	size_t carry;		// bytes kept from the previous chunk
+	uint64_t base;		// section offset of buffer[0]
+};
+
+static bool selector_matches(const struct elf_image *image, const Elf64_Shdr *section, const char *token, size_t length)
+{
+	if(length > 5 && strncmp(token, "type=", 5) == 0)
+	{
+		const char *type = get_section_header_type(section->sh_type);
+		size_t type_length = strcspn(type, " ");
+
+		return type_length == length - 5 && strncasecmp(type, token + 5, type_length) == 0;
+	}
+
+	if(length > 6 && strncmp(token, "flags=", 6) == 0)
+	{
+		char *flags = get_section_header_flags(section->sh_flags);
+		bool matches = true;
+
+		for(size_t i = 6; i < length; i++)
+			if(!strchr(flags, token[i]))
+				matches = false;
+
+		free(flags);
+		return matches;
+	}
+
+	const char *name = get_section_name(image, section);
+	return strlen(name) == length && strncmp(name, token, length) == 0;
+}
+
+// selector is a comma separated list of section names, "type=TYPE" or
+// "flags=FLAGS" entries; without selector every section with content is taken
+int section_is_selected(const struct elf_image *image, const Elf64_Shdr *section, const char *selector)
+{
+	assert(image != NULL);
+	assert(section != NULL);
+
+	if(section->sh_type == SHT_NULL || section->sh_type == SHT_NOBITS)
+		return 0;
+
+	if(!selector)
+		return 1;
+
+	while(*selector)
+	{
+		size_t length = strcspn(selector, ",");
+
+		if(length > 0 && selector_matches(image, section, selector, length))
+			return 1;
+
+		selector += length;
+		if(*selector == ',')
+			selector++;
+	}
+
+	return 0;
+}
+
+static void add_hit(size_t pattern, uint64_t offset, void *arg)
+{
+	struct search_item *item = arg;
+
+	if(item->hit_count == item->hit_capacity)
+	{
+		item->hit_capacity = item->hit_capacity ? item->hit_capacity * 2 : 16;
+		item->hits = realloc_wrap(item->hits, item->hit_capacity * sizeof(struct search_hit));
+	}
+
+	item->hits[item->hit_count].pattern = pattern;
+	item->hits[item->hit_count].offset = item->start + offset;
+	item->hit_count++;
+}
+
+static void add_chunk_hit(size_t pattern, uint64_t offset, void *arg)
+{
+	struct chunk_scan *scan = arg;
+
+	add_hit(pattern, scan->base + offset, scan->item);
+}
+
+static int scan_chunk(const unsigned char *chunk, size_t size, void *arg)
+{
+	struct chunk_scan *scan = arg;
+	size_t keep = scan->matcher->max_length - 1;
+	size_t length = scan->carry + size;
+
+	if(length > scan->buffer_size)
+	{
+		scan->buffer_size = length;
+		scan->buffer = realloc_wrap(scan->buffer, scan->buffer_size);
+	}
+
+	memcpy(scan->buffer + scan->carry, chunk, size);
+
+	// matches starting in the last max_length - 1 bytes may continue in the next chunk
+	if(length > keep)
+	{
+		match_patterns(scan->matcher, scan->buffer, length, length - keep, add_chunk_hit, scan);
+		memmove(scan->buffer, scan->buffer + length - keep, keep);
+		scan->base += length - keep;
+		scan->carry = keep;
+	}
+	else
+		scan->carry = length;
+
+	return 0;
+}
+
+static void scan_item(size_t index, void *arg)
+{
+	struct search *search = arg;
+	struct search_item *item = &search->items[index];
+	struct elf_image *image = &search->files[item->file].image;
+	unsigned char *data = NULL;
+
+	if(item->section->sh_flags & SHF_COMPRESSED)
+	{
+		struct chunk_scan scan = { &search->matcher, item, NULL, 0, 0, 0 };
+
+		item->status = read_section_chunks(image, item->section, scan_chunk, &scan);
+		match_patterns(&search->matcher, scan.buffer, scan.carry, scan.carry, add_chunk_hit, &scan);
+		free(scan.buffer);
+		return;
+	}
+
+	data = get_section_data(image, item->section);
+	if(!data)
+	{
+		item->status = EBADF;
+		return;
+	}
+
+	// the range is extended so matches crossing into the next range are found
+	uint64_t size = item->end - item->start + search->matcher.max_length - 1;
+	if(size > item->section->sh_size - item->start)
+		size = item->section->sh_size - item->start;
+
+	match_patterns(&search->matcher, data + item->start, (size_t)size, (size_t)(item->end - item->start), add_hit, item);
+}
+
+static void open_search_file(size_t index, void *arg)
+{
+	struct search_file *files = arg;
+
+	files[index].status = open_elf_image(&files[index].image, files[index].filename);
+}
+
+static void add_item(struct search *search, size_t file, Elf64_Shdr *section, uint64_t start, uint64_t end)
+{
+	struct search_item *item = NULL;
+
+	if(search->item_count == search->item_capacity)
+	{
+		search->item_capacity = search->item_capacity ? search->item_capacity * 2 : 64;
+		search->items = realloc_wrap(search->items, search->item_capacity * sizeof(struct search_item));
+	}
+
+	item = &search->items[search->item_count++];
+	memset(item, 0, sizeof(struct search_item));
+	item->file = file;
+	item->section = section;
+	item->start = start;
+	item->end = end;
+}
+
+static void print_search_hit(const struct search *search, const struct search_item *item, const struct search_hit *hit)
+{
+	const struct search_file *file = &search->files[item->file];
+	const char *name = get_section_name(&file->image, item->section);
+
+	if((item->section->sh_flags & SHF_ALLOC) && !(item->section->sh_flags & SHF_COMPRESSED))
+		printf("%s: %-18s %#018lx %#018lx %s\n", file->filename, name, hit->offset,
+			item->section->sh_addr + hit->offset, search->matcher.patterns[hit->pattern].text);
+	else
+		printf("%s: %-18s %#018lx %18s %s\n", file->filename, name, hit->offset,
+			"-", search->matcher.patterns[hit->pattern].text);
+}
+
+void search_files(char **filenames, size_t file_count, char **patterns, size_t pattern_count, const char *selector)
+{
+	assert(filenames != NULL);
+	assert(patterns != NULL);
+
+	struct search search;
+	size_t total = 0;
+
+	memset(&search, 0, sizeof(search));
+	init_matcher(&search.matcher, patterns, pattern_count);
+
+	search.files = malloc_wrap(sizeof(struct search_file) * file_count);
+	for(size_t i = 0; i < file_count; i++)
+		search.files[i].filename = filenames[i];
+
+	parallel_for(file_count, open_search_file, search.files);
+
+	for(size_t i = 0; i < file_count; i++)
+	{
+		struct elf_image *image = &search.files[i].image;
+
+		if(search.files[i].status != 0)
+		{
+			error(0, search.files[i].status, "\'%s\' is not a valid elf file", filenames[i]);
+			continue;
+		}
+
+		for(size_t j = 0; j < image->header.e_shnum; j++)
+		{
+			Elf64_Shdr *section = &image->section_headers[j];
+
+			if(!section_is_selected(image, section, selector))
+				continue;
+
+			// one item reports a section that is compressed or lies outside the file,
+			// whose sh_size must not decide how many ranges are made
+			if((section->sh_flags & SHF_COMPRESSED) || !get_section_data(image, section))
+			{
+				add_item(&search, i, section, 0, 0);
+				continue;
+			}
+
+			for(uint64_t start = 0; start < section->sh_size; start += SEARCH_RANGE_SIZE)
+			{
+				uint64_t end = start + SEARCH_RANGE_SIZE;
+				add_item(&search, i, section, start, end < section->sh_size ? end : section->sh_size);
+			}
+		}
+	}
+
+	parallel_for(search.item_count, scan_item, &search);
+
+	// items are in file, section and offset order, so is the output
+	for(size_t i = 0; i < search.item_count; i++)
+	{
+		struct search_item *item = &search.items[i];
+
+		if(item->status != 0)
+			error(0, item->status, "\'%s\': cannot read section \'%s\'", search.files[item->file].filename,
+				get_section_name(&search.files[item->file].image, item->section));
+
+		for(size_t j = 0; j < item->hit_count; j++)
+			print_search_hit(&search, item, &item->hits[j]);
+
+		total += item->hit_count;
+		free(item->hits);
+	}
+
+	printf("\n%zu matches in %zu files\n", total, file_count);
+
+	for(size_t i = 0; i < file_count; i++)
+		free_elf_image(&search.files[i].image);
+
+	free(search.items);
+	free(search.files);
+	free_matcher(&search.matcher);
+}
\ No newline at end of file
@@ -6,7 +6,10 @@
 #include <error.h>
 #include <assert.h>
 #include <sys/types.h>
+#include <stdint.h>
 #include "misc.h"
+#include "entropy.h"
+#include "section_header.h"
 
 enum {
 	ST_NULL = 0,
@@ -46,7 +49,7 @@ static const char * const section_header_type_names[] = {
 	"HIUSER  "
 };
 
-static const char* get_section_header_type(uint32_t type)
+const char* get_section_header_type(uint32_t type)
 {
 	switch(type)
 	{
@@ -87,9 +90,9 @@ static const char* get_section_header_type(uint32_t type)
 	}
 }
 
-static char* get_section_header_flags(uint64_t flags)
+char* get_section_header_flags(uint64_t flags)
 {
-	const size_t str_size = 7;	// 6 flags + \0
+	const size_t str_size = 8;	// 7 flags + \0
 	char *str = NULL;
 
 	str = malloc_wrap(str_size);
@@ -109,6 +112,8 @@ static char* get_section_header_flags(uint64_t flags)
 		str[4] = 'S';
 	if((flags & (1 << 6)) == SHF_INFO_LINK)
 		str[5] = 'I';
+	if((flags & (1 << 11)) == SHF_COMPRESSED)
+		str[6] = 'C';
 
 	return str;
 }
@@ -122,7 +127,7 @@ static void print_section32_header(Elf32_Shdr *section_header, char *strtab_buff
 	const char *section_type = get_section_header_type(section_header->sh_type);
 	char *section_flags = get_section_header_flags(section_header->sh_flags);
 
-	printf("  [%2zu] %-20s %-9s %08x %08x %08x %02x %6s %2d  %2d %2d\n",
+	printf("  [%2zu] %-20s %-9s %08x %08x %08x %02x %7s %2d  %2d %2d\n",
 		count_section,
 		section_name,
 		section_type,
@@ -138,7 +143,7 @@ static void print_section32_header(Elf32_Shdr *section_header, char *strtab_buff
 	free(section_flags);
 }
 
-static void print_section64_header(Elf64_Shdr *section_header, char *strtab_buffer, size_t count_section)
+static void print_section64_header(Elf64_Shdr *section_header, char *strtab_buffer, size_t count_section, const struct byte_stats *stats)
 {
 	assert(section_header != NULL);
 	assert(strtab_buffer != NULL);
@@ -154,7 +159,7 @@ static void print_section64_header(Elf64_Shdr *section_header, char *strtab_buff
 		section_header->sh_addr,
 		section_header->sh_offset);
 
-	printf("       %016lx   %016lx %6s  %2d   %2d     %2ld\n",
+	printf("       %016lx   %016lx %7s %2d   %2d     %2ld\n",
 		section_header->sh_size,
 		section_header->sh_entsize,
 		section_flags,
@@ -162,6 +167,15 @@ static void print_section64_header(Elf64_Shdr *section_header, char *strtab_buff
 		section_header->sh_info,
 		section_header->sh_addralign);
 
+	if(stats && stats->total > 0)
+		printf("       %7.3f %6.2f%% %02x (%5.2f%%)\n",
+			stats->entropy,
+			stats->compressibility * 100.0,
+			stats->top_byte,
+			100.0 * (double)stats->histogram[stats->top_byte] / (double)stats->total);
+	else if(stats)
+		printf("       -\n");
+
 	free(section_flags);
 }
 
@@ -172,15 +186,27 @@ char* read_section32_string_table(const char *filename, Elf32_Ehdr *elf_header,
 	assert(section_headers != NULL);
 
 	char *buffer = NULL;
+	size_t size;
 	FILE *fp = NULL;
 
-	buffer = malloc_wrap(section_headers[elf_header->e_shstrndx].sh_size);
+	// no string table: every name is empty
+	if(elf_header->e_shstrndx == SHN_UNDEF)
+	{
+		buffer = malloc_wrap(1);
+		buffer[0] = '\0';
+		return buffer;
+	}
+
+	size = (size_t)section_headers[elf_header->e_shstrndx].sh_size;
+	buffer = malloc_wrap(size + 1);
+	buffer[size] = '\0';
 
 	fp = fopen_wrap(filename, "rb");
 
 	fseek(fp, (ssize_t)section_headers[elf_header->e_shstrndx].sh_offset, SEEK_SET);
 
-	fread_wrap(buffer, section_headers[elf_header->e_shstrndx].sh_size, 1, fp);
+	if(size > 0)
+		fread_wrap(buffer, size, 1, fp);
 
 	fclose(fp);
 	return buffer;
@@ -193,15 +219,27 @@ char* read_section64_string_table(const char *filename, Elf64_Ehdr *elf_header,
 	assert(section_headers != NULL);
 
 	char *buffer = NULL;
+	size_t size;
 	FILE *fp = NULL;
 
-	buffer = malloc_wrap(section_headers[elf_header->e_shstrndx].sh_size);
+	// no string table: every name is empty
+	if(elf_header->e_shstrndx == SHN_UNDEF)
+	{
+		buffer = malloc_wrap(1);
+		buffer[0] = '\0';
+		return buffer;
+	}
+
+	size = (size_t)section_headers[elf_header->e_shstrndx].sh_size;
+	buffer = malloc_wrap(size + 1);
+	buffer[size] = '\0';
 
 	fp = fopen_wrap(filename, "rb");
 
 	fseek(fp, (ssize_t)section_headers[elf_header->e_shstrndx].sh_offset, SEEK_SET);
 
-	fread_wrap(buffer, section_headers[elf_header->e_shstrndx].sh_size, 1, fp);
+	if(size > 0)
+		fread_wrap(buffer, size, 1, fp);
 
 	fclose(fp);
 	return buffer;
@@ -216,15 +254,16 @@ Elf32_Shdr* read_section32_headers(const char *filename, Elf32_Ehdr *elf_header)
 	FILE *fp = NULL;
 	Elf32_Shdr *section_headers = NULL;
 
-	sections_size = elf_header->e_shentsize * elf_header->e_shnum;
+	sections_size = (size_t)elf_header->e_shentsize * elf_header->e_shnum;
 
-	section_headers = malloc_wrap(sections_size);
+	section_headers = malloc_wrap(sections_size ? sections_size : 1);
 
 	fp = fopen_wrap(filename, "rb");
 
 	fseek(fp, (ssize_t)elf_header->e_shoff, SEEK_SET);
 
-	fread_wrap(section_headers, sections_size, 1, fp);
+	if(sections_size > 0)
+		fread_wrap(section_headers, sections_size, 1, fp);
 
 	fclose(fp);
 
@@ -240,15 +279,16 @@ Elf64_Shdr* read_section64_headers(const char *filename, Elf64_Ehdr *elf_header)
 	FILE *fp = NULL;
 	Elf64_Shdr *section_headers = NULL;
 
-	sections_size = elf_header->e_shentsize * elf_header->e_shnum;
+	sections_size = (size_t)elf_header->e_shentsize * elf_header->e_shnum;
 
-	section_headers = malloc_wrap(sections_size);
+	section_headers = malloc_wrap(sections_size ? sections_size : 1);
 
 	fp = fopen_wrap(filename, "rb");
 
 	fseek(fp, (ssize_t)elf_header->e_shoff, SEEK_SET);
 
-	fread_wrap(section_headers, sections_size, 1, fp);
+	if(sections_size > 0)
+		fread_wrap(section_headers, sections_size, 1, fp);
 
 	fclose(fp);
 
@@ -264,24 +304,57 @@ void print_section32_headers(Elf32_Shdr *section_headers, Elf32_Ehdr *elf_header
 	printf("There are %d section headers, starting at offset %#04x\n\n", elf_header->e_shnum, elf_header->e_shoff);
 
 	printf("Section headers:\n");
-	printf("  [Nr] Name                 Type      Addr     Off      Size     ES Flg    Lk Inf Al\n");
+	printf("  [Nr] Name                 Type      Addr     Off      Size     ES Flg     Lk Inf Al\n");
 
 	for(size_t i = 0; i < elf_header->e_shnum; i++)
 		print_section32_header(&section_headers[i], strtab_buffer, i);
 }
 
 void print_section64_headers(Elf64_Shdr *section_headers, Elf64_Ehdr *elf_header, char *strtab_buffer)
+{
+	print_section64_headers_selected(section_headers, elf_header, strtab_buffer, NULL);
+}
+
+// prints the sections whose selected byte is set, or all of them when selected is NULL
+void print_section64_headers_selected(Elf64_Shdr *section_headers, Elf64_Ehdr *elf_header, char *strtab_buffer, const unsigned char *selected)
+{
+	assert(section_headers != NULL);
+	assert(elf_header != NULL);
+	assert(strtab_buffer != NULL);
+
+	size_t selected_count = 0;
+
+	for(size_t i = 0; selected && i < elf_header->e_shnum; i++)
+		selected_count += selected[i];
+
+	if(selected)
+		printf("%zu of %d section headers selected\n\n", selected_count, elf_header->e_shnum);
+	else
+		printf("There are %d section headers, starting at offset %#04lx\n\n", elf_header->e_shnum, elf_header->e_shoff);
+
+	printf("Section headers:\n");
+	printf("  [Nr] Name               Type             Address          Offset\n");
+	printf("       Size               EntSize          Flags Link Info  Align\n");
+
+	for(size_t i = 0; i < elf_header->e_shnum; i++)
+		if(!selected || selected[i])
+			print_section64_header(&section_headers[i], strtab_buffer, i, NULL);
+}
+
+void print_section64_headers_stats(Elf64_Shdr *section_headers, Elf64_Ehdr *elf_header, char *strtab_buffer, const struct byte_stats *stats)
 {
 	assert(section_headers != NULL);
 	assert(elf_header != NULL);
 	assert(strtab_buffer != NULL);
+	assert(stats != NULL);
 
 	printf("There are %d section headers, starting at offset %#04lx\n\n", elf_header->e_shnum, elf_header->e_shoff);
 
 	printf("Section headers:\n");
 	printf("  [Nr] Name               Type             Address          Offset\n");
 	printf("       Size               EntSize          Flags Link Info  Align\n");
+	printf("       Entropy EstSize TopByte\n");
 
 	for(size_t i = 0; i < elf_header->e_shnum; i++)
-		print_section64_header(&section_headers[i], strtab_buffer, i);
+		print_section64_header(&section_headers[i], strtab_buffer, i, &stats[i]);
 }
@@ -0,0 +1,953 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <signal.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "misc.h"
+#include "image.h"
+#include "parallel.h"
+#include "elf_header.h"
+#include "symbol.h"
+#include "dynamic.h"
+#include "serve.h"
+
+/*
+ * protocol: every message is a 4 byte little-endian length and a payload.
+ * a request payload is the query words separated by '\0' bytes, e.g.
+ * "symbol\0/usr/bin/ls\0main"; a response payload is one status byte
+ * (0 or an errno value) followed by text.
+ */
+#define SERVE_MESSAGE_MAX (1024 * 1024)
+#define SERVE_ARGS_MAX 8
+#define SERVE_QUEUE_SIZE 256
+// workers block on file reads while parsing, so the pool is not smaller than this
+#define SERVE_WORKERS_MIN 16
+// longest wait for the rest of a started request (or for the client to take the answer)
+#define SERVE_IO_TIMEOUT_SEC 5
+#define SERVE_EVENTS_MAX 64
+// mapped bytes kept in the cache, RELF_CACHE_MB overrides it
+#define SERVE_CACHE_DEFAULT_MB 1024
+// requests sent by every connection of --load
+#define SERVE_LOAD_REQUESTS 1000
+
+// name -> symbol hash index, built on the first symbol query of an image
+struct symbol_index {
+	struct symbol_table table;
+	uint32_t *slots;	// symbol index + 1, 0 is empty
+	size_t capacity;
+	bool loaded;
+	int status;
+};
+
+struct cache_entry {
+	char *path;
+	struct stat st;		// state of the mapped file, compared on every use
+	struct elf_image image;
+	int refs;
+	bool linked;		// still in the cache list, unlinked entries die with their last user
+	pthread_mutex_t lock;
+	struct symbol_index symbols;
+	struct cache_entry *prev;
+	struct cache_entry *next;
+};
+
+// least recently used images are dropped first when the mapped size exceeds limit
+struct image_cache {
+	pthread_mutex_t lock;
+	struct cache_entry *head;
+	struct cache_entry *tail;
+	size_t bytes;
+	size_t limit;
+	size_t count;
+	uint64_t hits;
+	uint64_t misses;
+};
+
+// connections with a request to read, waiting for a worker; the listener blocks when full
+struct connection_queue {
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	int fds[SERVE_QUEUE_SIZE];
+	size_t head;
+	size_t count;
+};
+
+struct server {
+	struct image_cache cache;
+	struct connection_queue queue;
+	int epoll_fd;		// idle connections, each armed for one request at a time
+};
+
+static const char *socket_path;
+
+static bool same_file(const struct stat *a, const struct stat *b)
+{
+	return a->st_dev == b->st_dev && a->st_ino == b->st_ino && a->st_size == b->st_size &&
+		a->st_mtim.tv_sec == b->st_mtim.tv_sec && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+static void free_entry(struct cache_entry *entry)
+{
+	free(entry->symbols.slots);
+	free_symbol_table(&entry->symbols.table);
+	free_elf_image(&entry->image);
+	pthread_mutex_destroy(&entry->lock);
+	free(entry->path);
+	free(entry);
+}
+
+static void unlink_entry(struct image_cache *cache, struct cache_entry *entry)
+{
+	if(entry->prev)
+		entry->prev->next = entry->next;
+	else
+		cache->head = entry->next;
+
+	if(entry->next)
+		entry->next->prev = entry->prev;
+	else
+		cache->tail = entry->prev;
+
+	entry->prev = entry->next = NULL;
+	entry->linked = false;
+	cache->bytes -= entry->image.mapping_size;
+	cache->count--;
+}
+
+static void link_entry(struct image_cache *cache, struct cache_entry *entry)
+{
+	entry->prev = NULL;
+	entry->next = cache->head;
+	if(cache->head)
+		cache->head->prev = entry;
+	else
+		cache->tail = entry;
+
+	cache->head = entry;
+	entry->linked = true;
+	cache->bytes += entry->image.mapping_size;
+	cache->count++;
+}
+
+static struct cache_entry* find_entry(struct image_cache *cache, const char *path)
+{
+	for(struct cache_entry *entry = cache->head; entry; entry = entry->next)
+		if(strcmp(entry->path, path) == 0)
+			return entry;
+
+	return NULL;
+}
+
+// drops unused entries from the cold end until the cache fits its limit
+static struct cache_entry* evict_entries(struct image_cache *cache)
+{
+	struct cache_entry *evicted = NULL;
+	struct cache_entry *entry = cache->tail;
+
+	while(entry && cache->bytes > cache->limit && entry != cache->head)
+	{
+		struct cache_entry *prev = entry->prev;
+
+		if(entry->refs == 0)
+		{
+			unlink_entry(cache, entry);
+			entry->next = evicted;
+			evicted = entry;
+		}
+
+		entry = prev;
+	}
+
+	return evicted;
+}
+
+static void free_entry_list(struct cache_entry *entry)
+{
+	while(entry)
+	{
+		struct cache_entry *next = entry->next;
+
+		free_entry(entry);
+		entry = next;
+	}
+}
+
+/*
+ * mapped and parsed image of path, taken from the cache while the file keeps
+ * its inode, size and mtime; files are mapped outside the cache lock so a
+ * slow load does not hold up other requests
+ */
+static struct cache_entry* acquire_image(struct image_cache *cache, const char *path, int *status)
+{
+	struct cache_entry *entry = NULL, *stale = NULL, *evicted = NULL;
+	struct stat st;
+
+	if(stat(path, &st) < 0)
+	{
+		*status = errno;
+		return NULL;
+	}
+
+	pthread_mutex_lock(&cache->lock);
+
+	entry = find_entry(cache, path);
+	if(entry && same_file(&entry->st, &st))
+	{
+		cache->hits++;
+		unlink_entry(cache, entry);
+		link_entry(cache, entry);
+		entry->refs++;
+		pthread_mutex_unlock(&cache->lock);
+		return entry;
+	}
+
+	if(entry)
+	{
+		unlink_entry(cache, entry);
+		if(entry->refs == 0)
+			stale = entry;
+	}
+
+	cache->misses++;
+	pthread_mutex_unlock(&cache->lock);
+
+	if(stale)
+		free_entry(stale);
+
+	entry = calloc(1, sizeof(struct cache_entry));
+	if(!entry)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	entry->path = strdup(path);
+	if(!entry->path)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+	pthread_mutex_init(&entry->lock, NULL);
+
+	*status = map_elf_image(&entry->image, entry->path, &entry->st);
+	if(*status != 0)
+	{
+		free_entry(entry);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&cache->lock);
+
+	// another request may have loaded the same file meanwhile
+	stale = find_entry(cache, path);
+	if(stale && same_file(&stale->st, &entry->st))
+	{
+		stale->refs++;
+		pthread_mutex_unlock(&cache->lock);
+		free_entry(entry);
+		return stale;
+	}
+	if(stale && stale->refs == 0)
+		unlink_entry(cache, stale);
+	else
+		stale = NULL;
+
+	entry->refs = 1;
+	link_entry(cache, entry);
+	evicted = evict_entries(cache);
+
+	pthread_mutex_unlock(&cache->lock);
+
+	if(stale)
+		free_entry(stale);
+	free_entry_list(evicted);
+
+	return entry;
+}
+
+static void release_image(struct image_cache *cache, struct cache_entry *entry)
+{
+	bool unused;
+
+	pthread_mutex_lock(&cache->lock);
+	unused = --entry->refs == 0 && !entry->linked;
+	pthread_mutex_unlock(&cache->lock);
+
+	if(unused)
+		free_entry(entry);
+}
+
+static void build_symbol_index(struct cache_entry *entry)
+{
+	struct symbol_index *index = &entry->symbols;
+	Elf64_Shdr *section = NULL;
+
+	index->loaded = true;
+
+	section = find_symbol_section(&entry->image);
+	if(!section)
+	{
+		index->status = ENOENT;
+		return;
+	}
+
+	index->status = load_symbol_table(&entry->image, section, &index->table);
+	if(index->status != 0)
+		return;
+
+	index->capacity = 16;
+	while(index->capacity < index->table.count * 2)
+		index->capacity *= 2;
+
+	index->slots = calloc(index->capacity, sizeof(uint32_t));
+	if(!index->slots)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	for(size_t i = 1; i < index->table.count; i++)
+	{
+		const char *name = get_symbol_name(&index->table, &index->table.symbols[i]);
+		size_t slot;
+
+		if(name[0] == '\0' || index->table.symbols[i].st_shndx == SHN_UNDEF)
+			continue;
+
+		slot = (size_t)hash_string(HASH_SEED, name) & (index->capacity - 1);
+		while(index->slots[slot])
+			slot = (slot + 1) & (index->capacity - 1);
+		index->slots[slot] = (uint32_t)i + 1;
+	}
+}
+
+static const Elf64_Sym* lookup_symbol(struct cache_entry *entry, const char *name, int *status)
+{
+	struct symbol_index *index = &entry->symbols;
+	const Elf64_Sym *found = NULL;
+
+	pthread_mutex_lock(&entry->lock);
+
+	if(!index->loaded)
+		build_symbol_index(entry);
+
+	*status = index->status;
+	if(index->status == 0)
+	{
+		size_t slot = (size_t)hash_string(HASH_SEED, name) & (index->capacity - 1);
+
+		for(; index->slots[slot] && !found; slot = (slot + 1) & (index->capacity - 1))
+		{
+			const Elf64_Sym *symbol = &index->table.symbols[index->slots[slot] - 1];
+
+			if(strcmp(get_symbol_name(&index->table, symbol), name) == 0)
+				found = symbol;
+		}
+
+		if(!found)
+			*status = ENOENT;
+	}
+
+	pthread_mutex_unlock(&entry->lock);
+	return found;
+}
+
+static int answer_header(const struct elf_image *image, FILE *out)
+{
+	fprintf(out, "class ELF%d\n", image->elf_class == ELFCLASS32 ? 32 : 64);
+	fprintf(out, "type %s\n", get_elf_type(image->header.e_type));
+	fprintf(out, "machine %s\n", get_elf_machine(image->header.e_machine));
+	fprintf(out, "entry %#lx\n", image->header.e_entry);
+	fprintf(out, "program headers %u\n", image->header.e_phnum);
+	fprintf(out, "sections %u\n", image->header.e_shnum);
+	return 0;
+}
+
+static int answer_needed(const struct elf_image *image, FILE *out)
+{
+	struct dynamic_table table;
+	int ret;
+
+	ret = load_dynamic_table(image, &table);
+	if(ret != 0)
+	{
+		fprintf(out, "no dynamic section\n");
+		return ret;
+	}
+
+	for(size_t i = 0; i < table.count; i++)
+	{
+		const char *name = NULL;
+
+		if(table.entries[i].d_tag != DT_NEEDED)
+			continue;
+
+		name = get_dynamic_string(&table, table.entries[i].d_un.d_val);
+		fprintf(out, "%s\n", name ? name : "??");
+	}
+
+	free_dynamic_table(&table);
+	return 0;
+}
+
+static int answer_build_id(const struct elf_image *image, FILE *out)
+{
+	const unsigned char *build_id = NULL;
+	size_t size = 0;
+
+	build_id = find_build_id(image, &size);
+	if(!build_id)
+	{
+		fprintf(out, "no build id\n");
+		return ENOENT;
+	}
+
+	for(size_t i = 0; i < size; i++)
+		fprintf(out, "%02x", build_id[i]);
+	fprintf(out, "\n");
+	return 0;
+}
+
+static int answer_symbol(struct cache_entry *entry, const char *name, FILE *out)
+{
+	const Elf64_Sym *symbol = NULL;
+	int status;
+
+	symbol = lookup_symbol(entry, name, &status);
+	if(!symbol)
+	{
+		fprintf(out, "no symbol \'%s\': %s\n", name, strerror(status));
+		return status;
+	}
+
+	fprintf(out, "%s %#018lx %lu type %u bind %u section %u\n",
+		name, symbol->st_value, symbol->st_size,
+		ELF64_ST_TYPE(symbol->st_info), ELF64_ST_BIND(symbol->st_info), symbol->st_shndx);
+	return 0;
+}
+
+static int answer_query(struct server *server, char **args, size_t count, FILE *out)
+{
+	struct cache_entry *entry = NULL;
+	int status = 0;
+
+	if(count == 1 && strcmp(args[0], "stats") == 0)
+	{
+		pthread_mutex_lock(&server->cache.lock);
+		fprintf(out, "images %zu\nbytes %zu\nlimit %zu\nhits %lu\nmisses %lu\n",
+			server->cache.count, server->cache.bytes, server->cache.limit,
+			server->cache.hits, server->cache.misses);
+		pthread_mutex_unlock(&server->cache.lock);
+		return 0;
+	}
+
+	if(count < 2 || (strcmp(args[0], "symbol") == 0) != (count == 3) || count > 3)
+	{
+		fprintf(out, "usage: header|needed|build-id PATH, symbol PATH NAME or stats\n");
+		return EINVAL;
+	}
+
+	entry = acquire_image(&server->cache, args[1], &status);
+	if(!entry)
+	{
+		fprintf(out, "cannot load \'%s\': %s\n", args[1], strerror(status));
+		return status;
+	}
+
+	if(strcmp(args[0], "header") == 0)
+		status = answer_header(&entry->image, out);
+	else if(strcmp(args[0], "needed") == 0)
+		status = answer_needed(&entry->image, out);
+	else if(strcmp(args[0], "build-id") == 0)
+		status = answer_build_id(&entry->image, out);
+	else if(strcmp(args[0], "symbol") == 0)
+		status = answer_symbol(entry, args[2], out);
+	else
+	{
+		fprintf(out, "unknown query \'%s\'\n", args[0]);
+		status = EINVAL;
+	}
+
+	release_image(&server->cache, entry);
+	return status;
+}
+
+static int read_full(int fd, void *buffer, size_t size)
+{
+	unsigned char *pos = buffer;
+
+	while(size > 0)
+	{
+		ssize_t ret = read(fd, pos, size);
+
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			return ret < 0 ? errno : EPIPE;
+
+		pos += ret;
+		size -= (size_t)ret;
+	}
+
+	return 0;
+}
+
+static int write_full(int fd, const void *buffer, size_t size)
+{
+	const unsigned char *pos = buffer;
+
+	while(size > 0)
+	{
+		ssize_t ret = send(fd, pos, size, MSG_NOSIGNAL);
+
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			return ret < 0 ? errno : EPIPE;
+
+		pos += ret;
+		size -= (size_t)ret;
+	}
+
+	return 0;
+}
+
+static int read_message(int fd, char **payload, size_t *size)
+{
+	unsigned char length[4];
+	int ret;
+
+	ret = read_full(fd, length, sizeof(length));
+	if(ret != 0)
+		return ret;
+
+	*size = (size_t)length[0] | (size_t)length[1] << 8 | (size_t)length[2] << 16 | (size_t)length[3] << 24;
+	if(*size > SERVE_MESSAGE_MAX)
+		return EMSGSIZE;
+
+	*payload = malloc_wrap(*size + 1);
+	(*payload)[*size] = '\0';
+
+	ret = read_full(fd, *payload, *size);
+	if(ret != 0)
+	{
+		free(*payload);
+		*payload = NULL;
+	}
+
+	return ret;
+}
+
+static int write_message(int fd, const char *head, size_t head_size, const char *payload, size_t size)
+{
+	unsigned char length[4];
+	size_t total = head_size + size;
+	int ret;
+
+	length[0] = (unsigned char)total;
+	length[1] = (unsigned char)(total >> 8);
+	length[2] = (unsigned char)(total >> 16);
+	length[3] = (unsigned char)(total >> 24);
+
+	ret = write_full(fd, length, sizeof(length));
+	if(ret == 0 && head_size > 0)
+		ret = write_full(fd, head, head_size);
+	if(ret == 0)
+		ret = write_full(fd, payload, size);
+
+	return ret;
+}
+
+// answers one request of a connection, false when the connection is done
+static bool serve_request(struct server *server, int fd)
+{
+	char *payload = NULL;
+	char *args[SERVE_ARGS_MAX];
+	size_t size, count = 0;
+	char *text = NULL;
+	size_t text_size = 0;
+	FILE *out = NULL;
+	char status;
+	int ret;
+
+	if(read_message(fd, &payload, &size) != 0)
+		return false;
+
+	for(size_t pos = 0; pos < size && count < SERVE_ARGS_MAX; pos += strlen(payload + pos) + 1)
+		args[count++] = payload + pos;
+
+	out = open_memstream(&text, &text_size);
+	if(!out)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	status = (char)answer_query(server, args, count, out);
+	fclose(out);
+
+	ret = write_message(fd, &status, 1, text, text_size);
+
+	free(text);
+	free(payload);
+	return ret == 0 && size > 0;
+}
+
+// the connection is handed to a worker again when its next request arrives
+static int watch_connection(struct server *server, int fd, int op)
+{
+	struct epoll_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN | EPOLLONESHOT;
+	event.data.fd = fd;
+
+	return epoll_ctl(server->epoll_fd, op, fd, &event);
+}
+
+static void* serve_worker(void *arg)
+{
+	struct server *server = arg;
+	struct connection_queue *queue = &server->queue;
+
+	for(;;)
+	{
+		int fd;
+
+		pthread_mutex_lock(&queue->lock);
+		while(queue->count == 0)
+			pthread_cond_wait(&queue->not_empty, &queue->lock);
+
+		fd = queue->fds[queue->head];
+		queue->head = (queue->head + 1) % SERVE_QUEUE_SIZE;
+		queue->count--;
+		pthread_cond_signal(&queue->not_full);
+		pthread_mutex_unlock(&queue->lock);
+
+		if(!serve_request(server, fd) || watch_connection(server, fd, EPOLL_CTL_MOD) != 0)
+			close(fd);
+	}
+
+	return NULL;
+}
+
+static void push_connection(struct connection_queue *queue, int fd)
+{
+	pthread_mutex_lock(&queue->lock);
+	while(queue->count == SERVE_QUEUE_SIZE)
+		pthread_cond_wait(&queue->not_full, &queue->lock);
+
+	queue->fds[(queue->head + queue->count) % SERVE_QUEUE_SIZE] = fd;
+	queue->count++;
+	pthread_cond_signal(&queue->not_empty);
+	pthread_mutex_unlock(&queue->lock);
+}
+
+static void handle_exit_signal(int sig)
+{
+	(void)sig;
+
+	unlink(socket_path);
+	_exit(EXIT_SUCCESS);
+}
+
+static void make_address(struct sockaddr_un *address, const char *path)
+{
+	memset(address, 0, sizeof(struct sockaddr_un));
+	address->sun_family = AF_UNIX;
+
+	if(strlen(path) >= sizeof(address->sun_path))
+		error(EXIT_FAILURE, ENAMETOOLONG, "socket path \'%s\'", path);
+	strcpy(address->sun_path, path);
+}
+
+static void accept_connection(struct server *server, int fd)
+{
+	struct timeval timeout = { SERVE_IO_TIMEOUT_SEC, 0 };
+	int client = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+
+	if(client < 0)
+	{
+		if(errno == EINTR || errno == EAGAIN || errno == ECONNABORTED || errno == EMFILE || errno == ENFILE)
+			return;
+		error(EXIT_FAILURE, errno, "cannot accept connection");
+	}
+
+	// a client that stops in the middle of a message gives its worker back
+	if(setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0 ||
+		setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0 ||
+		watch_connection(server, client, EPOLL_CTL_ADD) < 0)
+		close(client);
+}
+
+/*
+ * answers queries on a unix socket until killed: the listening thread waits
+ * on all connections and hands every request to a pool of workers, which
+ * share one cache of mapped images; idle connections hold no worker
+ */
+void serve_queries(const char *path)
+{
+	assert(path != NULL);
+
+	struct server server;
+	struct sockaddr_un address;
+	struct stat st;
+	struct epoll_event listen_event;
+	const char *env = NULL;
+	size_t thread_count;
+	int fd;
+
+	memset(&server, 0, sizeof(server));
+	pthread_mutex_init(&server.cache.lock, NULL);
+	pthread_mutex_init(&server.queue.lock, NULL);
+	pthread_cond_init(&server.queue.not_empty, NULL);
+	pthread_cond_init(&server.queue.not_full, NULL);
+
+	env = getenv("RELF_CACHE_MB");
+	server.cache.limit = (size_t)(env && atol(env) > 0 ? atol(env) : SERVE_CACHE_DEFAULT_MB) * 1024 * 1024;
+
+	make_address(&address, path);
+
+	// a socket left by a server that is gone is replaced
+	if(stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(fd < 0)
+		error(EXIT_FAILURE, errno, "cannot create socket");
+	if(bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0)
+		error(EXIT_FAILURE, errno, "cannot bind socket \'%s\'", path);
+	if(listen(fd, SOMAXCONN) < 0)
+		error(EXIT_FAILURE, errno, "cannot listen on socket \'%s\'", path);
+
+	server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if(server.epoll_fd < 0)
+		error(EXIT_FAILURE, errno, "cannot create epoll instance");
+	memset(&listen_event, 0, sizeof(listen_event));
+	listen_event.events = EPOLLIN;
+	listen_event.data.fd = fd;
+	if(epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, fd, &listen_event) < 0)
+		error(EXIT_FAILURE, errno, "cannot watch socket \'%s\'", path);
+
+	socket_path = path;
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, handle_exit_signal);
+	signal(SIGTERM, handle_exit_signal);
+
+	thread_count = get_thread_count();
+	if(thread_count < SERVE_WORKERS_MIN)
+		thread_count = SERVE_WORKERS_MIN;
+	for(size_t i = 0; i < thread_count; i++)
+	{
+		pthread_t thread;
+
+		if(pthread_create(&thread, NULL, serve_worker, &server) != 0)
+			error(EXIT_FAILURE, errno, "cannot create thread");
+		pthread_detach(thread);
+	}
+
+	for(;;)
+	{
+		struct epoll_event events[SERVE_EVENTS_MAX];
+		int ready = epoll_wait(server.epoll_fd, events, SERVE_EVENTS_MAX, -1);
+
+		if(ready < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			error(EXIT_FAILURE, errno, "cannot wait for connections");
+		}
+
+		for(int i = 0; i < ready; i++)
+		{
+			if(events[i].data.fd == fd)
+				accept_connection(&server, fd);
+			else
+				push_connection(&server.queue, events[i].data.fd);
+		}
+	}
+}
+
+static int connect_server(const char *path)
+{
+	struct sockaddr_un address;
+	int fd;
+
+	make_address(&address, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(fd < 0)
+		error(EXIT_FAILURE, errno, "cannot create socket");
+	if(connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0)
+		error(EXIT_FAILURE, errno, "cannot connect to \'%s\'", path);
+
+	return fd;
+}
+
+static char* make_request(char **args, size_t count, size_t *size)
+{
+	char *request = NULL;
+
+	*size = 0;
+	for(size_t i = 0; i < count; i++)
+		*size += strlen(args[i]) + 1;
+
+	request = malloc_wrap(*size + 1);
+	*size = 0;
+	for(size_t i = 0; i < count; i++)
+	{
+		strcpy(request + *size, args[i]);
+		*size += strlen(args[i]) + 1;
+	}
+
+	return request;
+}
+
+static int send_request(int fd, const char *request, size_t size, char **response, size_t *response_size)
+{
+	int ret;
+
+	ret = write_message(fd, NULL, 0, request, size);
+	if(ret == 0)
+		ret = read_message(fd, response, response_size);
+	if(ret == 0 && *response_size == 0)
+	{
+		free(*response);
+		ret = EBADMSG;
+	}
+
+	return ret;
+}
+
+struct load_client {
+	const char *path;
+	const char *request;
+	size_t size;
+	double *latencies;
+	int status;
+};
+
+static void* load_worker(void *arg)
+{
+	struct load_client *client = arg;
+	int fd;
+
+	fd = connect_server(client->path);
+
+	for(size_t i = 0; i < SERVE_LOAD_REQUESTS && client->status == 0; i++)
+	{
+		char *response = NULL;
+		size_t response_size = 0;
+		uint64_t start = get_time_ns();
+
+		client->status = send_request(fd, client->request, client->size, &response, &response_size);
+		client->latencies[i] = (double)(get_time_ns() - start) / 1e3;
+
+		if(client->status == 0)
+		{
+			client->status = (unsigned char)response[0];
+			free(response);
+		}
+	}
+
+	close(fd);
+	return NULL;
+}
+
+static int compare_latencies(const void *a, const void *b)
+{
+	double la = *(const double*)a;
+	double lb = *(const double*)b;
+
+	return (la > lb) - (la < lb);
+}
+
+// runs the query from many connections at once and prints latency percentiles
+static void run_load(const char *path, const char *request, size_t size, size_t connections)
+{
+	struct load_client *clients = NULL;
+	pthread_t *threads = NULL;
+	double *latencies = NULL;
+	size_t total = connections * SERVE_LOAD_REQUESTS;
+	uint64_t start;
+	double elapsed;
+
+	clients = calloc(connections, sizeof(struct load_client));
+	threads = calloc(connections, sizeof(pthread_t));
+	latencies = calloc(total, sizeof(double));
+	if(!clients || !threads || !latencies)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	start = get_time_ns();
+	for(size_t i = 0; i < connections; i++)
+	{
+		clients[i].path = path;
+		clients[i].request = request;
+		clients[i].size = size;
+		clients[i].latencies = latencies + i * SERVE_LOAD_REQUESTS;
+
+		if(pthread_create(&threads[i], NULL, load_worker, &clients[i]) != 0)
+			error(EXIT_FAILURE, errno, "cannot create thread");
+	}
+
+	for(size_t i = 0; i < connections; i++)
+	{
+		pthread_join(threads[i], NULL);
+		if(clients[i].status != 0)
+			error(EXIT_FAILURE, clients[i].status, "query failed");
+	}
+	elapsed = (double)(get_time_ns() - start) / 1e3;
+
+	qsort(latencies, total, sizeof(double), compare_latencies);
+
+	printf("%zu requests over %zu connections in %.3f s, %.0f requests/s\n",
+		total, connections, elapsed / 1e6, (double)total / (elapsed / 1e6));
+	printf("latency p50 %.1f us, p99 %.1f us, max %.1f us\n",
+		latencies[total / 2], latencies[total * 99 / 100], latencies[total - 1]);
+
+	free(latencies);
+	free(threads);
+	free(clients);
+}
+
+/*
+ * sends one query to a running server and prints the answer, or with
+ * connections > 0 runs it as a load test; returns the status of the answer
+ */
+int query_server(const char *path, char **args, size_t count, size_t connections)
+{
+	assert(path != NULL);
+
+	char *request = NULL, *response = NULL;
+	size_t size, response_size = 0;
+	int fd, ret;
+
+	if(count == 0)
+		error(EXIT_FAILURE, EINVAL, "you did not provide a query");
+
+	request = make_request(args, count, &size);
+
+	if(connections > 0)
+	{
+		run_load(path, request, size, connections);
+		free(request);
+		return 0;
+	}
+
+	fd = connect_server(path);
+	ret = send_request(fd, request, size, &response, &response_size);
+	close(fd);
+	free(request);
+
+	if(ret != 0)
+		error(EXIT_FAILURE, ret, "no answer from \'%s\'", path);
+
+	ret = (unsigned char)response[0];
+	fwrite(response + 1, 1, response_size - 1, ret == 0 ? stdout : stderr);
+
+	free(response);
+	return ret;
+}
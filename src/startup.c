@@ -0,0 +1,717 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include <glob.h>
+#include <libgen.h>
+#include <sys/stat.h>
+#include "misc.h"
+#include "image.h"
+#include "symbol.h"
+#include "dynamic.h"
+#include "startup.h"
+
+#define LD_SO_CONF "/etc/ld.so.conf"
+#define LD_SO_CONF_DEPTH 8
+
+enum {
+	ARRAY_PREINIT = 0,
+	ARRAY_INIT,
+	ARRAY_CTORS,
+	ARRAY_COUNT
+};
+
+static const char * const array_names[ARRAY_COUNT] = {
+	".preinit_array",
+	".init_array",
+	".ctors"
+};
+
+// an initializer: an address, or an offset into a section of a relocatable file
+struct init_entry {
+	uint64_t value;
+	uint16_t section;
+	const char *symbol;	// symbol named by the relocation, if any
+};
+
+struct init_array {
+	const Elf64_Shdr *section;
+	struct init_entry *entries;
+	size_t count;
+};
+
+struct startup_info {
+	struct init_array arrays[ARRAY_COUNT];
+	size_t initializers;		// entries of all arrays, without .ctors sentinels
+	uint64_t array_bytes;
+	bool has_init;
+	uint64_t init_function;		// DT_INIT
+	bool has_tls;
+	uint64_t tls_size;		// PT_TLS memsz, bytes of every thread's block
+	uint64_t tls_align;
+	uint64_t tdata_size;
+	uint64_t tbss_size;
+};
+
+struct string_list {
+	char **items;
+	size_t count;
+	size_t capacity;
+};
+
+// DT_NEEDED closure, objects in the order they were found
+struct closure {
+	struct string_list paths;
+	struct string_list names;	// of the objects in paths
+	struct string_list missing;
+	struct string_list dirs;	// LD_LIBRARY_PATH, ld.so.conf and default directories
+	int elf_class;
+	uint16_t machine;
+};
+
+static uint64_t read_address(const struct elf_image *image, const unsigned char *data)
+{
+	if(image->elf_class == ELFCLASS32)
+	{
+		uint32_t value;
+
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+	else
+	{
+		uint64_t value;
+
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+}
+
+static void read_relocation(const struct elf_image *image, const unsigned char *data, bool is_rela, uint64_t *offset, uint64_t *symbol, int64_t *addend)
+{
+	*addend = 0;
+
+	if(image->elf_class == ELFCLASS32)
+	{
+		Elf32_Rela rela;
+
+		memcpy(&rela, data, is_rela ? sizeof(Elf32_Rela) : sizeof(Elf32_Rel));
+		*offset = rela.r_offset;
+		*symbol = ELF32_R_SYM(rela.r_info);
+		if(is_rela)
+			*addend = rela.r_addend;
+	}
+	else
+	{
+		Elf64_Rela rela;
+
+		memcpy(&rela, data, is_rela ? sizeof(Elf64_Rela) : sizeof(Elf64_Rel));
+		*offset = rela.r_offset;
+		*symbol = ELF64_R_SYM(rela.r_info);
+		if(is_rela)
+			*addend = rela.r_addend;
+	}
+}
+
+/*
+ * fills in the entries that relocations write: RELATIVE ones of shared
+ * objects and pies (symbol 0, the addend is the address) and, in
+ * relocatable files, the section symbol + offset of every constructor
+ */
+static void apply_relocations(const struct elf_image *image, size_t array_index, struct init_array *array)
+{
+	bool is_relocatable = image->header.e_type == ET_REL;
+	size_t word = image->elf_class == ELFCLASS32 ? 4 : 8;
+	uint64_t base = is_relocatable ? 0 : array->section->sh_addr;
+
+	for(size_t i = 0; i < image->header.e_shnum; i++)
+	{
+		const Elf64_Shdr *section = &image->section_headers[i];
+		bool is_rela = section->sh_type == SHT_RELA;
+		size_t entsize;
+		const unsigned char *data = NULL;
+		struct symbol_table symbols;
+		bool has_symbols = false;
+
+		if(section->sh_type != SHT_RELA && section->sh_type != SHT_REL)
+			continue;
+		if(is_relocatable ? section->sh_info != array_index : !(section->sh_flags & SHF_ALLOC))
+			continue;
+
+		if(image->elf_class == ELFCLASS32)
+			entsize = is_rela ? sizeof(Elf32_Rela) : sizeof(Elf32_Rel);
+		else
+			entsize = is_rela ? sizeof(Elf64_Rela) : sizeof(Elf64_Rel);
+
+		data = get_section_data(image, section);
+		if(!data)
+			continue;
+
+		for(size_t j = 0; j + 1 <= section->sh_size / entsize; j++)
+		{
+			uint64_t offset, symbol_index, slot;
+			int64_t addend;
+			struct init_entry *entry = NULL;
+
+			read_relocation(image, data + j * entsize, is_rela, &offset, &symbol_index, &addend);
+			if(offset < base || offset - base >= array->section->sh_size || (offset - base) % word != 0)
+				continue;
+
+			slot = (offset - base) / word;
+			if(slot >= array->count)
+				continue;
+			entry = &array->entries[slot];
+
+			// REL keeps the addend in the word itself
+			if(is_rela)
+				entry->value = (uint64_t)addend;
+
+			if(symbol_index == 0)
+				continue;
+
+			if(!has_symbols)
+			{
+				if(section->sh_link >= image->header.e_shnum ||
+					load_symbol_table(image, &image->section_headers[section->sh_link], &symbols) != 0)
+					break;
+				has_symbols = true;
+			}
+			if(symbol_index >= symbols.count)
+				continue;
+
+			if(ELF64_ST_TYPE(symbols.symbols[symbol_index].st_info) == STT_SECTION)
+				entry->section = symbols.symbols[symbol_index].st_shndx;
+			else
+			{
+				entry->symbol = get_symbol_name(&symbols, &symbols.symbols[symbol_index]);
+				if(!is_relocatable)
+					entry->value += symbols.symbols[symbol_index].st_value;
+			}
+		}
+
+		if(has_symbols)
+			free_symbol_table(&symbols);
+	}
+}
+
+static void read_init_array(const struct elf_image *image, size_t index, size_t kind, struct startup_info *info)
+{
+	struct init_array *array = &info->arrays[kind];
+	const Elf64_Shdr *section = &image->section_headers[index];
+	size_t word = image->elf_class == ELFCLASS32 ? 4 : 8;
+	const unsigned char *data = NULL;
+
+	if(array->section)
+		return;
+
+	array->section = section;
+	array->count = section->sh_size / word;
+	array->entries = calloc(array->count + 1, sizeof(struct init_entry));
+	if(!array->entries)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	data = get_section_data(image, section);
+	for(size_t i = 0; data && i < array->count; i++)
+		array->entries[i].value = read_address(image, data + i * word);
+
+	apply_relocations(image, index, array);
+
+	info->array_bytes += section->sh_size;
+	for(size_t i = 0; i < array->count; i++)
+	{
+		uint64_t value = array->entries[i].value;
+
+		// .ctors starts with -1 and ends with 0
+		if(kind == ARRAY_CTORS && !array->entries[i].symbol && !array->entries[i].section &&
+			(value == 0 || value == (word == 4 ? UINT32_MAX : UINT64_MAX)))
+			continue;
+		info->initializers++;
+	}
+}
+
+static void read_startup_info(const struct elf_image *image, struct startup_info *info)
+{
+	struct dynamic_table dynamic;
+
+	memset(info, 0, sizeof(struct startup_info));
+
+	for(size_t i = 0; i < image->header.e_shnum; i++)
+	{
+		const Elf64_Shdr *section = &image->section_headers[i];
+		const char *name = get_section_name(image, section);
+
+		if(section->sh_type == SHT_PREINIT_ARRAY)
+			read_init_array(image, i, ARRAY_PREINIT, info);
+		else if(section->sh_type == SHT_INIT_ARRAY)
+			read_init_array(image, i, ARRAY_INIT, info);
+		else if(section->sh_type == SHT_PROGBITS && strcmp(name, ".ctors") == 0)
+			read_init_array(image, i, ARRAY_CTORS, info);
+
+		if(section->sh_flags & SHF_TLS)
+		{
+			if(section->sh_type == SHT_NOBITS)
+				info->tbss_size += section->sh_size;
+			else
+				info->tdata_size += section->sh_size;
+			if(section->sh_addralign > info->tls_align)
+				info->tls_align = section->sh_addralign;
+		}
+	}
+
+	for(size_t i = 0; i < image->header.e_phnum; i++)
+	{
+		const Elf64_Phdr *segment = &image->program_headers[i];
+
+		if(segment->p_type != PT_TLS)
+			continue;
+
+		info->has_tls = true;
+		info->tls_size = segment->p_memsz;
+		// the segment alignment wins over the one of its sections
+		info->tls_align = segment->p_align;
+		// files without section headers
+		if(image->header.e_shnum == 0)
+		{
+			info->tdata_size = segment->p_filesz;
+			info->tbss_size = segment->p_memsz - segment->p_filesz;
+		}
+	}
+
+	if(!info->has_tls && info->tdata_size + info->tbss_size > 0)
+	{
+		info->has_tls = true;
+		info->tls_size = info->tdata_size + info->tbss_size;
+	}
+
+	if(load_dynamic_table(image, &dynamic) == 0)
+	{
+		for(size_t i = 0; i < dynamic.count; i++)
+		{
+			if(dynamic.entries[i].d_tag == DT_INIT)
+			{
+				info->has_init = true;
+				info->init_function = dynamic.entries[i].d_un.d_ptr;
+			}
+		}
+		free_dynamic_table(&dynamic);
+	}
+}
+
+static void free_startup_info(struct startup_info *info)
+{
+	for(size_t i = 0; i < ARRAY_COUNT; i++)
+		free(info->arrays[i].entries);
+	memset(info, 0, sizeof(struct startup_info));
+}
+
+// the function symbol covering address, or the one at offset of section in relocatable files
+static const char* find_function(const struct symbol_table *symbols, const struct init_entry *entry, uint64_t *offset)
+{
+	const Elf64_Sym *best = NULL;
+
+	for(size_t i = 0; symbols && i < symbols->count; i++)
+	{
+		const Elf64_Sym *symbol = &symbols->symbols[i];
+		unsigned int type = ELF64_ST_TYPE(symbol->st_info);
+
+		if(symbol->st_shndx == SHN_UNDEF || (type != STT_FUNC && type != STT_NOTYPE && type != STT_GNU_IFUNC))
+			continue;
+		if(entry->section && symbol->st_shndx != entry->section)
+			continue;
+		if(entry->value < symbol->st_value || (entry->value > symbol->st_value && entry->value - symbol->st_value >= symbol->st_size))
+			continue;
+
+		// prefer a sized function starting right at the address
+		if(!best || (symbol->st_value == entry->value && (best->st_value != entry->value || type == STT_FUNC)))
+			best = symbol;
+	}
+
+	if(!best)
+		return NULL;
+
+	*offset = entry->value - best->st_value;
+	return get_symbol_name(symbols, best);
+}
+
+static void print_init_array(const struct elf_image *image, const struct init_array *array, const char *name, const struct symbol_table *symbols)
+{
+	size_t word = image->elf_class == ELFCLASS32 ? 4 : 8;
+
+	if(!array->section)
+	{
+		printf("  %s: none\n", name);
+		return;
+	}
+
+	printf("  %s: %zu entries (%lu bytes)\n", name, array->count, array->section->sh_size);
+
+	for(size_t i = 0; i < array->count; i++)
+	{
+		const struct init_entry *entry = &array->entries[i];
+		const char *function = entry->symbol;
+		uint64_t offset = 0;
+
+		if(!function)
+			function = find_function(symbols, entry, &offset);
+
+		if(entry->section)
+			printf("    [%2zu] %s+%#lx", i, get_section_name(image, &image->section_headers[entry->section < image->header.e_shnum ? entry->section : 0]), entry->value);
+		else
+			printf("    [%2zu] 0x%0*lx", i, (int)word * 2, entry->value);
+
+		if(function && offset)
+			printf(" %s+%#lx\n", function, offset);
+		else if(function)
+			printf(" %s\n", function);
+		else
+			printf("%s\n", entry->value == 0 || entry->value == (word == 4 ? UINT32_MAX : UINT64_MAX) ? " (sentinel)" : "");
+	}
+}
+
+static void print_startup_file(const char *filename)
+{
+	struct elf_image image;
+	struct startup_info info;
+	struct symbol_table symbols;
+	const Elf64_Shdr *symbol_section = NULL;
+	bool has_symbols = false;
+	int ret;
+
+	ret = open_elf_image(&image, filename);
+	if(ret != 0)
+	{
+		error(0, ret, "\'%s\' is not a valid elf file", filename);
+		free_elf_image(&image);
+		return;
+	}
+
+	read_startup_info(&image, &info);
+
+	symbol_section = find_symbol_section(&image);
+	if(symbol_section && load_symbol_table(&image, symbol_section, &symbols) == 0)
+		has_symbols = true;
+
+	printf("Startup of \'%s\':\n", filename);
+	for(size_t i = 0; i < ARRAY_COUNT; i++)
+		print_init_array(&image, &info.arrays[i], array_names[i], has_symbols ? &symbols : NULL);
+
+	if(info.has_init)
+	{
+		struct init_entry entry = { info.init_function, 0, NULL };
+		uint64_t offset = 0;
+		const char *function = find_function(has_symbols ? &symbols : NULL, &entry, &offset);
+
+		printf("  DT_INIT: %#lx%s%s\n", info.init_function, function ? " " : "", function ? function : "");
+	}
+
+	if(info.has_tls)
+		printf("  TLS: %lu bytes per thread (.tdata %lu, .tbss %lu), align %lu\n",
+			info.tls_size, info.tdata_size, info.tbss_size, info.tls_align);
+	else
+		printf("  TLS: none\n");
+
+	printf("  Total: %zu initializers in %lu bytes of arrays%s, %lu bytes of TLS\n\n",
+		info.initializers, info.array_bytes, info.has_init ? " plus DT_INIT" : "", info.tls_size);
+
+	if(has_symbols)
+		free_symbol_table(&symbols);
+	free_startup_info(&info);
+	free_elf_image(&image);
+}
+
+// the list takes str over
+static void append_string(struct string_list *list, char *str)
+{
+	if(!str)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	if(list->count == list->capacity)
+	{
+		list->capacity = list->capacity ? list->capacity * 2 : 16;
+		list->items = realloc_wrap(list->items, sizeof(char*) * list->capacity);
+	}
+	list->items[list->count++] = str;
+}
+
+static void add_string(struct string_list *list, const char *str, size_t length)
+{
+	append_string(list, strndup(str, length));
+}
+
+static void free_string_list(struct string_list *list)
+{
+	for(size_t i = 0; i < list->count; i++)
+		free(list->items[i]);
+	free(list->items);
+	memset(list, 0, sizeof(struct string_list));
+}
+
+static void add_path_list(struct string_list *list, const char *paths, const char *origin)
+{
+	while(paths && *paths)
+	{
+		size_t length = strcspn(paths, ":");
+
+		if(length > 0 && strncmp(paths, "$ORIGIN", 7) == 0)
+		{
+			char *dir = NULL;
+
+			if(asprintf(&dir, "%s%.*s", origin, (int)length - 7, paths + 7) < 0)
+				error(EXIT_FAILURE, errno, "cannot allocate memory");
+			append_string(list, dir);
+		}
+		else if(length > 0)
+			add_string(list, paths, length);
+
+		paths += length;
+		if(*paths == ':')
+			paths++;
+	}
+}
+
+// directories of ld.so.conf, following its include lines
+static void read_ld_so_conf(struct closure *closure, const char *filename, int depth)
+{
+	char *line = NULL;
+	size_t size = 0;
+	FILE *fp = NULL;
+
+	if(depth > LD_SO_CONF_DEPTH)
+		return;
+
+	fp = fopen(filename, "r");
+	if(!fp)
+		return;
+
+	while(getline(&line, &size, fp) != -1)
+	{
+		char *pos = line + strspn(line, " \t");
+
+		pos[strcspn(pos, "#\r\n")] = '\0';
+		while(*pos && (pos[strlen(pos) - 1] == ' ' || pos[strlen(pos) - 1] == '\t'))
+			pos[strlen(pos) - 1] = '\0';
+
+		if(strncmp(pos, "include", 7) == 0 && (pos[7] == ' ' || pos[7] == '\t'))
+		{
+			char *pattern = NULL;
+			glob_t files;
+
+			pos += 7 + strspn(pos + 7, " \t");
+			if(asprintf(&pattern, "%s%s", pos[0] == '/' ? "" : "/etc/", pos) < 0)
+				error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+			if(glob(pattern, 0, NULL, &files) == 0)
+			{
+				for(size_t i = 0; i < files.gl_pathc; i++)
+					read_ld_so_conf(closure, files.gl_pathv[i], depth + 1);
+				globfree(&files);
+			}
+			free(pattern);
+		}
+		else if(pos[0] == '/')
+			add_string(&closure->dirs, pos, strlen(pos));
+	}
+
+	free(line);
+	fclose(fp);
+}
+
+static bool is_matching_object(const struct closure *closure, const char *path)
+{
+	struct elf_image image;
+	struct stat st;
+	bool matches;
+
+	matches = map_elf_image(&image, path, &st) == 0 &&
+		image.elf_class == closure->elf_class && image.header.e_machine == closure->machine;
+	free_elf_image(&image);
+
+	return matches;
+}
+
+// path of a DT_NEEDED library the way ld.so looks for it, NULL if not found
+static char* find_library(const struct closure *closure, const char *name, const struct string_list *run_dirs)
+{
+	char *path = NULL;
+
+	if(strchr(name, '/'))
+		return is_matching_object(closure, name) ? strdup(name) : NULL;
+
+	for(size_t i = 0; i < run_dirs->count + closure->dirs.count; i++)
+	{
+		const char *dir = i < run_dirs->count ? run_dirs->items[i] : closure->dirs.items[i - run_dirs->count];
+
+		if(asprintf(&path, "%s/%s", dir, name) < 0)
+			error(EXIT_FAILURE, errno, "cannot allocate memory");
+		if(is_matching_object(closure, path))
+			return path;
+		free(path);
+	}
+
+	return NULL;
+}
+
+static bool has_string(const struct string_list *list, const char *str)
+{
+	for(size_t i = 0; i < list->count; i++)
+		if(strcmp(list->items[i], str) == 0)
+			return true;
+
+	return false;
+}
+
+// queues the DT_NEEDED libraries of an object that were not seen yet
+static void add_needed(struct closure *closure, const struct elf_image *image, const char *path)
+{
+	struct dynamic_table dynamic;
+	struct string_list run_dirs = {NULL, 0, 0};
+	const char *rpath = NULL, *runpath = NULL;
+	char *origin = NULL;
+
+	if(load_dynamic_table(image, &dynamic) != 0)
+		return;
+
+	origin = strdup(path);
+	if(!origin)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	for(size_t i = 0; i < dynamic.count; i++)
+	{
+		if(dynamic.entries[i].d_tag == DT_RPATH)
+			rpath = get_dynamic_string(&dynamic, dynamic.entries[i].d_un.d_val);
+		else if(dynamic.entries[i].d_tag == DT_RUNPATH)
+			runpath = get_dynamic_string(&dynamic, dynamic.entries[i].d_un.d_val);
+	}
+	// DT_RPATH is ignored when DT_RUNPATH is present
+	add_path_list(&run_dirs, runpath ? runpath : rpath, dirname(origin));
+
+	for(size_t i = 0; i < dynamic.count; i++)
+	{
+		const char *name = NULL;
+		char *library = NULL;
+
+		if(dynamic.entries[i].d_tag != DT_NEEDED)
+			continue;
+
+		name = get_dynamic_string(&dynamic, dynamic.entries[i].d_un.d_val);
+		if(!name || has_string(&closure->names, name) || has_string(&closure->missing, name))
+			continue;
+
+		library = find_library(closure, name, &run_dirs);
+		if(library)
+		{
+			add_string(&closure->names, name, strlen(name));
+			append_string(&closure->paths, library);
+		}
+		else
+			add_string(&closure->missing, name, strlen(name));
+	}
+
+	free_string_list(&run_dirs);
+	free(origin);
+	free_dynamic_table(&dynamic);
+}
+
+static void free_closure(struct closure *closure)
+{
+	free_string_list(&closure->paths);
+	free_string_list(&closure->names);
+	free_string_list(&closure->missing);
+	free_string_list(&closure->dirs);
+}
+
+/*
+ * walks the DT_NEEDED closure of filename breadth first and prints the
+ * initializer and TLS totals of every object and of the whole process
+ */
+static void print_startup_closure(const char *filename)
+{
+	struct closure closure;
+	struct elf_image image;
+	struct stat st;
+	size_t total_initializers = 0, init_functions = 0;
+	uint64_t total_array_bytes = 0, total_tls = 0;
+	int ret;
+
+	memset(&closure, 0, sizeof(closure));
+
+	ret = map_elf_image(&image, filename, &st);
+	if(ret != 0)
+	{
+		error(0, ret, "\'%s\' is not a valid elf file", filename);
+		free_elf_image(&image);
+		return;
+	}
+	closure.elf_class = image.elf_class;
+	closure.machine = image.header.e_machine;
+	free_elf_image(&image);
+
+	add_path_list(&closure.dirs, getenv("LD_LIBRARY_PATH"), ".");
+	read_ld_so_conf(&closure, LD_SO_CONF, 0);
+	add_path_list(&closure.dirs, closure.elf_class == ELFCLASS64 ?
+		"/lib64:/usr/lib64:/lib:/usr/lib" : "/lib32:/usr/lib32:/lib:/usr/lib", NULL);
+
+	add_string(&closure.names, filename, strlen(filename));
+	add_string(&closure.paths, filename, strlen(filename));
+
+	printf("Startup closure of \'%s\':\n", filename);
+	printf("  Initializers ArrayBytes DT_INIT TLSBytes TLSAlign Object\n");
+
+	// the closure grows while it is walked
+	for(size_t i = 0; i < closure.paths.count; i++)
+	{
+		struct startup_info info;
+		const char *path = closure.paths.items[i];
+
+		ret = map_elf_image(&image, path, &st);
+		if(ret != 0)
+		{
+			error(0, ret, "\'%s\' is not a valid elf file", path);
+			free_elf_image(&image);
+			continue;
+		}
+
+		read_startup_info(&image, &info);
+		add_needed(&closure, &image, path);
+
+		printf("  %12zu %10lu %7s %8lu %8lu %s\n",
+			info.initializers, info.array_bytes, info.has_init ? "yes" : "no",
+			info.tls_size, info.tls_align, path);
+
+		total_initializers += info.initializers;
+		total_array_bytes += info.array_bytes;
+		total_tls += info.tls_size;
+		init_functions += info.has_init;
+
+		free_startup_info(&info);
+		free_elf_image(&image);
+	}
+
+	printf("  Total: %zu objects, %zu initializers in %lu bytes of arrays, %zu DT_INIT functions, %lu bytes of TLS per thread\n",
+		closure.paths.count, total_initializers, total_array_bytes, init_functions, total_tls);
+
+	for(size_t i = 0; i < closure.missing.count; i++)
+		printf("  Not found: %s\n", closure.missing.items[i]);
+	printf("\n");
+
+	free_closure(&closure);
+}
+
+void print_startup(char **filenames, size_t count, bool closure)
+{
+	assert(filenames != NULL);
+
+	for(size_t i = 0; i < count; i++)
+	{
+		if(closure)
+			print_startup_closure(filenames[i]);
+		else
+			print_startup_file(filenames[i]);
+	}
+}
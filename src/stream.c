@@ -0,0 +1,378 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include <sys/types.h>
+#include "misc.h"
+#include "elf_header.h"
+#include "program_header.h"
+#include "section_header.h"
+#include "stream.h"
+#include "validate.h"
+#include "image.h"
+#include "symbol.h"
+
+// how many of the most recently consumed bytes are kept around, so tables
+// located before the one referencing them (the section name string table is
+// usually placed right before the section header table) can still be read
+#define STREAM_WINDOW_SIZE (1024 * 1024)
+#define STREAM_CHUNK_SIZE (64 * 1024)
+// the size of a stream is unknown, so a bigger string table size is taken for garbage
+#define STREAM_STRTAB_MAX (16 * 1024 * 1024)
+
+struct input_stream {
+	FILE *fp;
+	const char *name;
+	uint64_t pos;		// offset of the next byte to be consumed
+	unsigned char *window;	// ring buffer with the last consumed bytes
+};
+
+static void stream_consume(struct input_stream *stream, void *buf, size_t size)
+{
+	unsigned char *dst = buf;
+
+	if(fread(dst, 1, size, stream->fp) != size)
+		error(EXIT_FAILURE, errno, "\'%s\': unexpected end of input", stream->name);
+
+	// only the tail of a big read can stay in the window
+	if(size > STREAM_WINDOW_SIZE)
+	{
+		stream->pos += size - STREAM_WINDOW_SIZE;
+		dst += size - STREAM_WINDOW_SIZE;
+		size = STREAM_WINDOW_SIZE;
+	}
+
+	while(size > 0)
+	{
+		size_t index = (size_t)(stream->pos % STREAM_WINDOW_SIZE);
+		size_t n = STREAM_WINDOW_SIZE - index;
+
+		if(n > size)
+			n = size;
+
+		memcpy(stream->window + index, dst, n);
+		stream->pos += n;
+		dst += n;
+		size -= n;
+	}
+}
+
+static void stream_skip(struct input_stream *stream, uint64_t offset)
+{
+	unsigned char chunk[STREAM_CHUNK_SIZE];
+
+	while(stream->pos < offset)
+	{
+		uint64_t n = offset - stream->pos;
+
+		if(n > STREAM_CHUNK_SIZE)
+			n = STREAM_CHUNK_SIZE;
+
+		stream_consume(stream, chunk, (size_t)n);
+	}
+}
+
+// reads [offset, offset + size) either from the window (bytes already
+// consumed) or by moving the stream forward; returns false if the bytes
+// went out of the window already
+static bool stream_read_at(struct input_stream *stream, uint64_t offset, void *buf, size_t size)
+{
+	unsigned char *dst = buf;
+	uint64_t window_start = stream->pos > STREAM_WINDOW_SIZE ? stream->pos - STREAM_WINDOW_SIZE : 0;
+
+	if(offset < window_start)
+		return false;
+
+	while(size > 0 && offset < stream->pos)
+	{
+		size_t index = (size_t)(offset % STREAM_WINDOW_SIZE);
+		size_t n = STREAM_WINDOW_SIZE - index;
+
+		if(n > size)
+			n = size;
+		if(n > stream->pos - offset)
+			n = (size_t)(stream->pos - offset);
+
+		memcpy(dst, stream->window + index, n);
+		offset += n;
+		dst += n;
+		size -= n;
+	}
+
+	if(size > 0)
+	{
+		stream_skip(stream, offset);
+		stream_consume(stream, dst, size);
+	}
+
+	return true;
+}
+
+static void* stream_read_table(struct input_stream *stream, uint64_t offset, size_t size, const char *table_name)
+{
+	void *table = NULL;
+
+	table = malloc_wrap(size ? size : 1);
+
+	if(!stream_read_at(stream, offset, table, size))
+	{
+		error(0, ESPIPE, "\'%s\': %s lies before the buffered part of the stream", stream->name, table_name);
+		free(table);
+		return NULL;
+	}
+
+	return table;
+}
+
+// the section name string table, terminated so every name in it ends inside of the buffer
+static char* read_stream_strtab(struct input_stream *stream, uint64_t offset, size_t size)
+{
+	char *strtab = NULL;
+
+	if(size == 0)
+		return strcpy(malloc_wrap(1), "");
+
+	if(size > STREAM_STRTAB_MAX)
+	{
+		error(0, EFBIG, "\'%s\': section name string table is too big", stream->name);
+		return NULL;
+	}
+
+	strtab = stream_read_table(stream, offset, size, "section name string table");
+	if(!strtab)
+		return NULL;
+
+	strtab = realloc_wrap(strtab, size + 1);
+	strtab[size] = '\0';
+	return strtab;
+}
+
+static void print_stream32(struct input_stream *stream, bool is_elf_header, bool is_program_header, bool is_section_header)
+{
+	Elf32_Ehdr elf_header;
+	Elf32_Phdr *program_headers = NULL;
+	Elf32_Shdr *section_headers = NULL;
+	char *strtab_buffer = NULL;
+	const char *problem = NULL;
+	size_t program_headers_size, section_headers_size;
+
+	stream_read_at(stream, 0, &elf_header, sizeof(Elf32_Ehdr));
+
+	program_headers_size = sizeof(Elf32_Phdr) * elf_header.e_phnum;
+	section_headers_size = sizeof(Elf32_Shdr) * elf_header.e_shnum;
+
+	// the size of a stream is not known, reads past its end fail on their own
+	problem = validate_elf32_header(&elf_header, UINT64_MAX, VALIDATE_SECTIONS);
+	if(is_section_header && problem)
+	{
+		error(0, EBADF, "\'%s\': %s", stream->name, problem);
+		is_section_header = false;
+	}
+
+	// tables are consumed in file order
+	if(is_program_header && (!is_section_header || elf_header.e_phoff <= elf_header.e_shoff))
+	{
+		program_headers = stream_read_table(stream, elf_header.e_phoff, program_headers_size, "program header table");
+		is_program_header = false;
+	}
+
+	if(is_section_header)
+	{
+		section_headers = stream_read_table(stream, elf_header.e_shoff, section_headers_size, "section header table");
+		problem = section_headers ? validate_section32_headers(section_headers, &elf_header, UINT64_MAX) : NULL;
+		if(problem)
+			error(0, EBADF, "\'%s\': %s", stream->name, problem);
+		else if(section_headers && elf_header.e_shstrndx == SHN_UNDEF)
+			strtab_buffer = read_stream_strtab(stream, 0, 0);
+		else if(section_headers)
+		{
+			Elf32_Shdr *strtab = &section_headers[elf_header.e_shstrndx];
+			strtab_buffer = read_stream_strtab(stream, strtab->sh_offset, strtab->sh_size);
+		}
+	}
+
+	if(is_program_header)
+		program_headers = stream_read_table(stream, elf_header.e_phoff, program_headers_size, "program header table");
+
+	if(is_elf_header)
+		print_elf32_header(&elf_header);
+	if(program_headers)
+		print_program32_headers(program_headers, &elf_header);
+	if(section_headers && strtab_buffer)
+		print_section32_headers(section_headers, &elf_header, strtab_buffer);
+
+	free(strtab_buffer);
+	free(section_headers);
+	free(program_headers);
+}
+
+static void print_stream64(struct input_stream *stream, bool is_elf_header, bool is_program_header, bool is_section_header)
+{
+	Elf64_Ehdr elf_header;
+	Elf64_Phdr *program_headers = NULL;
+	Elf64_Shdr *section_headers = NULL;
+	char *strtab_buffer = NULL;
+	const char *problem = NULL;
+	size_t program_headers_size, section_headers_size;
+
+	stream_read_at(stream, 0, &elf_header, sizeof(Elf64_Ehdr));
+
+	program_headers_size = sizeof(Elf64_Phdr) * elf_header.e_phnum;
+	section_headers_size = sizeof(Elf64_Shdr) * elf_header.e_shnum;
+
+	// the size of a stream is not known, reads past its end fail on their own
+	problem = validate_elf64_header(&elf_header, UINT64_MAX, VALIDATE_SECTIONS);
+	if(is_section_header && problem)
+	{
+		error(0, EBADF, "\'%s\': %s", stream->name, problem);
+		is_section_header = false;
+	}
+
+	// tables are consumed in file order
+	if(is_program_header && (!is_section_header || elf_header.e_phoff <= elf_header.e_shoff))
+	{
+		program_headers = stream_read_table(stream, elf_header.e_phoff, program_headers_size, "program header table");
+		is_program_header = false;
+	}
+
+	if(is_section_header)
+	{
+		section_headers = stream_read_table(stream, elf_header.e_shoff, section_headers_size, "section header table");
+		problem = section_headers ? validate_section64_headers(section_headers, &elf_header, UINT64_MAX) : NULL;
+		if(problem)
+			error(0, EBADF, "\'%s\': %s", stream->name, problem);
+		else if(section_headers && elf_header.e_shstrndx == SHN_UNDEF)
+			strtab_buffer = read_stream_strtab(stream, 0, 0);
+		else if(section_headers)
+		{
+			Elf64_Shdr *strtab = &section_headers[elf_header.e_shstrndx];
+			strtab_buffer = read_stream_strtab(stream, strtab->sh_offset, strtab->sh_size);
+		}
+	}
+
+	if(is_program_header)
+		program_headers = stream_read_table(stream, elf_header.e_phoff, program_headers_size, "program header table");
+
+	if(is_elf_header)
+		print_elf64_header(&elf_header);
+	if(program_headers)
+		print_program64_headers(program_headers, &elf_header);
+	if(section_headers && strtab_buffer)
+		print_section64_headers(section_headers, &elf_header, strtab_buffer);
+
+	free(strtab_buffer);
+	free(section_headers);
+	free(program_headers);
+}
+
+// symbol tables may lie anywhere in the file, so for them the stream is read whole
+static unsigned char* read_whole_stream(struct input_stream *stream, size_t *size)
+{
+	unsigned char *data = NULL;
+	size_t capacity = 0, ret;
+
+	*size = 0;
+	do
+	{
+		if(*size == capacity)
+		{
+			capacity = capacity ? capacity * 2 : STREAM_WINDOW_SIZE;
+			data = realloc_wrap(data, capacity);
+		}
+
+		ret = fread(data + *size, 1, capacity - *size, stream->fp);
+		*size += ret;
+	} while(ret > 0);
+
+	if(ferror(stream->fp))
+		error(EXIT_FAILURE, errno, "cannot read \'%s\'", stream->name);
+
+	return data;
+}
+
+static void print_stream_tables(struct input_stream *stream, bool is_elf_header, bool is_program_header, bool is_section_header)
+{
+	unsigned char ident[EI_NIDENT];
+
+	stream_read_at(stream, 0, ident, EI_NIDENT);
+
+	if(memcmp(ident, ELFMAG, SELFMAG) != 0)
+		error(0, ENOEXEC, "\'%s\' is not executable file", stream->name);
+	else if(ident[EI_CLASS] == ELFCLASS32)
+		print_stream32(stream, is_elf_header, is_program_header, is_section_header);
+	else if(ident[EI_CLASS] == ELFCLASS64)
+		print_stream64(stream, is_elf_header, is_program_header, is_section_header);
+	else
+		error(0, EBADF, "unknown elf file class");
+}
+
+// the header tables of a stream read whole go through the one-pass printers too, so they print the same
+static void print_stream_image(struct input_stream *stream, bool is_elf_header, bool is_program_header, bool is_section_header, struct demangler *demangler)
+{
+	struct elf_image image;
+	unsigned char *data = NULL;
+	size_t size;
+	int ret;
+
+	data = read_whole_stream(stream, &size);
+
+	ret = load_elf_image(&image, stream->name, data, size);
+	if(ret == ENOEXEC)
+		error(0, ENOEXEC, "\'%s\' is not executable file", stream->name);
+	else
+	{
+		if(is_elf_header || is_program_header || is_section_header)
+		{
+			struct input_stream memory = {NULL, stream->name, 0, stream->window};
+
+			memory.fp = fmemopen(data, size, "rb");
+			if(!memory.fp)
+				error(EXIT_FAILURE, errno, "cannot read \'%s\'", stream->name);
+
+			print_stream_tables(&memory, is_elf_header, is_program_header, is_section_header);
+			fclose(memory.fp);
+		}
+
+		if(ret != 0)
+			error(0, ret, "\'%s\' is not a valid elf file", stream->name);
+		else
+			print_image_symbols(&image, demangler);
+	}
+
+	free_elf_image(&image);
+	free(data);
+}
+
+void print_stream_input(const char *filename, bool is_elf_header, bool is_program_header, bool is_section_header, bool is_symbol_table, struct demangler *demangler)
+{
+	assert(filename != NULL);
+
+	struct input_stream stream;
+
+	stream.name = filename;
+	stream.pos = 0;
+	stream.window = malloc_wrap(STREAM_WINDOW_SIZE);
+
+	if(strcmp(filename, "-") == 0)
+	{
+		stream.fp = stdin;
+		stream.name = "<stdin>";
+	}
+	else
+		stream.fp = fopen_wrap(filename, "rb");
+
+	if(is_symbol_table)
+		print_stream_image(&stream, is_elf_header, is_program_header, is_section_header, demangler);
+	else
+		print_stream_tables(&stream, is_elf_header, is_program_header, is_section_header);
+
+	if(stream.fp != stdin)
+		fclose(stream.fp);
+	free(stream.window);
+}
\ No newline at end of file
@@ -0,0 +1,265 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include "misc.h"
+#include "image.h"
+#include "demangle.h"
+#include "symbol.h"
+
+static const char * const symbol_type_names[] = {
+	"NOTYPE",
+	"OBJECT",
+	"FUNC",
+	"SECTION",
+	"FILE",
+	"COMMON",
+	"TLS"
+};
+
+static const char * const symbol_bind_names[] = {
+	"LOCAL",
+	"GLOBAL",
+	"WEAK"
+};
+
+static const char * const symbol_visibility_names[] = {
+	"DEFAULT",
+	"INTERNAL",
+	"HIDDEN",
+	"PROTECTED"
+};
+
+// names of the symbol info fields, NULL for values without a name
+const char* get_symbol_type(unsigned int type)
+{
+	if(type < sizeof(symbol_type_names) / sizeof(symbol_type_names[0]))
+		return symbol_type_names[type];
+	if(type == STT_GNU_IFUNC)
+		return "IFUNC";
+
+	return NULL;
+}
+
+const char* get_symbol_bind(unsigned int bind)
+{
+	if(bind < sizeof(symbol_bind_names) / sizeof(symbol_bind_names[0]))
+		return symbol_bind_names[bind];
+	if(bind == STB_GNU_UNIQUE)
+		return "UNIQUE";
+
+	return NULL;
+}
+
+const char* get_symbol_visibility(unsigned int visibility)
+{
+	if(visibility < sizeof(symbol_visibility_names) / sizeof(symbol_visibility_names[0]))
+		return symbol_visibility_names[visibility];
+
+	return NULL;
+}
+
+static void widen_symbol32(Elf64_Sym *dst, const Elf32_Sym *src)
+{
+	dst->st_name = src->st_name;
+	dst->st_info = src->st_info;
+	dst->st_other = src->st_other;
+	dst->st_shndx = src->st_shndx;
+	dst->st_value = src->st_value;
+	dst->st_size = src->st_size;
+}
+
+// .symtab if the file has one, the dynamic symbols otherwise
+Elf64_Shdr* find_symbol_section(const struct elf_image *image)
+{
+	assert(image != NULL);
+
+	Elf64_Shdr *dynsym = NULL;
+
+	for(size_t i = 0; i < image->header.e_shnum; i++)
+	{
+		if(image->section_headers[i].sh_type == SHT_SYMTAB)
+			return &image->section_headers[i];
+		if(image->section_headers[i].sh_type == SHT_DYNSYM && !dynsym)
+			dynsym = &image->section_headers[i];
+	}
+
+	return dynsym;
+}
+
+// symbols are copied (and widened) out of the mapping, names stay in it
+int load_symbol_table(const struct elf_image *image, const Elf64_Shdr *section, struct symbol_table *table)
+{
+	assert(image != NULL);
+	assert(section != NULL);
+	assert(table != NULL);
+
+	size_t entsize = image->elf_class == ELFCLASS32 ? sizeof(Elf32_Sym) : sizeof(Elf64_Sym);
+	const unsigned char *data = NULL;
+	const Elf64_Shdr *strtab = NULL;
+
+	memset(table, 0, sizeof(struct symbol_table));
+
+	data = get_section_data(image, section);
+	if(!data || section->sh_link >= image->header.e_shnum)
+		return EBADF;
+
+	strtab = &image->section_headers[section->sh_link];
+	table->strtab = (const char*)get_section_data(image, strtab);
+	table->strtab_size = strtab->sh_size;
+	if(!table->strtab)
+		return EBADF;
+
+	table->count = section->sh_size / entsize;
+	table->symbols = malloc_wrap(sizeof(Elf64_Sym) * (table->count + 1));
+
+	for(size_t i = 0; i < table->count; i++)
+	{
+		if(image->elf_class == ELFCLASS32)
+		{
+			Elf32_Sym sym;
+
+			memcpy(&sym, data + i * entsize, sizeof(sym));
+			widen_symbol32(&table->symbols[i], &sym);
+		}
+		else
+			memcpy(&table->symbols[i], data + i * entsize, sizeof(Elf64_Sym));
+	}
+
+	return 0;
+}
+
+void free_symbol_table(struct symbol_table *table)
+{
+	assert(table != NULL);
+
+	free(table->symbols);
+	memset(table, 0, sizeof(struct symbol_table));
+}
+
+const char* get_symbol_name(const struct symbol_table *table, const Elf64_Sym *symbol)
+{
+	assert(table != NULL);
+	assert(symbol != NULL);
+
+	if(symbol->st_name >= table->strtab_size || !memchr(table->strtab + symbol->st_name, '\0', table->strtab_size - symbol->st_name))
+		return "";
+
+	return table->strtab + symbol->st_name;
+}
+
+static void print_symbol(const struct symbol_table *table, size_t index, const char *name)
+{
+	const Elf64_Sym *symbol = &table->symbols[index];
+	const char *type = get_symbol_type(ELF64_ST_TYPE(symbol->st_info));
+	const char *bind = get_symbol_bind(ELF64_ST_BIND(symbol->st_info));
+	const char *visibility = get_symbol_visibility(ELF64_ST_VISIBILITY(symbol->st_other));
+	char section[16];
+
+	if(symbol->st_shndx == SHN_UNDEF)
+		strcpy(section, "UND");
+	else if(symbol->st_shndx == SHN_ABS)
+		strcpy(section, "ABS");
+	else if(symbol->st_shndx == SHN_COMMON)
+		strcpy(section, "COM");
+	else
+		snprintf(section, sizeof(section), "%u", symbol->st_shndx);
+
+	printf("%6zu: %016lx %5lu %-7s %-6s %-8s %3s %s\n",
+		index,
+		symbol->st_value,
+		symbol->st_size,
+		type ? type : "?",
+		bind ? bind : "?",
+		visibility ? visibility : "?",
+		section,
+		name);
+}
+
+/*
+ * prints the symbols whose selected byte is set, or all of them when selected
+ * is NULL, under names (e.g. demangled ones) or their own names if it is NULL
+ */
+void print_symbols(const struct symbol_table *table, const char *name, const unsigned char *selected, const char **names)
+{
+	assert(table != NULL);
+	assert(name != NULL);
+
+	size_t selected_count = 0;
+
+	for(size_t i = 0; selected && i < table->count; i++)
+		selected_count += selected[i];
+
+	if(selected)
+		printf("\n%zu of %zu entries of symbol table '%s' selected:\n", selected_count, table->count, name);
+	else
+		printf("\nSymbol table '%s' contains %zu entries:\n", name, table->count);
+	printf("   Num:    Value          Size Type    Bind   Vis      Ndx Name\n");
+
+	for(size_t i = 0; i < table->count; i++)
+		if(!selected || selected[i])
+			print_symbol(table, i, names ? names[i] : get_symbol_name(table, &table->symbols[i]));
+}
+
+// prints every symbol table of the image, demangled with a demangler
+void print_image_symbols(const struct elf_image *image, struct demangler *demangler)
+{
+	assert(image != NULL);
+
+	struct symbol_table table;
+	bool found = false;
+	int ret;
+
+	for(size_t i = 0; i < image->header.e_shnum; i++)
+	{
+		const Elf64_Shdr *section = &image->section_headers[i];
+
+		if(section->sh_type != SHT_SYMTAB && section->sh_type != SHT_DYNSYM)
+			continue;
+
+		found = true;
+		ret = load_symbol_table(image, section, &table);
+		if(ret != 0)
+			error(0, ret, "cannot read symbol table \'%s\'", get_section_name(image, section));
+		else if(demangler)
+		{
+			const char **names = malloc_wrap(sizeof(char*) * (table.count + 1));
+
+			for(size_t j = 0; j < table.count; j++)
+				names[j] = get_symbol_name(&table, &table.symbols[j]);
+			demangle_names(demangler, names, table.count);
+
+			print_symbols(&table, get_section_name(image, section), NULL, names);
+			free(names);
+		}
+		else
+			print_symbols(&table, get_section_name(image, section), NULL, NULL);
+		free_symbol_table(&table);
+	}
+
+	if(!found)
+		printf("There are no symbol tables in this file\n");
+}
+
+void print_symbol_table(const char *filename, struct demangler *demangler)
+{
+	if(!filename)
+		error(EXIT_FAILURE, EINVAL, "you did not provide input file");
+
+	struct elf_image image;
+	int ret;
+
+	ret = open_elf_image(&image, filename);
+	if(ret != 0)
+		error(0, ret, "\'%s\' is not a valid elf file", filename);
+	else
+		print_image_symbols(&image, demangler);
+
+	free_elf_image(&image);
+}
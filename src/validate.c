@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <elf.h>
+#include <assert.h>
+#include "validate.h"
+
+/*
+ * the printers index the tables and the section name string table without
+ * checks of their own; these passes run once per file, before the tables
+ * are read, and say what is wrong with a file that cannot be printed safely
+ */
+
+// the one bounds check of file ranges, shared with the image loader
+int range_is_valid(uint64_t file_size, uint64_t offset, uint64_t length)
+{
+	return offset <= file_size && length <= file_size - offset;
+}
+
+static const char* validate_tables(uint64_t file_size, int tables,
+	uint64_t phoff, uint16_t phnum, uint16_t phentsize, size_t phdr_size,
+	uint64_t shoff, uint16_t shnum, uint16_t shentsize, size_t shdr_size, uint16_t shstrndx)
+{
+	if((tables & VALIDATE_SEGMENTS) && phnum > 0)
+	{
+		if(phentsize != phdr_size)
+			return "program header entry size does not match the elf class";
+		if(!range_is_valid(file_size, phoff, (uint64_t)phnum * phdr_size))
+			return "program header table lies outside of the file";
+	}
+
+	if(tables & VALIDATE_SECTIONS)
+	{
+		if(shstrndx == SHN_XINDEX)
+			return "extended section numbering is not supported";
+		if(shstrndx != SHN_UNDEF && shstrndx >= shnum)
+			return "section name string table index is out of range";
+
+		if(shnum > 0)
+		{
+			if(shentsize != shdr_size)
+				return "section header entry size does not match the elf class";
+			if(!range_is_valid(file_size, shoff, (uint64_t)shnum * shdr_size))
+				return "section header table lies outside of the file";
+		}
+	}
+
+	return NULL;
+}
+
+// tables is a mask of VALIDATE_SEGMENTS and VALIDATE_SECTIONS, the tables that will be read
+const char* validate_elf32_header(const Elf32_Ehdr *header, uint64_t file_size, int tables)
+{
+	assert(header != NULL);
+
+	return validate_tables(file_size, tables,
+		header->e_phoff, header->e_phnum, header->e_phentsize, sizeof(Elf32_Phdr),
+		header->e_shoff, header->e_shnum, header->e_shentsize, sizeof(Elf32_Shdr), header->e_shstrndx);
+}
+
+const char* validate_elf64_header(const Elf64_Ehdr *header, uint64_t file_size, int tables)
+{
+	assert(header != NULL);
+
+	return validate_tables(file_size, tables,
+		header->e_phoff, header->e_phnum, header->e_phentsize, sizeof(Elf64_Phdr),
+		header->e_shoff, header->e_shnum, header->e_shentsize, sizeof(Elf64_Shdr), header->e_shstrndx);
+}
+
+/*
+ * the string table readers terminate the table, so a name is safe to print
+ * when it starts inside of it; files without a string table have no names
+ */
+const char* validate_section32_headers(const Elf32_Shdr *section_headers, const Elf32_Ehdr *header, uint64_t file_size)
+{
+	assert(section_headers != NULL);
+	assert(header != NULL);
+
+	uint32_t strtab_size = 0;
+
+	if(header->e_shstrndx != SHN_UNDEF)
+	{
+		const Elf32_Shdr *strtab = &section_headers[header->e_shstrndx];
+
+		if(!range_is_valid(file_size, strtab->sh_offset, strtab->sh_size))
+			return "section name string table lies outside of the file";
+		strtab_size = strtab->sh_size;
+	}
+
+	for(size_t i = 0; i < header->e_shnum; i++)
+		if(section_headers[i].sh_name != 0 && section_headers[i].sh_name >= strtab_size)
+			return "section name lies outside of the string table";
+
+	return NULL;
+}
+
+const char* validate_section64_headers(const Elf64_Shdr *section_headers, const Elf64_Ehdr *header, uint64_t file_size)
+{
+	assert(section_headers != NULL);
+	assert(header != NULL);
+
+	uint64_t strtab_size = 0;
+
+	if(header->e_shstrndx != SHN_UNDEF)
+	{
+		const Elf64_Shdr *strtab = &section_headers[header->e_shstrndx];
+
+		if(!range_is_valid(file_size, strtab->sh_offset, strtab->sh_size))
+			return "section name string table lies outside of the file";
+		strtab_size = strtab->sh_size;
+	}
+
+	for(size_t i = 0; i < header->e_shnum; i++)
+		if(section_headers[i].sh_name != 0 && section_headers[i].sh_name >= strtab_size)
+			return "section name lies outside of the string table";
+
+	return NULL;
+}
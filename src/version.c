@@ -0,0 +1,717 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "misc.h"
+#include "image.h"
+#include "symbol.h"
+#include "dynamic.h"
+#include "parallel.h"
+#include "version.h"
+
+#define VERSION_INDEX_MIN 1024
+
+// bits of a .gnu.version entry
+#define VERSYM_HIDDEN 0x8000
+#define VERSYM_VERSION 0x7fff
+
+// a library of a --check-versions set and the versions it defines or needs
+struct version_file {
+	char *path;
+	bool is_listed;			// named on the command line, not found in a directory
+	int status;
+	int elf_class;
+	uint16_t machine;
+	char *soname;			// DT_SONAME, or the file name
+	char **definitions;
+	size_t definition_count;
+	struct version_need *needs;
+	size_t need_count;
+};
+
+struct version_need {
+	char *file;
+	char *name;
+	bool is_weak;
+};
+
+// (library, version) pairs of all providers; a version of "" marks the library itself
+struct version_key {
+	uint64_t hash;
+	const char *soname;		// NULL if the slot is empty
+	const char *name;
+	int elf_class;
+	uint16_t machine;
+};
+
+struct version_index {
+	struct version_key *keys;
+	size_t capacity;
+	size_t count;
+};
+
+struct version_set {
+	struct version_file *files;
+	size_t count;
+	size_t capacity;
+};
+
+static const char* get_string(const char *strtab, size_t size, uint64_t offset)
+{
+	if(!strtab || offset >= size || !memchr(strtab + offset, '\0', size - offset))
+		return NULL;
+
+	return strtab + offset;
+}
+
+static const char* get_section_strings(const struct elf_image *image, const Elf64_Shdr *section, size_t *size)
+{
+	const Elf64_Shdr *strtab = NULL;
+
+	*size = 0;
+	if(section->sh_link >= image->header.e_shnum)
+		return NULL;
+
+	strtab = &image->section_headers[section->sh_link];
+	*size = strtab->sh_size;
+	return (const char*)get_section_data(image, strtab);
+}
+
+static void add_entry(struct version_table *table, const struct version_entry *entry)
+{
+	if(table->entry_count == table->entry_capacity)
+	{
+		table->entry_capacity = table->entry_capacity ? table->entry_capacity * 2 : 16;
+		table->entries = realloc_wrap(table->entries, sizeof(struct version_entry) * table->entry_capacity);
+	}
+	table->entries[table->entry_count++] = *entry;
+}
+
+/*
+ * verdef and verneed records have the same layout in 32 and 64 bit files
+ * and are chained by byte offsets, which are checked against the section
+ */
+static void read_definitions(const struct elf_image *image, const Elf64_Shdr *section, struct version_table *table)
+{
+	const unsigned char *data = get_section_data(image, section);
+	const char *strtab = NULL;
+	size_t strtab_size, offset = 0;
+
+	strtab = get_section_strings(image, section, &strtab_size);
+	if(!data)
+		return;
+
+	for(size_t i = 0; i < section->sh_info; i++)
+	{
+		Elf64_Verdef verdef;
+		Elf64_Verdaux verdaux;
+		struct version_entry entry;
+		size_t aux;
+
+		if(offset > section->sh_size || section->sh_size - offset < sizeof(verdef))
+			break;
+		memcpy(&verdef, data + offset, sizeof(verdef));
+
+		memset(&entry, 0, sizeof(entry));
+		entry.index = verdef.vd_ndx & VERSYM_VERSION;
+		entry.flags = verdef.vd_flags;
+		entry.hash = verdef.vd_hash;
+
+		// the first aux entry names the version, the others its parents
+		aux = offset + verdef.vd_aux;
+		for(size_t j = 0; j < verdef.vd_cnt && j < 2; j++)
+		{
+			if(aux > section->sh_size || section->sh_size - aux < sizeof(verdaux))
+				break;
+			memcpy(&verdaux, data + aux, sizeof(verdaux));
+
+			if(j == 0)
+				entry.name = get_string(strtab, strtab_size, verdaux.vda_name);
+			else
+				entry.parent = get_string(strtab, strtab_size, verdaux.vda_name);
+			aux += verdaux.vda_next;
+		}
+
+		if(entry.name)
+			add_entry(table, &entry);
+
+		if(verdef.vd_next == 0)
+			break;
+		offset += verdef.vd_next;
+	}
+}
+
+static void read_requirements(const struct elf_image *image, const Elf64_Shdr *section, struct version_table *table)
+{
+	const unsigned char *data = get_section_data(image, section);
+	const char *strtab = NULL;
+	size_t strtab_size, offset = 0;
+
+	strtab = get_section_strings(image, section, &strtab_size);
+	if(!data)
+		return;
+
+	for(size_t i = 0; i < section->sh_info; i++)
+	{
+		Elf64_Verneed verneed;
+		const char *file = NULL;
+		size_t aux;
+
+		if(offset > section->sh_size || section->sh_size - offset < sizeof(verneed))
+			break;
+		memcpy(&verneed, data + offset, sizeof(verneed));
+		file = get_string(strtab, strtab_size, verneed.vn_file);
+
+		aux = offset + verneed.vn_aux;
+		for(size_t j = 0; j < verneed.vn_cnt; j++)
+		{
+			Elf64_Vernaux vernaux;
+			struct version_entry entry;
+
+			if(aux > section->sh_size || section->sh_size - aux < sizeof(vernaux))
+				break;
+			memcpy(&vernaux, data + aux, sizeof(vernaux));
+
+			memset(&entry, 0, sizeof(entry));
+			entry.name = get_string(strtab, strtab_size, vernaux.vna_name);
+			entry.file = file ? file : "";
+			entry.index = vernaux.vna_other & VERSYM_VERSION;
+			entry.flags = vernaux.vna_flags;
+			entry.hash = vernaux.vna_hash;
+			if(entry.name)
+				add_entry(table, &entry);
+
+			if(vernaux.vna_next == 0)
+				break;
+			aux += vernaux.vna_next;
+		}
+
+		if(verneed.vn_next == 0)
+			break;
+		offset += verneed.vn_next;
+	}
+}
+
+/*
+ * reads .gnu.version_d, .gnu.version_r and .gnu.version; afterwards the
+ * version of a .dynsym symbol is two array lookups. returns ENOENT for
+ * files without symbol versions
+ */
+int load_version_table(const struct elf_image *image, struct version_table *table)
+{
+	assert(image != NULL);
+	assert(table != NULL);
+
+	const Elf64_Shdr *versym = NULL;
+	uint16_t max_index = 0;
+
+	memset(table, 0, sizeof(struct version_table));
+
+	for(size_t i = 0; i < image->header.e_shnum; i++)
+	{
+		const Elf64_Shdr *section = &image->section_headers[i];
+
+		if(section->sh_type == SHT_GNU_verdef && !table->definition_count && !table->entry_count)
+		{
+			read_definitions(image, section, table);
+			table->definition_count = table->entry_count;
+		}
+		else if(section->sh_type == SHT_GNU_versym)
+			versym = section;
+	}
+
+	// requirements follow the definitions, so definitions come first in entries
+	for(size_t i = 0; i < image->header.e_shnum; i++)
+	{
+		if(image->section_headers[i].sh_type == SHT_GNU_verneed)
+		{
+			read_requirements(image, &image->section_headers[i], table);
+			break;
+		}
+	}
+
+	if(!versym && table->entry_count == 0)
+		return ENOENT;
+
+	if(versym && get_section_data(image, versym))
+	{
+		table->count = versym->sh_size / sizeof(uint16_t);
+		table->versions = malloc_wrap(sizeof(uint16_t) * (table->count + 1));
+		memcpy(table->versions, get_section_data(image, versym), sizeof(uint16_t) * table->count);
+	}
+
+	for(size_t i = 0; i < table->entry_count; i++)
+		if(table->entries[i].index > max_index)
+			max_index = table->entries[i].index;
+
+	table->index_count = (size_t)max_index + 1;
+	table->by_index = calloc(table->index_count, sizeof(struct version_entry*));
+	if(!table->by_index)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+	for(size_t i = 0; i < table->entry_count; i++)
+		table->by_index[table->entries[i].index] = &table->entries[i];
+
+	return 0;
+}
+
+void free_version_table(struct version_table *table)
+{
+	assert(table != NULL);
+
+	free(table->versions);
+	free(table->entries);
+	free(table->by_index);
+	memset(table, 0, sizeof(struct version_table));
+}
+
+// version of the symbol at index of .dynsym, NULL for local and unversioned ones
+const struct version_entry* get_symbol_version(const struct version_table *table, size_t index, bool *hidden)
+{
+	assert(table != NULL);
+
+	uint16_t version;
+
+	if(index >= table->count)
+		return NULL;
+
+	version = table->versions[index];
+	if(hidden)
+		*hidden = (version & VERSYM_HIDDEN) != 0;
+
+	version &= VERSYM_VERSION;
+	if(version <= VER_NDX_GLOBAL || version >= table->index_count)
+		return NULL;
+
+	return table->by_index[version];
+}
+
+static void print_version_flags(uint16_t flags)
+{
+	if(flags & VER_FLG_BASE)
+		printf(" base");
+	if(flags & VER_FLG_WEAK)
+		printf(" weak");
+}
+
+static void print_version_entries(const struct version_table *table)
+{
+	const char *file = NULL;
+
+	printf("\nVersion definitions (%zu entries):\n", table->definition_count);
+	for(size_t i = 0; i < table->definition_count; i++)
+	{
+		const struct version_entry *entry = &table->entries[i];
+
+		printf("  [%2u] %-24s hash %08x", entry->index, entry->name, entry->hash);
+		if(entry->parent)
+			printf(" parent %s", entry->parent);
+		print_version_flags(entry->flags);
+		printf("\n");
+	}
+
+	printf("\nVersion requirements (%zu entries):\n", table->entry_count - table->definition_count);
+	for(size_t i = table->definition_count; i < table->entry_count; i++)
+	{
+		const struct version_entry *entry = &table->entries[i];
+
+		if(!file || strcmp(file, entry->file) != 0)
+		{
+			file = entry->file;
+			printf("  %s:\n", file);
+		}
+
+		printf("    [%2u] %-24s hash %08x", entry->index, entry->name, entry->hash);
+		print_version_flags(entry->flags);
+		printf("\n");
+	}
+}
+
+// .dynsym with names as nm -D shows them: name@VERSION, or name@@VERSION for defaults
+static void print_versioned_symbols(const struct elf_image *image, const struct version_table *table)
+{
+	struct symbol_table symbols;
+	const char **names = NULL;
+	char **buffers = NULL;
+	const Elf64_Shdr *dynsym = NULL;
+	int ret;
+
+	for(size_t i = 0; i < image->header.e_shnum && !dynsym; i++)
+		if(image->section_headers[i].sh_type == SHT_DYNSYM)
+			dynsym = &image->section_headers[i];
+
+	if(!dynsym)
+		return;
+
+	ret = load_symbol_table(image, dynsym, &symbols);
+	if(ret != 0)
+	{
+		error(0, ret, "cannot read symbol table \'%s\'", get_section_name(image, dynsym));
+		return;
+	}
+
+	names = malloc_wrap(sizeof(const char*) * (symbols.count + 1));
+	buffers = calloc(symbols.count + 1, sizeof(char*));
+	if(!buffers)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	for(size_t i = 0; i < symbols.count; i++)
+	{
+		const Elf64_Sym *symbol = &symbols.symbols[i];
+		const struct version_entry *version = NULL;
+		bool hidden = false;
+
+		names[i] = get_symbol_name(&symbols, symbol);
+		version = get_symbol_version(table, i, &hidden);
+		if(!version)
+			continue;
+
+		if(asprintf(&buffers[i], "%s%s%s", names[i], version->file || hidden || symbol->st_shndx == SHN_UNDEF ? "@" : "@@", version->name) < 0)
+			error(EXIT_FAILURE, errno, "cannot allocate memory");
+		names[i] = buffers[i];
+	}
+
+	print_symbols(&symbols, get_section_name(image, dynsym), NULL, names);
+
+	for(size_t i = 0; i < symbols.count; i++)
+		free(buffers[i]);
+	free(buffers);
+	free(names);
+	free_symbol_table(&symbols);
+}
+
+void print_versions(const char *filename)
+{
+	if(!filename)
+		error(EXIT_FAILURE, EINVAL, "you did not provide input file");
+
+	struct elf_image image;
+	struct version_table table;
+	int ret;
+
+	ret = open_elf_image(&image, filename);
+	if(ret != 0)
+	{
+		error(0, ret, "\'%s\' is not a valid elf file", filename);
+		free_elf_image(&image);
+		return;
+	}
+
+	ret = load_version_table(&image, &table);
+	if(ret == ENOENT)
+		printf("\nThere are no symbol versions in this file.\n");
+	else
+	{
+		print_version_entries(&table);
+		print_versioned_symbols(&image, &table);
+		free_version_table(&table);
+	}
+
+	free_elf_image(&image);
+}
+
+static char* copy_string(const char *str)
+{
+	char *copy = strdup(str);
+
+	if(!copy)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+	return copy;
+}
+
+// what --check-versions keeps of a file, the image itself is unmapped again
+static void read_version_file(size_t index, void *arg)
+{
+	struct version_file *file = &((struct version_set*)arg)->files[index];
+	struct elf_image image;
+	struct version_table table;
+	struct dynamic_table dynamic;
+	struct stat st;
+	const char *soname = NULL;
+
+	file->status = map_elf_image(&image, file->path, &st);
+	if(file->status != 0)
+	{
+		free_elf_image(&image);
+		return;
+	}
+
+	file->elf_class = image.elf_class;
+	file->machine = image.header.e_machine;
+
+	if(load_dynamic_table(&image, &dynamic) == 0)
+	{
+		for(size_t i = 0; i < dynamic.count && !soname; i++)
+			if(dynamic.entries[i].d_tag == DT_SONAME)
+				soname = get_dynamic_string(&dynamic, dynamic.entries[i].d_un.d_val);
+		file->soname = copy_string(soname ? soname : basename(file->path));
+		free_dynamic_table(&dynamic);
+	}
+	else
+		file->soname = copy_string(basename(file->path));
+
+	if(load_version_table(&image, &table) == 0)
+	{
+		file->definitions = malloc_wrap(sizeof(char*) * (table.definition_count + 1));
+		file->needs = malloc_wrap(sizeof(struct version_need) * (table.entry_count - table.definition_count + 1));
+
+		for(size_t i = 0; i < table.entry_count; i++)
+		{
+			const struct version_entry *entry = &table.entries[i];
+
+			// the base definition is the soname, not a version symbols bind to
+			if(!entry->file && !(entry->flags & VER_FLG_BASE))
+				file->definitions[file->definition_count++] = copy_string(entry->name);
+			else if(entry->file)
+			{
+				struct version_need *need = &file->needs[file->need_count++];
+
+				need->file = copy_string(entry->file);
+				need->name = copy_string(entry->name);
+				need->is_weak = (entry->flags & VER_FLG_WEAK) != 0;
+			}
+		}
+
+		free_version_table(&table);
+	}
+
+	free_elf_image(&image);
+}
+
+static uint64_t hash_key(const char *soname, const char *name, int elf_class, uint16_t machine)
+{
+	uint64_t hash;
+
+	// 0xff cannot be part of a name, it keeps ("ab", "c") apart from ("a", "bc")
+	hash = hash_string(HASH_SEED, soname);
+	hash = hash_bytes(hash, "\xff", 1);
+	hash = hash_string(hash, name);
+	hash = hash_bytes(hash, &elf_class, sizeof(elf_class));
+	return hash_bytes(hash, &machine, sizeof(machine));
+}
+
+static struct version_key* find_key(const struct version_index *index, const char *soname, const char *name, int elf_class, uint16_t machine)
+{
+	uint64_t hash = hash_key(soname, name, elf_class, machine);
+	size_t slot = (size_t)hash & (index->capacity - 1);
+
+	for(struct version_key *key = &index->keys[slot]; key->soname; key = &index->keys[slot])
+	{
+		if(key->hash == hash && key->elf_class == elf_class && key->machine == machine &&
+			strcmp(key->soname, soname) == 0 && strcmp(key->name, name) == 0)
+			return key;
+		slot = (slot + 1) & (index->capacity - 1);
+	}
+
+	return &index->keys[slot];
+}
+
+static void add_key(struct version_index *index, const char *soname, const char *name, int elf_class, uint16_t machine)
+{
+	struct version_key *key = find_key(index, soname, name, elf_class, machine);
+
+	if(key->soname)
+		return;
+
+	key->hash = hash_key(soname, name, elf_class, machine);
+	key->soname = soname;
+	key->name = name;
+	key->elf_class = elf_class;
+	key->machine = machine;
+	index->count++;
+}
+
+static bool has_key(const struct version_index *index, const char *soname, const char *name, int elf_class, uint16_t machine)
+{
+	return find_key(index, soname, name, elf_class, machine)->soname != NULL;
+}
+
+// the index is sized once for all keys, so it never grows
+static void build_version_index(const struct version_set *set, struct version_index *index)
+{
+	size_t keys = 0;
+
+	for(size_t i = 0; i < set->count; i++)
+		keys += set->files[i].definition_count + 1;
+
+	index->count = 0;
+	index->capacity = VERSION_INDEX_MIN;
+	while(index->capacity < keys * 2)
+		index->capacity *= 2;
+
+	index->keys = calloc(index->capacity, sizeof(struct version_key));
+	if(!index->keys)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+	for(size_t i = 0; i < set->count; i++)
+	{
+		const struct version_file *file = &set->files[i];
+
+		if(file->status != 0)
+			continue;
+
+		add_key(index, file->soname, "", file->elf_class, file->machine);
+		for(size_t j = 0; j < file->definition_count; j++)
+			add_key(index, file->soname, file->definitions[j], file->elf_class, file->machine);
+	}
+}
+
+static void add_version_file(struct version_set *set, const char *path, bool is_listed)
+{
+	struct version_file *file = NULL;
+
+	if(set->count == set->capacity)
+	{
+		set->capacity = set->capacity ? set->capacity * 2 : 64;
+		set->files = realloc_wrap(set->files, sizeof(struct version_file) * set->capacity);
+	}
+	file = &set->files[set->count++];
+	memset(file, 0, sizeof(struct version_file));
+	file->path = copy_string(path);
+	file->is_listed = is_listed;
+}
+
+// regular files below path, symbolic links are left out as their targets are found anyway
+static void scan_version_files(struct version_set *set, const char *path)
+{
+	DIR *dir = NULL;
+	struct dirent *entry = NULL;
+
+	dir = opendir(path);
+	if(!dir)
+	{
+		error(0, errno, "cannot open directory \'%s\'", path);
+		return;
+	}
+
+	while((entry = readdir(dir)) != NULL)
+	{
+		char *child = NULL;
+		struct stat st;
+
+		if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			continue;
+
+		if(asprintf(&child, "%s/%s", path, entry->d_name) < 0)
+			error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+		if(lstat(child, &st) == 0)
+		{
+			if(S_ISDIR(st.st_mode))
+				scan_version_files(set, child);
+			else if(S_ISREG(st.st_mode) && st.st_size >= (off_t)sizeof(Elf32_Ehdr))
+				add_version_file(set, child, false);
+		}
+
+		free(child);
+	}
+
+	closedir(dir);
+}
+
+static void free_version_set(struct version_set *set)
+{
+	for(size_t i = 0; i < set->count; i++)
+	{
+		struct version_file *file = &set->files[i];
+
+		for(size_t j = 0; j < file->definition_count; j++)
+			free(file->definitions[j]);
+		for(size_t j = 0; j < file->need_count; j++)
+		{
+			free(file->needs[j].file);
+			free(file->needs[j].name);
+		}
+
+		free(file->definitions);
+		free(file->needs);
+		free(file->soname);
+		free(file->path);
+	}
+
+	free(set->files);
+}
+
+/*
+ * checks that every version required by a file of the set (files and
+ * directory trees) is defined by a library of the set with that soname,
+ * class and machine; returns the number of missing non-weak versions
+ */
+size_t check_versions(char **paths, size_t count)
+{
+	assert(paths != NULL);
+
+	struct version_set set;
+	struct version_index index;
+	size_t files = 0, libraries = 0, versions = 0, needs = 0, missing = 0, weak = 0, unknown = 0;
+
+	memset(&set, 0, sizeof(set));
+
+	for(size_t i = 0; i < count; i++)
+	{
+		struct stat st;
+
+		if(stat(paths[i], &st) == 0 && S_ISDIR(st.st_mode))
+			scan_version_files(&set, paths[i]);
+		else
+			add_version_file(&set, paths[i], true);
+	}
+
+	parallel_for(set.count, read_version_file, &set);
+	build_version_index(&set, &index);
+
+	for(size_t i = 0; i < set.count; i++)
+	{
+		const struct version_file *file = &set.files[i];
+
+		if(file->status != 0)
+		{
+			if(file->is_listed)
+				error(0, file->status, "\'%s\' is not a valid elf file", file->path);
+			continue;
+		}
+
+		files++;
+		if(file->definition_count > 0)
+			libraries++;
+		versions += file->definition_count;
+
+		for(size_t j = 0; j < file->need_count; j++)
+		{
+			const struct version_need *need = &file->needs[j];
+
+			needs++;
+			if(has_key(&index, need->file, need->name, file->elf_class, file->machine))
+				continue;
+
+			if(!has_key(&index, need->file, "", file->elf_class, file->machine))
+			{
+				printf("%s: needs %s of %s, which is not in the set\n", file->path, need->name, need->file);
+				unknown++;
+			}
+			else
+			{
+				printf("%s: needs %s of %s, which does not define it%s\n", file->path, need->name, need->file, need->is_weak ? " (weak)" : "");
+				if(need->is_weak)
+					weak++;
+				else
+					missing++;
+			}
+		}
+	}
+
+	printf("%zu files, %zu libraries defining %zu versions, %zu required versions: %zu missing, %zu missing weak, %zu from libraries not in the set\n",
+		files, libraries, versions, needs, missing, weak, unknown);
+
+	free(index.keys);
+	free_version_set(&set);
+
+	return missing;
+}
@@ -0,0 +1,630 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <elf.h>
+#include <errno.h>
+#include <error.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/inotify.h>
+#include "misc.h"
+#include "image.h"
+#include "parallel.h"
+#include "elf_header.h"
+#include "watch.h"
+
+// a burst of events is handled once it has been quiet this long, or at the
+// latest after WATCH_MAX_DELAY_MS, or as soon as WATCH_BATCH_MAX files wait
+#define WATCH_DEBOUNCE_MS 200
+#define WATCH_MAX_DELAY_MS 2000
+#define WATCH_BATCH_MAX 4096
+
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE | IN_DELETE_SELF)
+#define WATCH_BUILD_ID_MAX 64
+
+enum {
+	WATCH_INITIAL,
+	WATCH_ADDED,
+	WATCH_CHANGED,
+	WATCH_REMOVED
+};
+
+static const char watch_event_marks[] = "=+~-";
+static const char * const watch_event_names[] = {"initial", "added", "changed", "removed"};
+
+// what is kept and printed of every file
+struct watch_record {
+	char *path;
+	bool present;
+	bool is_elf;
+	dev_t dev;		// dev, ino, size and mtime tell if the file needs a new look
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	int elf_class;
+	uint16_t type;
+	uint16_t machine;
+	uint16_t phnum;
+	uint16_t shnum;
+	uint64_t entry;
+	char build_id[WATCH_BUILD_ID_MAX * 2 + 1];
+	uint64_t fingerprint;	// hash of the header tables, changes with any of them
+};
+
+// open addressing hash table of records by path, records are never removed
+struct watch_table {
+	struct watch_record *slots;
+	size_t capacity;
+	size_t count;
+};
+
+struct watch_dir {
+	int wd;
+	char *path;
+};
+
+struct watch_job {
+	char *path;
+	struct watch_record record;
+	struct elf_image image;		// outside the stack, so it survives a siglongjmp
+	bool retry;
+};
+
+// set while a thread reads a mapped file, a file truncated under the mapping
+// raises SIGBUS and the read is abandoned
+static __thread sigjmp_buf *watch_jump;
+
+struct watch_state {
+	int fd;
+	bool json;
+	struct watch_table table;
+	struct watch_dir *dirs;
+	size_t dir_count;
+	size_t dir_capacity;
+	char **pending;
+	size_t pending_count;
+	size_t pending_capacity;
+	struct watch_table pending_set;		// paths already pending, for deduplication
+	bool rescan;
+};
+
+static uint64_t hash_path(const char *path)
+{
+	return hash_string(HASH_SEED, path);
+}
+
+static struct watch_record* table_slot(struct watch_table *table, const char *path)
+{
+	size_t index = (size_t)hash_path(path) & (table->capacity - 1);
+
+	while(table->slots[index].path && strcmp(table->slots[index].path, path) != 0)
+		index = (index + 1) & (table->capacity - 1);
+
+	return &table->slots[index];
+}
+
+static struct watch_record* table_find(struct watch_table *table, const char *path)
+{
+	struct watch_record *slot = NULL;
+
+	if(table->capacity == 0)
+		return NULL;
+
+	slot = table_slot(table, path);
+	return slot->path ? slot : NULL;
+}
+
+static struct watch_record* table_insert(struct watch_table *table, const char *path)
+{
+	struct watch_record *slot = NULL;
+
+	if((table->count + 1) * 10 > table->capacity * 7)
+	{
+		struct watch_table grown;
+
+		grown.capacity = table->capacity ? table->capacity * 2 : 256;
+		grown.count = table->count;
+		grown.slots = calloc(grown.capacity, sizeof(struct watch_record));
+		if(!grown.slots)
+			error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+		for(size_t i = 0; i < table->capacity; i++)
+			if(table->slots[i].path)
+				*table_slot(&grown, table->slots[i].path) = table->slots[i];
+
+		free(table->slots);
+		*table = grown;
+	}
+
+	slot = table_slot(table, path);
+	if(!slot->path)
+	{
+		memset(slot, 0, sizeof(struct watch_record));
+		slot->path = strdup(path);
+		if(!slot->path)
+			error(EXIT_FAILURE, errno, "cannot allocate memory");
+		table->count++;
+	}
+
+	return slot;
+}
+
+static void free_table(struct watch_table *table)
+{
+	for(size_t i = 0; i < table->capacity; i++)
+		free(table->slots[i].path);
+	free(table->slots);
+	memset(table, 0, sizeof(struct watch_table));
+}
+
+static bool same_file_state(const struct watch_record *record, const struct stat *st)
+{
+	return record->dev == st->st_dev && record->ino == st->st_ino && record->size == st->st_size &&
+		record->mtime.tv_sec == st->st_mtim.tv_sec && record->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+// records are printed again only when something shown in them changed
+static bool same_record(const struct watch_record *a, const struct watch_record *b)
+{
+	return a->is_elf == b->is_elf && a->elf_class == b->elf_class && a->type == b->type &&
+		a->machine == b->machine && a->phnum == b->phnum && a->shnum == b->shnum &&
+		a->entry == b->entry && a->fingerprint == b->fingerprint && strcmp(a->build_id, b->build_id) == 0;
+}
+
+static void fill_record(struct watch_record *record, const struct elf_image *image)
+{
+	uint64_t hash = HASH_SEED;
+	const unsigned char *build_id = NULL;
+	size_t build_id_size = 0;
+
+	record->is_elf = true;
+	record->elf_class = image->elf_class;
+	record->type = image->header.e_type;
+	record->machine = image->header.e_machine;
+	record->phnum = image->header.e_phnum;
+	record->shnum = image->header.e_shnum;
+	record->entry = image->header.e_entry;
+
+	build_id = find_build_id(image, &build_id_size);
+	for(size_t i = 0; build_id && i < build_id_size && i < WATCH_BUILD_ID_MAX; i++)
+		sprintf(record->build_id + i * 2, "%02x", build_id[i]);
+
+	hash = hash_bytes(hash, &image->header, sizeof(Elf64_Ehdr));
+	hash = hash_bytes(hash, image->program_headers, sizeof(Elf64_Phdr) * image->header.e_phnum);
+	hash = hash_bytes(hash, image->section_headers, sizeof(Elf64_Shdr) * image->header.e_shnum);
+	record->fingerprint = hash_bytes(hash, record->build_id, strlen(record->build_id));
+}
+
+/*
+ * files are opened here rather than through open_elf_image: a file can be
+ * deleted or truncated by the build at any moment, which must not be fatal
+ */
+static void handle_sigbus(int sig)
+{
+	if(watch_jump)
+		siglongjmp(*watch_jump, 1);
+
+	signal(sig, SIG_DFL);
+	raise(sig);
+}
+
+static void parse_job(size_t index, void *arg)
+{
+	struct watch_job *job = &((struct watch_job*)arg)[index];
+	struct watch_record *record = &job->record;
+	sigjmp_buf jump;
+	struct stat st;
+	void * volatile data = NULL;	// still unmapped after a siglongjmp
+	int fd;
+
+	memset(record, 0, sizeof(struct watch_record));
+	record->path = job->path;
+	job->retry = false;
+
+	fd = open(job->path, O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return;
+
+	if(fstat(fd, &st) < 0 || !S_ISREG(st.st_mode))
+	{
+		close(fd);
+		return;
+	}
+
+	record->present = true;
+	record->dev = st.st_dev;
+	record->ino = st.st_ino;
+	record->size = st.st_size;
+	record->mtime = st.st_mtim;
+
+	if(st.st_size >= (off_t)sizeof(Elf32_Ehdr))
+		data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if(!data || data == MAP_FAILED)
+		return;
+
+	memset(&job->image, 0, sizeof(struct elf_image));
+
+	if(sigsetjmp(jump, 1) == 0)
+	{
+		watch_jump = &jump;
+		if(load_elf_image(&job->image, job->path, data, (size_t)st.st_size) == 0)
+			fill_record(record, &job->image);
+	}
+	else
+		job->retry = true;	// changed while being read, its next event looks again
+	watch_jump = NULL;
+
+	job->image.mapping = data;
+	job->image.mapping_size = (size_t)st.st_size;
+	free_elf_image(&job->image);
+}
+
+static void print_record(const struct watch_state *state, int event, const struct watch_record *record)
+{
+	if(state->json)
+	{
+		printf("{\"event\":\"%s\",\"path\":", watch_event_names[event]);
+		print_json_string(record->path);
+
+		if(record->present && record->is_elf)
+		{
+			printf(",\"class\":%d,\"type\":\"%s\",\"machine\":\"%s\",\"entry\":%lu,\"phnum\":%u,\"shnum\":%u,\"size\":%ld,\"build_id\":\"%s\"",
+				record->elf_class == ELFCLASS32 ? 32 : 64,
+				get_elf_type(record->type),
+				get_elf_machine(record->machine),
+				record->entry,
+				record->phnum,
+				record->shnum,
+				record->size,
+				record->build_id);
+		}
+
+		printf("}\n");
+		return;
+	}
+
+	if(!record->present || !record->is_elf)
+	{
+		printf("%c %s\n", watch_event_marks[event], record->path);
+		return;
+	}
+
+	printf("%c %s: ELF%d %s, %s, entry %#lx, %u program headers, %u sections, %ld bytes%s%s\n",
+		watch_event_marks[event],
+		record->path,
+		record->elf_class == ELFCLASS32 ? 32 : 64,
+		get_elf_type(record->type),
+		get_elf_machine(record->machine),
+		record->entry,
+		record->phnum,
+		record->shnum,
+		record->size,
+		record->build_id[0] ? ", build id " : "",
+		record->build_id);
+}
+
+static int compare_paths(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static void add_pending(struct watch_state *state, const char *path)
+{
+	if(table_find(&state->pending_set, path))
+		return;
+
+	table_insert(&state->pending_set, path);
+	if(state->pending_count == state->pending_capacity)
+	{
+		state->pending_capacity = state->pending_capacity ? state->pending_capacity * 2 : 64;
+		state->pending = realloc_wrap(state->pending, sizeof(char*) * state->pending_capacity);
+	}
+	state->pending[state->pending_count] = strdup(path);
+	if(!state->pending[state->pending_count])
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+	state->pending_count++;
+}
+
+/*
+ * looks at every pending file: files whose dev, inode, size and mtime did not
+ * change since their record was made are skipped, the others are parsed in
+ * parallel and printed when their record changed
+ */
+static void flush_pending(struct watch_state *state, bool initial)
+{
+	struct watch_job *jobs = NULL;
+	size_t job_count = 0;
+
+	if(state->pending_count > 0)
+		qsort(state->pending, state->pending_count, sizeof(char*), compare_paths);
+	jobs = malloc_wrap(sizeof(struct watch_job) * (state->pending_count + 1));
+
+	for(size_t i = 0; i < state->pending_count; i++)
+	{
+		struct watch_record *old = table_find(&state->table, state->pending[i]);
+		struct stat st;
+
+		if(old && old->present && lstat(state->pending[i], &st) == 0 && same_file_state(old, &st))
+			continue;
+
+		jobs[job_count++].path = state->pending[i];
+	}
+
+	parallel_for(job_count, parse_job, jobs);
+
+	for(size_t i = 0; i < job_count; i++)
+	{
+		struct watch_record *record = &jobs[i].record;
+		struct watch_record *old = table_find(&state->table, record->path);
+		bool was_elf = old && old->present && old->is_elf;
+		bool is_elf = record->present && record->is_elf;
+
+		if(jobs[i].retry)
+			continue;
+
+		if(is_elf && !was_elf)
+			print_record(state, initial ? WATCH_INITIAL : WATCH_ADDED, record);
+		else if(is_elf && !same_record(old, record))
+			print_record(state, WATCH_CHANGED, record);
+		else if(!is_elf && was_elf)
+		{
+			record->present = false;
+			print_record(state, WATCH_REMOVED, record);
+		}
+
+		if(old || record->present)
+		{
+			old = table_insert(&state->table, record->path);
+			record->path = old->path;
+			*old = *record;
+		}
+	}
+
+	for(size_t i = 0; i < state->pending_count; i++)
+		free(state->pending[i]);
+	free(state->pending);
+	free_table(&state->pending_set);
+	free(jobs);
+
+	state->pending = NULL;
+	state->pending_count = 0;
+	state->pending_capacity = 0;
+
+	fflush(stdout);
+}
+
+static void add_watch(struct watch_state *state, const char *path)
+{
+	int wd;
+
+	wd = inotify_add_watch(state->fd, path, WATCH_EVENTS | IN_ONLYDIR);
+	if(wd < 0)
+	{
+		error(0, errno, "cannot watch directory \'%s\'", path);
+		return;
+	}
+
+	for(size_t i = 0; i < state->dir_count; i++)
+		if(state->dirs[i].wd == wd)
+			return;
+
+	if(state->dir_count == state->dir_capacity)
+	{
+		state->dir_capacity = state->dir_capacity ? state->dir_capacity * 2 : 64;
+		state->dirs = realloc_wrap(state->dirs, sizeof(struct watch_dir) * state->dir_capacity);
+	}
+	state->dirs[state->dir_count].wd = wd;
+	state->dirs[state->dir_count].path = strdup(path);
+	if(!state->dirs[state->dir_count].path)
+		error(EXIT_FAILURE, errno, "cannot allocate memory");
+	state->dir_count++;
+}
+
+// watches the directory tree and queues every regular file in it
+static void scan_directory(struct watch_state *state, const char *path)
+{
+	DIR *dir = NULL;
+	struct dirent *entry = NULL;
+
+	add_watch(state, path);
+
+	dir = opendir(path);
+	if(!dir)
+		return;
+
+	while((entry = readdir(dir)) != NULL)
+	{
+		char *child = NULL;
+		struct stat st;
+
+		if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			continue;
+
+		if(asprintf(&child, "%s/%s", path, entry->d_name) < 0)
+			error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+		if(lstat(child, &st) == 0)
+		{
+			if(S_ISDIR(st.st_mode))
+				scan_directory(state, child);
+			else if(S_ISREG(st.st_mode))
+				add_pending(state, child);
+		}
+
+		free(child);
+	}
+
+	closedir(dir);
+}
+
+static const char* find_watch_dir(const struct watch_state *state, int wd)
+{
+	for(size_t i = 0; i < state->dir_count; i++)
+		if(state->dirs[i].wd == wd)
+			return state->dirs[i].path;
+
+	return NULL;
+}
+
+static void remove_watch_dir(struct watch_state *state, int wd)
+{
+	for(size_t i = 0; i < state->dir_count; i++)
+	{
+		if(state->dirs[i].wd != wd)
+			continue;
+
+		free(state->dirs[i].path);
+		state->dirs[i] = state->dirs[--state->dir_count];
+		return;
+	}
+}
+
+// every record under a removed or renamed directory is looked at again
+static void queue_directory_records(struct watch_state *state, const char *path)
+{
+	size_t length = strlen(path);
+
+	for(size_t i = 0; i < state->table.capacity; i++)
+	{
+		const struct watch_record *record = &state->table.slots[i];
+
+		if(record->path && record->present && strncmp(record->path, path, length) == 0 && record->path[length] == '/')
+			add_pending(state, record->path);
+	}
+}
+
+static void read_events(struct watch_state *state)
+{
+	char buffer[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t length;
+
+	// the queue is drained completely, so the kernel side does not overflow
+	while((length = read(state->fd, buffer, sizeof(buffer))) > 0)
+	{
+		for(char *pos = buffer; pos < buffer + length; )
+		{
+			const struct inotify_event *event = (const struct inotify_event*)(void*)pos;
+			const char *dir = find_watch_dir(state, event->wd);
+			char *path = NULL;
+
+			pos += sizeof(struct inotify_event) + event->len;
+
+			if(event->mask & IN_Q_OVERFLOW)
+			{
+				state->rescan = true;
+				continue;
+			}
+			if(event->mask & IN_IGNORED)
+			{
+				remove_watch_dir(state, event->wd);
+				continue;
+			}
+			if(!dir || event->len == 0)
+				continue;
+
+			if(asprintf(&path, "%s/%s", dir, event->name) < 0)
+				error(EXIT_FAILURE, errno, "cannot allocate memory");
+
+			if(event->mask & IN_ISDIR)
+			{
+				if(event->mask & (IN_CREATE | IN_MOVED_TO))
+					scan_directory(state, path);
+				else if(event->mask & (IN_DELETE | IN_MOVED_FROM))
+					queue_directory_records(state, path);
+			}
+			else if(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE))
+				add_pending(state, path);
+
+			free(path);
+		}
+	}
+
+	if(length < 0 && errno != EAGAIN && errno != EINTR)
+		error(EXIT_FAILURE, errno, "cannot read inotify events");
+}
+
+/*
+ * prints a record of every elf file under dir, then follows the tree with
+ * inotify and prints records only for files that were added, changed or
+ * removed; runs until interrupted
+ */
+void watch_directory(const char *dir, bool json)
+{
+	assert(dir != NULL);
+
+	struct watch_state state;
+	int64_t first_event = 0, last_event = 0;
+
+	memset(&state, 0, sizeof(state));
+	state.json = json;
+
+	signal(SIGBUS, handle_sigbus);
+
+	state.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(state.fd < 0)
+		error(EXIT_FAILURE, errno, "cannot initialize inotify");
+
+	// watches are set up before the scan, so nothing written meanwhile is lost
+	scan_directory(&state, dir);
+	flush_pending(&state, true);
+
+	for(;;)
+	{
+		struct pollfd pfd = {state.fd, POLLIN, 0};
+		int64_t now = (int64_t)(get_time_ns() / 1000000);
+		int timeout = -1;
+
+		if(state.pending_count > 0)
+		{
+			int64_t quiet = last_event + WATCH_DEBOUNCE_MS - now;
+			int64_t late = first_event + WATCH_MAX_DELAY_MS - now;
+
+			timeout = (int)(quiet < late ? quiet : late);
+			if(timeout < 0)
+				timeout = 0;
+		}
+
+		if(poll(&pfd, 1, timeout) < 0 && errno != EINTR)
+			error(EXIT_FAILURE, errno, "cannot wait for inotify events");
+
+		if(pfd.revents & POLLIN)
+		{
+			size_t before = state.pending_count;
+
+			read_events(&state);
+			now = (int64_t)(get_time_ns() / 1000000);
+			if(state.pending_count > before)
+			{
+				if(before == 0)
+					first_event = now;
+				last_event = now;
+			}
+		}
+
+		// lost events: the whole tree is compared again, unchanged files cost a stat
+		if(state.rescan)
+		{
+			state.rescan = false;
+			queue_directory_records(&state, dir);
+			scan_directory(&state, dir);
+			first_event = last_event = now - WATCH_DEBOUNCE_MS;
+		}
+
+		if(state.pending_count > 0 && (now - last_event >= WATCH_DEBOUNCE_MS ||
+			now - first_event >= WATCH_MAX_DELAY_MS || state.pending_count >= WATCH_BATCH_MAX))
+			flush_pending(&state, false);
+	}
+}
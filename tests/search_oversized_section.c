@@ -0,0 +1,84 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <error.h>
+#include <elf.h>
+#include "image.h"
+#include "search.h"
+
+/*
+ * --search split every selected section into 1 MiB work items by its sh_size
+ * before checking it against the file, so a corrupt sh_size of 0x1000000000f0
+ * made millions of items and ran out of memory. the file written here has
+ * such a section; the search must report it once and finish quickly
+ */
+
+#define TEST_TIMEOUT_SEC 10
+
+static const char section_names[] = "\0.text\0.shstrtab";
+
+static void set_section(Elf64_Shdr *section, uint32_t name, uint32_t type, uint64_t offset, uint64_t size)
+{
+	memset(section, 0, sizeof(Elf64_Shdr));
+	section->sh_name = name;
+	section->sh_type = type;
+	section->sh_offset = offset;
+	section->sh_size = size;
+	section->sh_addralign = 1;
+}
+
+static void write_test_file(int fd)
+{
+	Elf64_Ehdr header;
+	Elf64_Shdr sections[3];
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.e_ident, ELFMAG, SELFMAG);
+	header.e_ident[EI_CLASS] = ELFCLASS64;
+	header.e_ident[EI_DATA] = ELFDATA2LSB;
+	header.e_ident[EI_VERSION] = EV_CURRENT;
+	header.e_type = ET_REL;
+	header.e_machine = EM_X86_64;
+	header.e_version = EV_CURRENT;
+	header.e_shoff = sizeof(header) + sizeof(section_names);
+	header.e_ehsize = sizeof(header);
+	header.e_shentsize = sizeof(Elf64_Shdr);
+	header.e_shnum = 3;
+	header.e_shstrndx = 2;
+
+	set_section(&sections[0], 0, SHT_NULL, 0, 0);
+	set_section(&sections[1], 1, SHT_PROGBITS, sizeof(header), UINT64_C(0x1000000000f0));
+	set_section(&sections[2], 7, SHT_STRTAB, sizeof(header), sizeof(section_names));
+
+	if(write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) ||
+		write(fd, section_names, sizeof(section_names)) != (ssize_t)sizeof(section_names) ||
+		write(fd, sections, sizeof(sections)) != (ssize_t)sizeof(sections))
+		error(EXIT_FAILURE, errno, "cannot write test file");
+}
+
+int main(void)
+{
+	char path[] = "/tmp/relf_search_XXXXXX";
+	char pattern[] = "foo";
+	char *filenames[] = {path};
+	char *patterns[] = {pattern};
+	int fd;
+
+	fd = mkstemp(path);
+	if(fd < 0)
+		error(EXIT_FAILURE, errno, "cannot create test file");
+	write_test_file(fd);
+	close(fd);
+
+	// a hang ends the test with SIGALRM, running out of memory in malloc_wrap
+	alarm(TEST_TIMEOUT_SEC);
+	search_files(filenames, 1, patterns, 1, NULL);
+
+	unlink(path);
+	return EXIT_SUCCESS;
+}
\ No newline at end of file